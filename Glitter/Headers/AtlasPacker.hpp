@@ -0,0 +1,39 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef ATLAS_PACKER_H
+#define ATLAS_PACKER_H
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+
+// AtlasPacker places rectangles into a texture atlas with a shelf
+// algorithm: rectangles are sorted by height and filled into rows
+// left to right, a new row starting below the tallest rectangle of
+// the previous one. Each rectangle gets a border of Padding pixels
+// on every side, so its edge pixels can be extruded into it and
+// filtering never blends neighbouring sprites. Rectangles start on
+// multiples of 4 pixels, the block size of compressed textures.
+class AtlasPacker
+{
+public:
+	// Pixels reserved around every rectangle
+	GLuint Padding;
+	AtlasPacker(GLuint padding = 2);
+	// Packs all sizes into the smallest power-of-two atlas (up to maxSize on each side) they fit in.
+	// On success, positions holds the top-left corner of each rectangle's content (inside its padding)
+	GLboolean Pack(const std::vector<glm::ivec2> &sizes, GLint maxSize, glm::ivec2 &atlasSize, std::vector<glm::ivec2> &positions) const;
+private:
+	// Tries a single atlas size
+	GLboolean packInto(const std::vector<glm::ivec2> &sizes, const std::vector<GLuint> &order, glm::ivec2 atlasSize, std::vector<glm::ivec2> &positions) const;
+};
+
+#endif
@@ -8,31 +8,51 @@
 ******************************************************************/
 #ifndef BALLOBJECT_H
 #define BALLOBJECT_H
+#include <vector>
 
 #include <glm/glm.hpp>
 
+#include "Fixed.hpp"
 #include "Texture2D.hpp"
 #include "SpriteRenderer.hpp"
 #include "GameObject.hpp"
 
-// BallObject holds the state of the Ball object inheriting
-// relevant state data from GameObject. Contains some extra
-// functionality specific to Breakout's ball object that
-// were too specific for within GameObject alone.
-class BallObject : public GameObject
+// BallBatch holds the state of every ball in play as a structure of
+// arrays, so integration and collision tests run as straight loops
+// over contiguous numbers that the compiler can vectorize. Power-up
+// state (sticky, pass-through, color) is shared by all balls.
+class BallBatch
 {
 public:
-	// Ball state
-	GLfloat   Radius;
-	GLboolean Stuck;
+	// Per ball state; positions are the top-left corner of the ball's bounding box
+	std::vector<Real>      PosX, PosY, VelX, VelY;
+	std::vector<GLboolean> Stuck;
+	// Paddle each ball belongs to (0 the player, 1 the versus opponent): it sits on it while stuck and scores its bricks
+	std::vector<GLubyte>   Owner;
+	// Shared ball state
+	Real      Radius;
 	GLboolean Sticky, PassThrough;
+	glm::vec3 Color;
+	// Render state
+	Texture2D Sprite;
 	// Constructor(s)
-	BallObject();
-	BallObject(glm::vec2 pos, GLfloat radius, glm::vec2 velocity, Texture2D sprite);
-	// Moves the ball, keeping it constrained within the window bounds (except bottom edge); returns new position
-	glm::vec2 Move(GLfloat dt, GLuint window_width);
-	// Resets the ball to original state with given position and velocity
-	void      Reset(glm::vec2 position, glm::vec2 velocity);
+	BallBatch();
+	BallBatch(Real radius, Texture2D sprite);
+	// Number of balls in play
+	GLuint    Count() const { return static_cast<GLuint>(this->PosX.size()); }
+	Vec2      Position(GLuint i) const { return Vec2(this->PosX[i], this->PosY[i]); }
+	Vec2      Velocity(GLuint i) const { return Vec2(this->VelX[i], this->VelY[i]); }
+	Vec2      Size() const { return Vec2(this->Radius * 2); }
+	// Puts a new ball into play
+	void      Add(Vec2 position, Vec2 velocity, GLboolean stuck = GL_TRUE, GLubyte owner = 0);
+	// Removes all balls and resets the shared power-up state
+	void      Reset();
+	// Moves all free balls, keeping them constrained within the window bounds (except bottom edge)
+	void      Move(GLfloat dt, GLuint window_width);
+	// Sets hits[i] for every ball whose circle overlaps the given box; returns the number of hits
+	GLuint    Overlap(Vec2 position, Vec2 size, std::vector<GLubyte> &hits) const;
+	// Removes the balls that reached the bottom edge, keeping the order of the others; returns how many were removed
+	GLuint    RemoveBelow(Real bottom);
 };
 
 #endif
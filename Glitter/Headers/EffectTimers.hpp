@@ -0,0 +1,61 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef EFFECT_TIMERS_H
+#define EFFECT_TIMERS_H
+
+#include <vector>
+
+#include <glad/glad.h>
+
+
+// Effects that wear off after a while
+enum TimedEffect {
+	EFFECT_STICKY,
+	EFFECT_PASS_THROUGH,
+	EFFECT_CONFUSE,
+	EFFECT_CHAOS,
+	EFFECT_SHAKE,
+	TIMED_EFFECTS
+};
+
+// EffectTimers schedules the end of every running timed effect on the
+// simulation clock. Timers sit in a min-heap ordered by expiry, so a
+// tick only looks at the earliest one and each expiry costs a single
+// heap pop instead of a scan over everything that is running. An
+// effect can be started again while it runs (e.g. a second sticky
+// power-up); it only ends once its last timer has expired.
+class EffectTimers
+{
+public:
+	EffectTimers();
+	// Starts a run of effect that ends duration seconds after now
+	void      Start(TimedEffect effect, GLdouble now, GLdouble duration);
+	// Pops timers that expired at or before now until one ends its effect for good, which is returned in effect;
+	// false once no expired timer is left. Call it in a loop every tick
+	GLboolean Expire(GLdouble now, TimedEffect &effect);
+	// Drops every timer without reporting the effects as ended; the caller turns them off itself
+	void      Clear();
+	// Whether effect has a timer running and the seconds until its last one expires (0 if none)
+	GLboolean Active(TimedEffect effect) const { return this->running[effect] > 0; }
+	GLdouble  Remaining(TimedEffect effect, GLdouble now) const;
+private:
+	struct Timer
+	{
+		GLdouble Expiry;
+		GLuint   Effect;
+		// Orders the heap with the earliest expiry on top
+		bool operator<(const Timer &other) const { return this->Expiry > other.Expiry; }
+	};
+	std::vector<Timer> heap;
+	// Timers running per effect and the latest expiry among them
+	GLuint             running[TIMED_EFFECTS];
+	GLdouble           until[TIMED_EFFECTS];
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+
+// FileWatcher reports files that were written in a set of watched
+// directories, for hot-reloading assets while the game runs. It
+// uses inotify and only looks at complete writes (a file closed
+// after writing or renamed into place), so a reported file can be
+// read right away. Polling never blocks. On platforms without
+// inotify nothing is ever reported.
+class FileWatcher
+{
+public:
+	// Constructor (creates the inotify instance)/destructor
+	FileWatcher();
+	~FileWatcher();
+	// Starts watching the files directly in directory, e.g. "Resource"
+	GLboolean Watch(const std::string &directory);
+	// Paths ("Resource/block.png") of the files written since the last call, each listed once
+	std::vector<std::string> Changes();
+private:
+	// inotify file descriptor, -1 if unavailable
+	int                        fd;
+	// Watched directories by watch descriptor
+	std::map<int, std::string> directories;
+	// Not copyable, it owns the descriptor
+	FileWatcher(const FileWatcher &);
+	FileWatcher &operator=(const FileWatcher &);
+};
+
+#endif
@@ -0,0 +1,154 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef FIXED_H
+#define FIXED_H
+
+#include <cmath>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+
+// Fixed is a Q16.16 fixed-point number: a 32-bit integer counting
+// 1/65536ths, covering +-32768 with a resolution of about 0.000015.
+// All arithmetic is integer arithmetic, so results are bit-identical
+// on every compiler and CPU, unlike float math whose results depend on
+// instruction selection (FMA contraction, x87, vectorized reductions).
+// Products and quotients are computed in 64 bits and truncated toward
+// minus infinity (products) or zero (quotients). Conversions from
+// float round to nearest; they are exact for the constants and ticks
+// the game uses, so only what happens after them has to be integer.
+class Fixed
+{
+public:
+	static const GLint ONE = 1 << 16;
+	// The number times 65536
+	GLint Raw;
+	// Constructors; conversions are implicit so literals and integers mix freely with fixed-point values
+	Fixed() : Raw(0) { }
+	Fixed(GLint value) : Raw(value * ONE) { }
+	Fixed(GLuint value) : Raw(static_cast<GLint>(value) * ONE) { }
+	Fixed(GLfloat value) : Raw(static_cast<GLint>(std::floor(value * static_cast<GLdouble>(ONE) + 0.5))) { }
+	Fixed(GLdouble value) : Raw(static_cast<GLint>(std::floor(value * ONE + 0.5))) { }
+	static Fixed FromRaw(GLint raw) { Fixed value; value.Raw = raw; return value; }
+	GLfloat      ToFloat() const { return this->Raw / static_cast<GLfloat>(ONE); }
+
+	Fixed  operator-() const { return FromRaw(-this->Raw); }
+	Fixed &operator+=(Fixed other) { this->Raw += other.Raw; return *this; }
+	Fixed &operator-=(Fixed other) { this->Raw -= other.Raw; return *this; }
+	Fixed &operator*=(Fixed other) { this->Raw = static_cast<GLint>(static_cast<int64_t>(this->Raw) * other.Raw >> 16); return *this; }
+	Fixed &operator/=(Fixed other) { this->Raw = static_cast<GLint>(static_cast<int64_t>(this->Raw) * ONE / other.Raw); return *this; }
+
+	friend Fixed operator+(Fixed a, Fixed b) { return a += b; }
+	friend Fixed operator-(Fixed a, Fixed b) { return a -= b; }
+	friend Fixed operator*(Fixed a, Fixed b) { return a *= b; }
+	friend Fixed operator/(Fixed a, Fixed b) { return a /= b; }
+	friend bool  operator==(Fixed a, Fixed b) { return a.Raw == b.Raw; }
+	friend bool  operator!=(Fixed a, Fixed b) { return a.Raw != b.Raw; }
+	friend bool  operator<(Fixed a, Fixed b) { return a.Raw < b.Raw; }
+	friend bool  operator>(Fixed a, Fixed b) { return a.Raw > b.Raw; }
+	friend bool  operator<=(Fixed a, Fixed b) { return a.Raw <= b.Raw; }
+	friend bool  operator>=(Fixed a, Fixed b) { return a.Raw >= b.Raw; }
+};
+
+// Two-component vector of Fixed with the subset of glm the simulation uses
+struct FixedVec2
+{
+	Fixed x, y;
+	FixedVec2() { }
+	explicit FixedVec2(Fixed value) : x(value), y(value) { }
+	FixedVec2(Fixed x, Fixed y) : x(x), y(y) { }
+
+	FixedVec2  operator-() const { return FixedVec2(-this->x, -this->y); }
+	FixedVec2 &operator+=(const FixedVec2 &other) { this->x += other.x; this->y += other.y; return *this; }
+	FixedVec2 &operator-=(const FixedVec2 &other) { this->x -= other.x; this->y -= other.y; return *this; }
+	FixedVec2 &operator*=(Fixed scale) { this->x *= scale; this->y *= scale; return *this; }
+	FixedVec2 &operator/=(Fixed scale) { this->x /= scale; this->y /= scale; return *this; }
+
+	friend FixedVec2 operator+(FixedVec2 a, const FixedVec2 &b) { return a += b; }
+	friend FixedVec2 operator-(FixedVec2 a, const FixedVec2 &b) { return a -= b; }
+	friend FixedVec2 operator+(FixedVec2 a, Fixed b) { return a += FixedVec2(b); }
+	friend FixedVec2 operator-(FixedVec2 a, Fixed b) { return a -= FixedVec2(b); }
+	friend FixedVec2 operator*(FixedVec2 a, Fixed b) { return a *= b; }
+	friend FixedVec2 operator*(Fixed a, FixedVec2 b) { return b *= a; }
+	friend FixedVec2 operator/(FixedVec2 a, Fixed b) { return a /= b; }
+	friend bool      operator==(const FixedVec2 &a, const FixedVec2 &b) { return a.x == b.x && a.y == b.y; }
+	friend bool      operator!=(const FixedVec2 &a, const FixedVec2 &b) { return !(a == b); }
+};
+
+// Integer square root of a 64-bit value, rounded down
+inline uint64_t SquareRoot(uint64_t value)
+{
+	uint64_t root = 0, bit = static_cast<uint64_t>(1) << 62;
+	while (bit > value)
+		bit >>= 2;
+	while (bit != 0)
+	{
+		if (value >= root + bit)
+		{
+			value -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+			root >>= 1;
+		bit >>= 2;
+	}
+	return root;
+}
+
+// Math on simulation values, overloaded for float and fixed-point so the simulation reads the same with either
+inline GLfloat   Abs(GLfloat value) { return std::abs(value); }
+inline Fixed     Abs(Fixed value) { return Fixed::FromRaw(value.Raw < 0 ? -value.Raw : value.Raw); }
+inline GLfloat   Sqrt(GLfloat value) { return std::sqrt(value); }
+// The root of a Q16.16 value is the root of its raw value times 2^16
+inline Fixed     Sqrt(Fixed value) { return Fixed::FromRaw(value.Raw <= 0 ? 0 : static_cast<GLint>(SquareRoot(static_cast<uint64_t>(value.Raw) << 16))); }
+inline GLfloat   ToFloat(GLfloat value) { return value; }
+inline GLfloat   ToFloat(Fixed value) { return value.ToFloat(); }
+
+inline GLfloat   Dot(const glm::vec2 &a, const glm::vec2 &b) { return glm::dot(a, b); }
+inline Fixed     Dot(const FixedVec2 &a, const FixedVec2 &b) { return a.x * b.x + a.y * b.y; }
+inline GLfloat   Length(const glm::vec2 &value) { return glm::length(value); }
+// The squares are summed as raw Q32.32 values, so vectors longer than 181 units (whose squared length does not fit
+// Q16.16) work too
+inline Fixed     Length(const FixedVec2 &value)
+{
+	int64_t x = value.x.Raw, y = value.y.Raw;
+	return Fixed::FromRaw(static_cast<GLint>(SquareRoot(static_cast<uint64_t>(x * x + y * y))));
+}
+inline glm::vec2 Normalize(const glm::vec2 &value) { return glm::normalize(value); }
+// A zero vector stays zero instead of dividing by zero
+inline FixedVec2 Normalize(const FixedVec2 &value)
+{
+	Fixed length = Length(value);
+	return length.Raw == 0 ? FixedVec2() : value / length;
+}
+inline glm::vec2 Clamp(const glm::vec2 &value, const glm::vec2 &low, const glm::vec2 &high) { return glm::clamp(value, low, high); }
+inline FixedVec2 Clamp(const FixedVec2 &value, const FixedVec2 &low, const FixedVec2 &high)
+{
+	return FixedVec2(value.x < low.x ? low.x : (value.x > high.x ? high.x : value.x),
+	                 value.y < low.y ? low.y : (value.y > high.y ? high.y : value.y));
+}
+inline glm::vec2 ToFloat(const glm::vec2 &value) { return value; }
+inline glm::vec2 ToFloat(const FixedVec2 &value) { return glm::vec2(value.x.ToFloat(), value.y.ToFloat()); }
+
+// Numbers the simulation (balls, paddle, bricks, power-ups) computes with: Fixed when built with
+// BREAKOUT_FIXED_POINT (CMake option of the same name) for replays and lockstep across machines, float otherwise.
+// Rendering converts them with ToFloat
+#ifdef BREAKOUT_FIXED_POINT
+typedef Fixed     Real;
+typedef FixedVec2 Vec2;
+const char *const SIMULATION_MATH = "Q16.16 fixed-point";
+#else
+typedef GLfloat   Real;
+typedef glm::vec2 Vec2;
+const char *const SIMULATION_MATH = "float";
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+class SoftwareBackend;
+
+// FrameCapture renders frames into an offscreen framebuffer instead
+// of the window and reads each one back. Every frame's content hash
+// and CPU and GPU time go into Directory/frames.txt; selected frames
+// are written as PNG images and compared against golden images of a
+// previous run, so rendering changes can be checked for identical
+// output and their cost at the same time. With a SoftwareBackend the
+// frames are taken from its output instead, and the GPU column holds
+// the time its rasterizer took.
+class FrameCapture
+{
+public:
+	// Output directory (has to exist) and directory of golden images to compare against (empty: no comparison)
+	std::string Directory, Golden;
+	// Every how many frames an image is written and compared, 0 for hashes only
+	GLuint      Every;
+	// Largest per-channel difference that still counts as equal, and the fraction of pixels allowed to differ by more
+	GLint       Tolerance;
+	GLfloat     MaxDifferentPixels;
+	// Images that did not match their golden image (or had none), and frames.txt if it could not be written
+	GLuint      Failures;
+	// Constructor (creates the offscreen framebuffer unless frames come from software)/destructor
+	FrameCapture(GLuint width, GLuint height, SoftwareBackend *software = nullptr);
+	~FrameCapture();
+	// Makes the offscreen framebuffer the output for the next frame and clears it; false if frames.txt cannot be written
+	GLboolean Begin();
+	// Reads the frame back and records it; cpuTime is the time its simulation and draw calls took in ms
+	void      End(GLuint frame, GLdouble cpuTime);
+private:
+	GLuint               width, height;
+	SoftwareBackend     *software;
+	GLuint               FBO, texture;
+	// Timestamps around a frame's draw calls
+	GLuint               queries[2];
+	std::ofstream        log;
+	std::vector<unsigned char> pixels, image;
+	// Compares the current image with its golden counterpart, true if they match within the tolerance
+	GLboolean compare(const std::string &name);
+	// Not copyable, it owns GL objects
+	FrameCapture(const FrameCapture &);
+	FrameCapture &operator=(const FrameCapture &);
+};
+
+#endif
@@ -0,0 +1,57 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glm/glm.hpp>
+#include <glad/glad.h>
+
+
+// A static FrameUniforms class holding the data every program shares
+// (projection and time) in one std140 uniform
+// block named Frame. The block is uploaded once per frame instead of
+// setting the same uniforms on each program; shaders declare it with
+// the layout of Block below. The buffer keeps a second copy with the
+// projection flipped upside down for offscreen targets, so switching
+// to one only rebinds a range instead of rewriting uniforms.
+class FrameUniforms
+{
+public:
+	// Uniform buffer binding point of the Frame block
+	static const GLuint BINDING = 0;
+	// Bits of the post effects handed to RenderBackend::PresentScene
+	static const GLint EFFECT_CHAOS = 1, EFFECT_CONFUSE = 2, EFFECT_SHAKE = 4;
+	// Block contents, written by the game and uploaded with the next Upload()
+	static glm::mat4 Projection;
+	static GLfloat   Time;
+	// Creates the buffer (render thread)
+	static void Init();
+	static void Clear();
+	// Points a program's Frame block, if it has one, at the binding point; needed after every link
+	static void Attach(GLuint program);
+	// Uploads the block and binds the screen copy; once per frame, before the first draw
+	static void Upload();
+	// Selects the copy of the block following draws read: the upside down one for offscreen targets or the screen one
+	static void BindFlipped(GLboolean flipped);
+private:
+	// Private constructor, all state is static
+	FrameUniforms() { }
+	// std140 layout of the Frame block
+	struct Block
+	{
+		glm::mat4 Projection;
+		GLfloat   Time;
+		GLfloat   Padding[3];
+	};
+	static GLuint     buffer;
+	// Offset of the flipped copy, rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	static GLintptr   flippedOffset;
+};
+
+#endif
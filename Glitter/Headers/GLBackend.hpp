@@ -0,0 +1,44 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef GL_BACKEND_H
+#define GL_BACKEND_H
+
+#include <glad/glad.h>
+
+#include "RenderBackend.hpp"
+#include "PostProcessor.hpp"
+#include "Shader.hpp"
+
+
+// GLBackend draws with OpenGL. Vertices are streamed through the
+// StreamBuffer and drawn by the sprite and text programs; the scene
+// goes into the PostProcessor's render target, which also presents
+// it with the effects applied. Without a PostProcessor it only draws
+// into whatever framebuffer is bound.
+class GLBackend : public RenderBackend
+{
+public:
+	// Constructor (effects may be null, scenes are then drawn directly)/Destructor
+	GLBackend(const Shader &spriteShader, const Shader &textShader, PostProcessor *effects);
+	~GLBackend();
+	virtual void DrawTriangles(const Texture2D &texture, const Vertex *vertices, GLsizei count, Blend blend);
+	virtual void DrawGlyphs(const Texture2D *glyphs, const Vertex *vertices, GLsizei quads);
+	virtual void BeginScene();
+	virtual void EndScene();
+	virtual void PresentScene(GLint effects, GLfloat time);
+private:
+	Shader         spriteShader, textShader;
+	PostProcessor *effects;
+	// Reads Vertex data from the StreamBuffer
+	GLuint         VAO;
+	// Streams the vertices and returns the index of the first one, -1 if they don't fit
+	GLint          write(const Vertex *vertices, GLsizei count);
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+
+// A static GLState class that shadows the pieces of OpenGL state the
+// renderers touch on every draw (program, texture units, VAO, buffers,
+// framebuffers, blend function). Each setter only reaches the driver
+// when the value actually changes; skipped calls are counted so the
+// Profiler can report how much redundant state traffic was avoided.
+// All binds in the game have to go through here, otherwise the shadow
+// copy goes stale; call Invalidate() after foreign code touched GL.
+class GLState
+{
+public:
+	// Number of state calls forwarded to / filtered from the driver since the last ResetCounters()
+	static GLuint Issued, Skipped;
+	// Framebuffer finished frames go to: 0 for the window, or an offscreen target when frames are captured.
+	// Renderers bind it instead of 0 whenever they are done with their own framebuffers
+	static GLuint OutputFramebuffer;
+	// State setters
+	static void UseProgram(GLuint program);
+	static void ActiveTexture(GLenum unit);
+	static void BindTexture(GLenum target, GLuint texture);
+	static void BindVertexArray(GLuint vao);
+	static void BindBuffer(GLenum target, GLuint buffer);
+	static void BindFramebuffer(GLenum target, GLuint framebuffer);
+	static void BlendFunc(GLenum sfactor, GLenum dfactor);
+	// Object deletion; keeps the shadow copy in sync with GL's implicit unbind of deleted objects
+	static void DeleteProgram(GLuint program);
+	static void DeleteTexture(GLuint texture);
+	static void DeleteVertexArray(GLuint vao);
+	static void DeleteBuffer(GLuint buffer);
+	static void DeleteFramebuffer(GLuint framebuffer);
+	// Forgets everything, so the next call of each setter reaches the driver
+	static void Invalidate();
+	static void ResetCounters();
+private:
+	// Private constructor, all state is static
+	GLState() { }
+	static const GLuint MAX_TEXTURE_UNITS = 16;
+	// Shadowed state; GLuint(-1) means unknown
+	static GLuint program;
+	static GLuint activeUnit;
+	static GLuint textures[MAX_TEXTURE_UNITS];
+	static GLuint vertexArray;
+	static GLuint arrayBuffer, elementBuffer, uniformBuffer;
+	static GLuint readFramebuffer, drawFramebuffer;
+	static GLenum blendSrc, blendDst;
+	// Returns the shadow slot for a buffer binding target, or nullptr when it is not tracked
+	static GLuint *bufferSlot(GLenum target);
+};
+
+#endif
@@ -8,6 +8,10 @@
 ******************************************************************/
 #ifndef GAME_H
 #define GAME_H
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
 #include <vector>
 #include <tuple>
 
@@ -15,6 +19,19 @@
 
 #include "GameLevel.hpp"
 #include "PowerUp.hpp"
+#include "Ball.hpp"
+#include "EffectTimers.hpp"
+#include "JobSystem.hpp"
+#include "ParticleGenerator.hpp"
+#include "RingBuffer.hpp"
+#include "StateHash.hpp"
+
+class FileWatcher;
+class LevelCache;
+class PostProcessor;
+class RenderBackend;
+class SoftwareBackend;
+class TextRenderer;
 
 // Represents the current state of the game
 enum GameState {
@@ -32,18 +49,71 @@ enum Direction {
 };
 
 
+// Bits of one player's input for a versus tick (see Game::Step)
+enum PlayerInput {
+	INPUT_LEFT   = 1,
+	INPUT_RIGHT  = 2,
+	INPUT_LAUNCH = 4
+};
+
+// A key press or release, stamped with the glfwGetTime() it was received at
+struct InputEvent {
+	GLdouble Time;
+	GLint    Key, Action;
+};
+
+// Immutable copy of everything Render needs from the simulation, so
+// a frame can be drawn while the next tick is already being simulated
+struct FrameSnapshot {
+	GameState               State;
+	GLuint                  Level, Revision, Lives;
+	GameObject              Player;
+	// Versus mode: the second paddle and the bricks each player broke
+	GLboolean               Versus;
+	GameObject              Opponent;
+	GLuint                  Scores[2];
+	BallBatch               Balls;
+	std::vector<GameObject> Bricks;
+	std::vector<GameObject> PowerUps;
+	std::vector<Particle>   Particles;
+	GLboolean               Confuse, Chaos, Shake;
+	// Time of the oldest key press first reflected by this frame, 0 if none (input latency probe)
+	GLdouble                InputTime;
+	// Simulation time the frame shows, drives the animated effects
+	GLdouble                Time;
+};
+
+// Everything the simulation changes while a level is played, so a game
+// can be put back to an earlier tick (rollback netcode). Levels are
+// only saved as the destroyed flags of the current one's bricks, which
+// is all a level changes while it is played.
+struct SimulationState {
+	GameState              State;
+	GLuint                 Level, Lives, Random;
+	GLuint                 Scores[2];
+	GLdouble               Clock;
+	GameObject             Player, Opponent;
+	BallBatch              Balls;
+	std::deque<PowerUp>    PowerUps;
+	EffectTimers           Timers;
+	GLboolean              Confuse, Chaos, Shake;
+	std::vector<GLboolean> Destroyed;
+	GLuint64               Standing;
+};
 
 // Defines a Collision typedef that represents collision data
-typedef std::tuple<GLboolean, Direction, glm::vec2> Collision; // <collision?, what direction?, difference vector center - closest point>
+typedef std::tuple<GLboolean, Direction, Vec2> Collision; // <collision?, what direction?, difference vector center - closest point>
 
 // Initial size of the player paddle
-const glm::vec2 PLAYER_SIZE(100, 20);
+const Vec2 PLAYER_SIZE(100, 20);
 // Initial velocity of the player paddle
-const GLfloat PLAYER_VELOCITY(500.0f);
+const Real PLAYER_VELOCITY(500.0f);
 // Initial velocity of the Ball
-const glm::vec2 INITIAL_BALL_VELOCITY(100.0f, -350.0f);
+const Vec2 INITIAL_BALL_VELOCITY(100.0f, -350.0f);
 // Radius of the ball object
-const GLfloat BALL_RADIUS = 12.5f;
+const Real BALL_RADIUS = 12.5f;
+// Tint of the versus opponent's paddle
+const glm::vec3 OPPONENT_COLOR(0.6f, 0.8f, 1.0f);
 
 // Game holds all game-related state and functionality.
 // Combines all game-related data into a single class for
@@ -53,24 +123,85 @@ class Game
 public:
 	// Game state
 	GameState              State;
+	// Keys currently held down, as of the last input event processed
 	GLboolean              Keys[1024];
-	GLboolean   KeysProcessed[1024];
+	// Timestamped key events from the window callbacks, consumed by ProcessInput
+	RingBuffer<InputEvent, 256> Input;
+	// Time of the oldest key press not yet reported through a snapshot, 0 if none
+	GLdouble               InputTime;
 	GLuint                 Width, Height;
 	std::vector<GameLevel> Levels;
 	GLuint                 Level;
 	GLuint                  Lives;
 
-	std::vector<PowerUp> PowerUps;
+	// Falling power-ups, ordered top to bottom. They all fall at the same speed, so the order holds
+	// without re-sorting, and the paddle only has to be tested against the lowest few
+	std::deque<PowerUp>  PowerUps;
+	// End times of the running power-up effects and of the screen shake
+	EffectTimers         Timers;
+	// Simulation time: the seconds all Updates so far advanced the game by
+	GLdouble             Clock;
+	// The paddle
+	GameObject           Player;
+	// Two-player versus mode (see StartVersus): a second paddle sharing the level, and the bricks each player's balls broke
+	GLboolean            Versus;
+	GameObject           Opponent;
+	GLuint               Scores[2];
+	// Set while ticks are simulated again after a rollback; they leave out particles and other effects that were shown already
+	GLboolean            Replaying;
+	// All balls in play
+	BallBatch            Balls;
+	// Number of balls put into play for each life (multi-ball mode when > 1)
+	GLuint               BallCount;
+	// State of the generator deciding which power-ups spawn (xorshift, non-zero). Unlike rand() it is the same on
+	// every platform and is not shared with the particles, so a game's course only depends on its own input
+	GLuint               Random;
+	// Active post-processing effects (applied by the renderer)
+	GLboolean            Confuse, Chaos, Shake;
+	// Scene render target settings handed to the post processor: MSAA sample count (1 = off),
+	// resolution relative to the window and GPU frame time budget in ms for dynamic resolution (0 = off)
+	GLuint               Samples;
+	GLfloat              RenderScale, TargetGpuTime;
+	// Watch the resource files and reload shaders, textures and levels as they are saved
+	GLboolean            HotReload;
+	// Render on the CPU instead of through OpenGL (no GL context needed); Rasterizer is the backend once Init ran
+	GLboolean            Software;
+	SoftwareBackend     *Rasterizer;
+	// Runs the independent stages of Update (see the constructor) and the chunks of the broad phase and particle update
+	// in parallel when set; null runs everything on the updating thread
+	JobSystem           *Jobs;
+	// Particles the ball trail can have alive at once
+	GLuint               ParticleCount;
 
 	// Constructor/Destructor
 	Game(GLuint width, GLuint height);
 	~Game();
 	// Initialize game state (load all shaders/textures/levels)
 	void Init();
+	// Initializes only the simulation (levels, paddle, balls) of an extra instance that shares the resources another
+	// instance's Init loaded; it can be updated and snapshotted (without particles), but not rendered
+	void InitSimulation();
 	// GameLoop
-	void ProcessInput(GLfloat dt);
+	// Consumes the input events up to now and integrates the paddle over the tick (now - dt, now]
+	void ProcessInput(GLdouble now, GLfloat dt);
 	void Update(GLfloat dt);
-	void Render();
+	// Turns the game into a versus game on its current level: both paddles get their balls, lives and scores start over
+	void StartVersus();
+	// Advances a versus game by one tick with each player's PlayerInput bits
+	void Step(const GLubyte inputs[2], GLfloat dt);
+	// Copies the simulation state out and puts a saved one back; restoring requires the same level to be loaded
+	void Save(SimulationState &state) const;
+	void Restore(const SimulationState &state);
+	// Copies the current simulation state into frame
+	void Snapshot(FrameSnapshot &frame);
+	// Fingerprints the current simulation state, cheap enough for every tick
+	void Hash(StateHash &hash) const;
+	// Renders a snapshot; only touches render state, so it may run concurrently with Update
+	void Render(const FrameSnapshot &frame);
+	// Reports the window's framebuffer size in pixels; may be called from any thread and takes effect
+	// with the next Render. The game keeps its Width x Height units and is letterboxed into the framebuffer
+	void Resize(GLuint framebufferWidth, GLuint framebufferHeight);
+	// Resolves the collisions of the balls with the bricks the broad phase found, the paddles and the power-ups
 	void DoCollisions(float dt);
 	// Reset
 	void ResetLevel();
@@ -78,6 +209,63 @@ public:
 
 	void SpawnPowerUps(GameObject& block);
 	void UpdatePowerUps(GLfloat dt);
+	void ActivatePowerUp(PowerUp& powerUp, GameObject& paddle);
+private:
+	// Advances Random and returns whether a power-up with the given chance (1 in chance) spawns
+	GLboolean shouldSpawn(GLuint chance);
+	// Inserts a falling power-up at its place in PowerUps
+	void addPowerUp(const PowerUp &powerUp);
+	// Drops the power-ups that fell off the screen and collects those the paddles caught
+	void collectPowerUps();
+	// Moves the paddle (and a stuck ball) according to the held keys for dt seconds
+	void movePlayer(GLfloat dt);
+	// Moves a paddle and the stuck balls of its owner sideways by distance, unless it is already past that edge
+	void movePaddle(GameObject &paddle, GLubyte owner, Real distance);
+	// Bounces the free balls touching a paddle off it and hands them to its owner
+	void bouncePaddle(const GameObject &paddle, GLubyte owner);
+	// Applies a single key event
+	void handleKey(const InputEvent &event);
+	// End of the last tick processed by ProcessInput
+	GLdouble time;
+	// Turns off an effect whose last timer expired
+	void endEffect(TimedEffect effect);
+	// Scratch space for BallBatch::Overlap, kept around to avoid per-tick allocations
+	std::vector<GLubyte> ballHits;
+	// Stages of Update, the tick they are run for, and per brick whether the broad phase found a ball overlapping it
+	JobGraph             stages;
+	GLfloat              stepTime;
+	std::vector<GLubyte> brickCandidates;
+	// Scratch space of every broad phase chunk
+	std::vector<std::vector<GLubyte>> chunkHits;
+	// Tests all standing bricks against all balls, in chunks of bricks on Jobs, and fills brickCandidates
+	void broadPhase();
+	// Moves the particles and emits new ones behind the balls
+	void updateParticles(GLfloat dt);
+	// Ball the particle trail currently follows
+	GLuint trailBall;
+	// Puts BallCount balls onto the paddle (onto each paddle in versus mode), fanned out in direction
+	void spawnBalls();
+	void addBalls(const GameObject &paddle, GLubyte owner);
+	// Framebuffer size reported by Resize (width in the high, height in the low 32 bits) and the one the renderers are set up for
+	std::atomic<unsigned long long> framebufferSize;
+	unsigned long long              appliedFramebufferSize;
+	// Sets up viewport and render targets for a changed framebuffer size (render thread)
+	void applyFramebufferSize();
+	// Changed files that are not render resources, handed from the renderer to the simulation (possibly levels)
+	std::mutex               changedFilesMutex;
+	std::vector<std::string> changedFiles;
+	// Reloads changed shaders and textures between frames (render thread)
+	void reloadResources();
+	// Reloads changed levels between ticks (simulation thread)
+	void reloadLevels();
+	// Renderers and render targets, only set up by Init
+	SpriteRenderer    *renderer;
+	ParticleGenerator *particles;
+	PostProcessor     *effects;
+	TextRenderer      *text;
+	LevelCache        *brickCache;
+	RenderBackend     *backend;
+	FileWatcher       *watcher;
 };
 
 #endif
@@ -8,6 +8,7 @@
 ******************************************************************/
 #ifndef GAMELEVEL_H
 #define GAMELEVEL_H
+#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
@@ -24,10 +25,18 @@ class GameLevel
 public:
 	// Level state
 	std::vector<GameObject> Bricks;
+	// Changes every time a brick layout is loaded, so caches built from Bricks know when to rebuild
+	GLuint                  Revision;
+	// File the level was last loaded from
+	std::string             File;
+	// XOR of StateHash::BrickKey over the bricks not destroyed, kept up to date by Load and Destroy
+	GLuint64                Standing;
 	// Constructor
-	GameLevel() { }
+	GameLevel() : Revision(0), Standing(0) { }
 	// Loads level from file
 	void      Load(const GLchar *file, GLuint levelWidth, GLuint levelHeight);
+	// Destroys the brick at index
+	void      Destroy(GLuint index);
 	// Render level
 	void      Draw(SpriteRenderer &renderer);
 	// Check if the level is completed (all non-solid tiles are destroyed)
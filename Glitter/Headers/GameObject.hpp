@@ -11,6 +11,7 @@
 
 #include <glm/glm.hpp>
 
+#include "Fixed.hpp"
 #include "SpriteRenderer.hpp"
 #include "Texture2D.hpp"
 
@@ -21,8 +22,8 @@
 class GameObject
 {
 public:
-	// Object state
-	glm::vec2   Position, Size, Velocity;
+	// Object state; Position, Size and Velocity are simulation values (fixed-point with BREAKOUT_FIXED_POINT)
+	Vec2        Position, Size, Velocity;
 	glm::vec3   Color;
 	GLfloat     Rotation;
 	GLboolean   IsSolid;
@@ -31,7 +32,7 @@ public:
 	Texture2D   Sprite;
 	// Constructor(s)
 	GameObject();
-	GameObject(glm::vec2 pos, glm::vec2 size, Texture2D sprite, glm::vec3 color = glm::vec3(1.0f), glm::vec2 velocity = glm::vec2(0.0f, 0.0f));
+	GameObject(Vec2 pos, Vec2 size, Texture2D sprite, glm::vec3 color = glm::vec3(1.0f), Vec2 velocity = Vec2(0.0f, 0.0f));
 	// Draw sprite
 	virtual void Draw(SpriteRenderer &renderer);
 };
@@ -0,0 +1,36 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+
+
+// HeadlessContext creates an OpenGL 4.0 core context without a window
+// or a display server, through EGL on Mesa's surfaceless platform, so
+// offscreen runs work on a CI machine with nothing but llvmpipe. The
+// context has no default framebuffer; everything has to be rendered
+// into framebuffer objects. Linux only.
+class HeadlessContext
+{
+public:
+	// Constructor/destructor (destroys the context)
+	HeadlessContext();
+	~HeadlessContext();
+	// Creates the context, makes it current on the calling thread and loads the GL functions; false on failure
+	GLboolean Create();
+private:
+	// EGLDisplay and EGLContext, kept opaque so EGL's headers stay out of the game's
+	void *display, *context;
+	// Not copyable, it owns the context
+	HeadlessContext(const HeadlessContext &);
+	HeadlessContext &operator=(const HeadlessContext &);
+};
+
+#endif
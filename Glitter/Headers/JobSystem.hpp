@@ -0,0 +1,117 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+
+// JobSystem runs small jobs on a pool of threads with work stealing.
+// Every pool thread has its own deque of jobs, and one more deque is
+// shared by the threads outside the pool. A thread pushes and pops
+// jobs at the back of its own deque, so it keeps working on what it
+// just split off while that is still in its cache. A thread whose
+// deque is empty steals from the front of the others, where the
+// oldest and usually largest jobs are. Deques are locked separately,
+// so threads only ever contend for a lock while stealing. Idle pool
+// threads sleep until a job is pushed. A thread waiting for jobs to
+// finish runs queued jobs meanwhile, so jobs may wait for jobs they
+// pushed themselves.
+class JobSystem
+{
+public:
+	// Jobs still to run of a batch; Wait returns once it is zero
+	typedef std::atomic<GLuint> Counter;
+	// Constructor (starts threads - 1 pool threads, 0 for one thread per core; the waiting thread is the last one)/destructor
+	JobSystem(GLuint threads = 0);
+	~JobSystem();
+	// Threads that run jobs, including the one waiting
+	GLuint Threads() const { return static_cast<GLuint>(this->workers.size()) + 1; }
+	// Jobs a thread took from another thread's deque so far
+	GLuint Steals() const { return this->steals; }
+	// Queues a job on the calling thread's deque; counter is decremented once it ran, so count the job into it first
+	void   Push(std::function<void()> job, Counter &counter);
+	// Runs queued jobs (its own first, then stolen ones) until counter is zero
+	void   Wait(Counter &counter);
+	// Calls work(begin, end) on chunks of up to grain items covering [0, count) in parallel and returns once all ran
+	void   ParallelFor(GLuint count, GLuint grain, const std::function<void(GLuint, GLuint)> &work);
+private:
+	struct Job
+	{
+		std::function<void()> Work;
+		Counter              *Pending;
+	};
+	struct Queue
+	{
+		std::mutex      Mutex;
+		std::deque<Job> Jobs;
+	};
+	// Deque 0 is shared by the threads outside the pool, pool thread i owns deque i + 1
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread>            workers;
+	// Jobs in all deques; idle pool threads sleep on wake while it is zero
+	std::atomic<GLuint>                 queued, steals;
+	std::mutex                          sleepMutex;
+	std::condition_variable             wake;
+	GLboolean                           stopping;
+	// Deque of the calling thread
+	Queue &own();
+	// Takes a job from the calling thread's deque or steals one and runs it; false if there was none
+	GLboolean runOne();
+	void worker(GLuint queue);
+	// Not copyable, it owns threads
+	JobSystem(const JobSystem &);
+	JobSystem &operator=(const JobSystem &);
+};
+
+// JobGraph runs the stages of a frame in dependency order: a stage
+// starts as soon as the stages it comes after are done, so stages that
+// do not depend on each other run at the same time on a JobSystem.
+// Stages are set up once and the graph is run every frame; the time of
+// every stage is reported to the Profiler as "stage <name>".
+class JobGraph
+{
+public:
+	// Adds a stage that runs work after the given stages (indices returned by earlier calls); returns its index
+	GLuint   Add(const std::string &name, std::function<void()> work, std::initializer_list<GLuint> after = std::initializer_list<GLuint>());
+	// Runs every stage once and returns when all are done; without jobs the stages run in the order they were added
+	void     Run(JobSystem *jobs);
+	// Milliseconds a stage took in the last Run
+	GLdouble Time(GLuint stage) const { return this->stages[stage].Time; }
+private:
+	struct Stage
+	{
+		std::string           Name;
+		std::function<void()> Work;
+		std::vector<GLuint>   Dependents;
+		GLuint                Dependencies;
+		GLdouble              Time;
+	};
+	static const GLuint NONE = ~0u;
+	std::vector<Stage>                     stages;
+	// Dependencies of each stage that have not finished yet in the current Run
+	std::unique_ptr<std::atomic<GLuint>[]> waiting;
+	// Runs a stage and the dependents it was the last dependency of
+	void runStage(GLuint stage, JobSystem *jobs, JobSystem::Counter &pending);
+	// Queues a stage for any thread to run
+	void push(GLuint stage, JobSystem *jobs, JobSystem::Counter &pending);
+};
+
+#endif
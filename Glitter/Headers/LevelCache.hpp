@@ -0,0 +1,74 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef LEVEL_CACHE_H
+#define LEVEL_CACHE_H
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "GameObject.hpp"
+#include "Shader.hpp"
+#include "SpriteRenderer.hpp"
+#include "Texture2D.hpp"
+
+class SoftwareBackend;
+
+// LevelCache keeps the static part of the playfield (background plus
+// bricks) rendered into an offscreen texture. Destroyed bricks only
+// invalidate their own rectangle, so a steady-state frame draws the
+// whole playfield as a single quad. Bricks are uploaded once per
+// layout into an instance buffer and drawn with one instanced call;
+// destroying one only updates its alive flag. With the software
+// backend the cache is a headless texture drawn as a layer, and the
+// surviving bricks are drawn as sprites.
+class LevelCache
+{
+public:
+	// Cached playfield image
+	Texture2D Texture;
+	// Playfield size in game units
+	GLuint    Width, Height;
+	// Texture pixels per game unit, so the cache matches the resolution the scene is rendered at
+	GLfloat   PixelScale;
+	// Constructor/Destructor; brickShader is the sprite shader compiled with INSTANCED defined
+	LevelCache(Shader brickShader, GLuint width, GLuint height);
+	// Constructor for the software backend (its output has to be width x height)
+	LevelCache(SoftwareBackend &rasterizer, GLuint width, GLuint height);
+	~LevelCache();
+	// Brings the cache up to date with the given bricks; revision is GameLevel::Revision of the layout they belong to
+	void Update(const std::vector<GameObject> &bricks, GLuint revision, SpriteRenderer &renderer, const Texture2D &background);
+	// Draws the cached playfield as one full-size sprite
+	void Draw(SpriteRenderer &renderer);
+	// Forces a full redraw on the next Update
+	void Invalidate();
+	// Reallocates the cached image at a new pixel scale (and redraws it with the next Update)
+	void Resize(GLfloat pixelScale);
+private:
+	GLuint FBO;
+	// Software backend the cache is drawn with, nullptr for OpenGL
+	SoftwareBackend *rasterizer;
+	// Instanced bricks: shader, vertex array, buffers (unit quad, per-brick placement/atlas rect/color, per-brick alive flag)
+	Shader    brickShader;
+	GLuint    brickVAO, quadVBO, instanceVBO, aliveVBO;
+	GLuint    instanceCount;
+	// Texture object the bricks' sprites are in (they share the atlas)
+	Texture2D brickTexture;
+	// Instance data of the bricks, kept for the software backend instead of being uploaded
+	std::vector<GLfloat> instances;
+	// Uploads the instance data and alive flags for a new layout
+	void uploadBricks(const std::vector<GameObject> &bricks);
+	// Layout the cache was last drawn from and the Destroyed state each brick had then
+	GLuint revision;
+	std::vector<GLboolean> destroyed;
+	// Redraws background and surviving bricks inside rect (min x, min y, max x, max y)
+	void redraw(SpriteRenderer &renderer, const Texture2D &background, glm::vec4 rect);
+};
+
+#endif
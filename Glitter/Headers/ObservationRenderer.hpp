@@ -0,0 +1,84 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef OBSERVATION_RENDERER_H
+#define OBSERVATION_RENDERER_H
+
+#include <deque>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Game.hpp"
+#include "GLBackend.hpp"
+#include "Shader.hpp"
+#include "SpriteRenderer.hpp"
+
+
+// ObservationRenderer draws small grayscale images of many games at
+// once, e.g. 84 x 84 pixels each for training agents on pixels. All
+// games go into tiles of one single-channel render target in a single
+// pass: every layer (backgrounds, then bricks, paddles, balls and
+// power-ups) is one sprite batch across all games, drawn by the
+// sprite program compiled with GRAYSCALE. Particles, text and post
+// effects are left out. Tiles are stacked in columns so each column
+// reads back as consecutive images; the read backs go into pixel
+// buffer objects and are only waited for when Observations() is
+// called, so the next batch of games can be simulated meanwhile.
+// With GL 4.4 the buffer is mapped persistently and observations are
+// handed out straight from it without any copy.
+class ObservationRenderer
+{
+public:
+	// Size of one observation in pixels and the most games one Render can draw (fewer than asked for, possibly none, if
+	// they do not all fit into the largest render target)
+	GLuint Width, Height, Count;
+	// Constructor (shader: "sprite_observation", gameWidth x gameHeight: game units of a frame)/destructor
+	ObservationRenderer(const Shader &shader, GLuint width, GLuint height, GLuint count, GLuint gameWidth, GLuint gameHeight);
+	~ObservationRenderer();
+	// Draws up to Count frames and starts reading them back; FrameUniforms has to be uploaded
+	void                 Render(const std::vector<FrameSnapshot> &frames);
+	// Waits for the oldest Render still pending and returns its images: one Width x Height grayscale image per frame, in
+	// order, rows top to bottom, all contiguous. Valid until the next Render or Observations call; null if none is pending
+	const unsigned char *Observations();
+	// Number of frames in the images the last Observations call returned
+	GLuint               Observed() const { return this->observed; }
+private:
+	// Read backs that can be in flight; rendering more without taking their observations drops the oldest
+	static const GLuint SLOTS = 3;
+	struct Pending
+	{
+		GLsync Sync;
+		GLuint Slot, Frames;
+	};
+	GLuint              gameWidth, gameHeight;
+	// Tiles per column and number of columns
+	GLuint              rows, columns;
+	// Single-channel render target
+	GLuint              FBO, texture;
+	// Pixel pack buffer of SLOTS slots of Count images each, and its persistent mapping (null before GL 4.4)
+	GLuint              PBO;
+	GLsizeiptr          slotSize;
+	unsigned char      *mapping;
+	std::deque<Pending> pending;
+	GLuint              nextSlot, observed;
+	// Whether the last slot handed out is mapped for reading (without persistent mapping)
+	GLboolean           mapped;
+	// Draws the batched sprites with the observation program
+	GLBackend           backend;
+	SpriteRenderer      sprites;
+	// Places a sprite of the frame in tile i into the batch
+	void batch(GLuint tile, const Texture2D &texture, glm::vec2 position, glm::vec2 size, GLfloat rotate, glm::vec3 color);
+	// Drops the mapping of the slot handed out last, if there is one
+	void unmap();
+	// Not copyable, it owns GL objects
+	ObservationRenderer(const ObservationRenderer &);
+	ObservationRenderer &operator=(const ObservationRenderer &);
+};
+
+#endif
@@ -12,9 +12,10 @@
 
 #include <glm/glm.hpp>
 
-#include "Shader.hpp"
+#include "RenderBackend.hpp"
 #include "Texture2D.hpp"
 #include "GameObject.hpp"
+#include "JobSystem.hpp"
 
 
 // Represents a single particle and its state
@@ -33,26 +34,35 @@ struct Particle {
 class ParticleGenerator
 {
 public:
+	// Moves the particles in chunks on this job system when set
+	JobSystem *Jobs;
 	// Constructor
-	ParticleGenerator(Shader shader, Texture2D texture, GLuint amount);
+	ParticleGenerator(RenderBackend &backend, Texture2D texture, GLuint amount);
 	// Update all particles
 	void Update(GLfloat dt, const GameObject &object, GLuint newParticles, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
+	// Update all particles, spawning new ones behind an emitter at position moving with velocity
+	void Update(GLfloat dt, glm::vec2 position, glm::vec2 velocity, GLuint newParticles, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
 	// Render all particles
 	void Draw();
+	// Render the given particles (e.g. a snapshot of Particles() taken on another thread)
+	void Draw(const std::vector<Particle> &particles);
+	// Current particle state
+	const std::vector<Particle> &Particles() const { return this->particles; }
 private:
 	// State
 	std::vector<Particle> particles;
 	GLuint amount;
 	// Render state
-	Shader shader;
+	RenderBackend &backend;
 	Texture2D texture;
-	GLuint VAO;
-	// Initializes buffer and vertex attributes
+	// Scratch space for the vertices of one Draw call
+	std::vector<RenderBackend::Vertex> vertices;
+	// Initializes all particles
 	void init();
 	// Returns the first Particle index that's currently unused e.g. Life <= 0.0f or 0 if no particle is currently inactive
 	GLuint firstUnusedParticle();
 	// Respawns particle
-	void respawnParticle(Particle &particle, const GameObject &object, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
+	void respawnParticle(Particle &particle, glm::vec2 position, glm::vec2 velocity, glm::vec2 offset = glm::vec2(0.0f, 0.0f));
 };
 
 #endif
@@ -6,27 +6,82 @@
 #define GLITTER_POSTPROCESSOR_HPP
 
 
+#include <string>
+#include <vector>
+
 #include <Shader.hpp>
 #include <Texture2D.hpp>
 
 class PostProcessor
 {
 public:
-	Shader PostProcessingShader;
+	// Chaos and confuse never run together, so there is one shader variant for each of
+	// {none, chaos, confuse} with and without shake
+	static const GLuint VARIANT_COUNT = 6;
+	// Preprocessor defines the post_processor shaders are compiled with for a variant
+	static std::string VariantDefines(GLuint variant);
+
+	std::vector<Shader> Variants;
+	// Resolved scene of the current target
 	Texture2D Texture;
+	// Pixel rectangle of the default framebuffer the processed scene is presented in
+	GLint OutputX, OutputY;
 	GLuint Width, Height;
 	GLboolean Confuse, Chaos, Shake;
+	// Multisample count of the scene target; 1 renders straight into Texture and skips the resolve blit
+	GLuint Samples;
+	// Size of the scene target relative to the window, also the upper bound of dynamic resolution
+	GLfloat RenderScale;
+	// GPU time in ms the scene and post pass should take; 0 turns dynamic resolution off
+	GLfloat TargetGpuTime;
+	// Part of the scene target currently rendered to, kept within [MinDynamicScale, 1]
+	GLfloat DynamicScale, MinDynamicScale;
 
-	PostProcessor(Shader shader, GLuint width, GLuint height);
+	PostProcessor(const std::vector<Shader> &variants, GLuint width, GLuint height, GLuint samples = 4, GLfloat renderScale = 1.0f);
+	~PostProcessor();
+	// These take effect with a later BeginRender
+	void SetSamples(GLuint samples);
+	void SetRenderScale(GLfloat scale);
+	void Resize(GLint x, GLint y, GLuint width, GLuint height);
 	void BeginRender();
 	void EndRender();
-	void Render(GLfloat time);
+	void Render();
 
 private:
+	// Everything the scene is rendered into for one size and sample count
+	struct Target
+	{
+		GLuint MSFBO, FBO, RBO;
+		Texture2D Texture;
+		GLuint Width, Height, Samples;
+	};
+	// Recently used targets, most recent last; switching back to a previous size (e.g. leaving
+	// fullscreen) reuses its target instead of allocating a new one
+	static const GLuint POOL_SIZE = 3;
+	std::vector<Target> pool;
+	// While the window is being resized, the old target is stretched until the size has settled for this many frames
+	static const GLuint RESIZE_SETTLE_FRAMES = 8;
 	GLuint MSFBO, FBO;
-	GLuint RBO;
 	GLuint VAO;
+	// Scene target size and the part of it used this frame, in pixels
+	GLuint targetWidth, targetHeight;
+	GLuint viewWidth, viewHeight;
+	GLboolean targetsDirty;
+	GLuint dirtyFrames;
+	// GL_TIME_ELAPSED queries, read back a few frames late so the CPU never waits on the GPU
+	static const GLuint QUERY_COUNT = 4;
+	GLuint queries[QUERY_COUNT];
+	GLuint queryFrame, framesSinceResize;
+	// Whether a query is running for the current frame
+	GLboolean timing;
+	GLfloat gpuTime;
 	void initRenderData();
+	// Makes the pooled (or a newly allocated) target for the current size, samples and render scale current
+	void acquireTargets();
+	// Feeds a measured GPU frame time into the dynamic resolution controller
+	void adjustResolution(GLfloat ms);
+	// Index of the variant for the current effect flags
+	GLuint variant() const;
 
 };
 
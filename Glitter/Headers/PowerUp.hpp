@@ -8,21 +8,30 @@
 #include <glm/vec2.hpp>
 #include <GameObject.hpp>
 
-const glm::vec2 SIZE(60, 20);
-const glm::vec2 VELOCITY(0.0f, 150.0f);
+const Vec2 SIZE(60, 20);
+const Vec2 VELOCITY(0.0f, 150.0f);
 
 class PowerUp : public GameObject
 {
 public:
+	// Number of power-up types and their names
+	static const GLuint      TYPES = 6;
+	static const char *const TypeNames[TYPES];
+
 	std::string Type;
+	// Index of Type among the type names (TYPES if it is none of them), for code that runs every tick and shouldn't compare strings
+	GLuint TypeIndex;
 	GLfloat Duration;
 	GLboolean Activated;
 
-	PowerUp(std::string type, glm::vec3 color, GLfloat duration, glm::vec2 position,
+	PowerUp(std::string type, glm::vec3 color, GLfloat duration, Vec2 position,
 			Texture2D texture)
 			: GameObject(position, SIZE, texture, color, VELOCITY),
-			Type(type), Duration(duration), Activated()
+			Type(type), TypeIndex(TYPES), Duration(duration), Activated()
 	{
+		for (GLuint i = 0; i < TYPES; ++i)
+			if (type == TypeNames[i])
+				this->TypeIndex = i;
 	}
 };
 
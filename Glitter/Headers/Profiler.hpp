@@ -0,0 +1,64 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <glad/glad.h>
+
+
+// A static Profiler class that collects per-frame statistics (frame
+// time, named timing samples and GL state traffic as filtered by
+// GLState) and periodically prints their averages to stdout. Timing
+// samples may be added from any thread; BeginFrame/EndFrame belong to
+// the render thread.
+class Profiler
+{
+public:
+	// Profiling is off unless enabled (e.g. by --profile on the command line)
+	static GLboolean Enabled;
+	// Seconds between two reports
+	static GLdouble  ReportInterval;
+	// Frame boundaries (render thread)
+	static void BeginFrame();
+	static void EndFrame();
+	// Adds a timing sample in milliseconds, reported as average per sample
+	static void AddTime(const std::string &name, GLdouble ms);
+	// Times the enclosing scope and adds it as a sample on destruction
+	class Scope
+	{
+	public:
+		Scope(const char *name);
+		~Scope();
+	private:
+		const char *name;
+		std::chrono::steady_clock::time_point start;
+	};
+private:
+	// Private constructor, all state is static
+	Profiler() { }
+	struct Sample {
+		GLdouble Total, Max;
+		GLuint   Count;
+	};
+	static std::mutex mutex;
+	static std::map<std::string, Sample> samples;
+	static std::chrono::steady_clock::time_point frameStart, lastReport;
+	static GLuint   frames;
+	static GLdouble frameTotal;
+	static GLdouble glIssued, glSkipped;
+	// Prints the collected averages and starts a new interval
+	static void report(GLdouble seconds);
+};
+
+#endif
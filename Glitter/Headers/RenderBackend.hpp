@@ -0,0 +1,47 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef RENDER_BACKEND_H
+#define RENDER_BACKEND_H
+
+#include <glad/glad.h>
+
+#include "Texture2D.hpp"
+
+
+// RenderBackend is what SpriteRenderer, ParticleGenerator, TextRenderer
+// and the post-processing pass draw through. The renderers lay out
+// their geometry on the CPU; a backend only has to rasterize textured,
+// tinted triangles into the scene and present the scene with the post
+// effects applied. GLBackend does this with OpenGL, SoftwareBackend on
+// the CPU for machines without a GPU.
+class RenderBackend
+{
+public:
+	// Vertex of a triangle: position in game units, texture coordinates and color the texture is multiplied with
+	struct Vertex
+	{
+		GLfloat X, Y, U, V, R, G, B, A;
+	};
+	enum Blend {
+		BLEND_ALPHA,
+		BLEND_ADDITIVE
+	};
+	virtual ~RenderBackend() { }
+	// Draws count vertices (three per triangle), blended into the current target
+	virtual void DrawTriangles(const Texture2D &texture, const Vertex *vertices, GLsizei count, Blend blend) = 0;
+	// Draws text: one quad (six vertices) per glyph, each with its own texture holding the glyph's coverage in red
+	virtual void DrawGlyphs(const Texture2D *glyphs, const Vertex *vertices, GLsizei quads) = 0;
+	// Draws until EndScene go into the (cleared) scene instead of the output
+	virtual void BeginScene() = 0;
+	virtual void EndScene() = 0;
+	// Draws the scene into the output with the effects (FrameUniforms::EFFECT_* bits) at the given time
+	virtual void PresentScene(GLint effects, GLfloat time) = 0;
+};
+
+#endif
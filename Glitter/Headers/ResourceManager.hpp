@@ -10,7 +10,9 @@
 #define RESOURCE_MANAGER_H
 
 #include <map>
+#include <mutex>
 #include <string>
+#include <vector>
 
 
 #include "Texture2D.hpp"
@@ -28,23 +30,69 @@ public:
 	// Resource storage
 	static std::map<std::string, Shader>    Shaders;
 	static std::map<std::string, Texture2D> Textures;
-	// Loads (and generates) a shader program from file loading vertex, fragment (and geometry) shader's source code. If gShaderFile is not nullptr, it also loads a geometry shader
-	static Shader   LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, std::string name);
+	// Textures are cooked into mipmapped, block-compressed KTX files next to their sources (<file>.ktx) and
+	// loaded from there while the sources are unchanged. Turning this off decodes and uploads them every launch
+	static GLboolean CookTextures;
+	// Cooks textures again even if their cooked file is up to date
+	static GLboolean Recook;
+	// Time spent loading textures in ms and the video memory they take up in bytes
+	static GLdouble  TextureLoadTime;
+	static size_t    TextureMemory;
+	// Loads (and generates) a shader program from file loading vertex, fragment (and geometry) shader's source code. If gShaderFile is not nullptr, it also loads a geometry shader.
+	// Preprocessor lines in defines are inserted right after each stage's #version directive, so one source can be compiled into several variants
+	static Shader   LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, std::string name, const std::string &defines = "");
 	// Retrieves a stored sader
 	static Shader   GetShader(std::string name);
 	// Loads (and generates) a texture from file
 	static Texture2D LoadTexture(const GLchar *file, GLboolean alpha, std::string name);
 	// Retrieves a stored texture
 	static Texture2D GetTexture(std::string name);
+	// Packs several images into one RGBA atlas texture stored as name. Each image is stored under its
+	// entry in names as a sprite sharing the atlas' texture object, with UV set to its part of the atlas
+	static Texture2D LoadAtlas(const std::vector<std::string> &files, const std::vector<std::string> &names, std::string name);
+	// Reloads every shader, texture and atlas built from file in place: shaders keep their program and textures their
+	// texture object, so the copies held elsewhere see the change. Atlas sprites also keep their place in the atlas, so an
+	// image that changed size can't be reloaded. Resources that fail to build keep their previous version.
+	// Returns false if no resource was loaded from file. GetShader and GetTexture may be called from other threads meanwhile
+	static GLboolean Reload(const std::string &file);
 	// Properly de-allocates all loaded resources
 	static void      Clear();
 private:
 	// Private constructor, that is we do not want any actual resource manager objects. Its members and functions should be publicly available (static).
 	ResourceManager() { }
+	// Files each shader and texture was loaded from, for Reload
+	struct ShaderSource
+	{
+		std::string Vertex, Fragment, Geometry, Defines;
+	};
+	struct TextureSource
+	{
+		// Names of the sprites for an atlas, empty for a single texture
+		std::vector<std::string> Files, Names;
+		GLboolean                Alpha;
+		// Bytes the current version adds to TextureMemory, taken off again when Reload replaces it
+		size_t                   Memory;
+	};
+	static std::map<std::string, ShaderSource>  shaderSources;
+	static std::map<std::string, TextureSource> textureSources;
+	// Guards the stored resources against Reload while the simulation thread looks them up
+	static std::mutex                           mutex;
 	// Loads and generates a shader from file
-	static Shader    loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile = nullptr);
-	// Loads a single texture from file
-	static Texture2D loadTextureFromFile(const GLchar *file, GLboolean alpha);
+	static Shader    loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile = nullptr, const std::string &defines = "");
+	// Reads one stage's source code with the defines inserted
+	static GLboolean readShaderFile(const GLchar *file, const std::string &defines, std::string &code);
+	// Inserts the defines after the #version directive of a shader source
+	static std::string injectDefines(const std::string &source, const std::string &defines);
+	// Loads a single texture from file into texture, leaving it untouched if the file can't be loaded
+	static GLboolean loadTextureFromFile(const GLchar *file, GLboolean alpha, Texture2D &texture);
+	// Packs the images into atlas and stores it and its sprites, leaving everything untouched if that fails
+	static GLboolean buildAtlas(const std::vector<std::string> &files, const std::vector<std::string> &names, const std::string &name, Texture2D &atlas);
+	// Pixel rectangle (x, y, width, height) an atlas sprite covers
+	static glm::ivec4 spriteRect(const Texture2D &atlas, const Texture2D &sprite);
+	// Identifies the current contents of the source files (size and content hash) to tell stale cooked files
+	static std::string sourceStamp(const std::vector<std::string> &files);
+	// Loads a cooked file if it was cooked from sources with the given stamp into a format the driver supports
+	static GLboolean loadCooked(const std::string &path, const std::string &stamp, CookedTexture &cooked);
 };
 
 #endif
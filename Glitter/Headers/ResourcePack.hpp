@@ -0,0 +1,85 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef RESOURCE_PACK_H
+#define RESOURCE_PACK_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+
+// Contents of a resource. Data points either into the mapped pack or
+// into Storage, for files read from disk; moving the object keeps
+// Data valid.
+struct ResourceData
+{
+	const unsigned char       *Data;
+	size_t                     Size;
+	std::vector<unsigned char> Storage;
+	ResourceData() : Data(nullptr), Size(0) { }
+	ResourceData(ResourceData &&) = default;
+	ResourceData &operator=(ResourceData &&) = default;
+	// A copy would still point into the original's Storage
+	ResourceData(const ResourceData &) = delete;
+	ResourceData &operator=(const ResourceData &) = delete;
+};
+
+// A static ResourcePack class that serves all resource files out of a
+// single archive, memory-mapped once. The archive starts with a
+// hashed table of contents (open addressing on the FNV-1a hash of the
+// path), so looking up a file touches one or two table slots and no
+// file system calls. Files missing from the pack (or all of them when
+// no pack is open) are read from disk instead.
+class ResourcePack
+{
+public:
+	// Maps the archive at path; false (and all files come from disk) if there is none
+	static GLboolean Open(const std::string &path);
+	static void      Close();
+	static GLboolean IsOpen();
+	// Gets a file's contents by its path, e.g. "Resource/block.png"
+	static GLboolean Read(const std::string &name, ResourceData &data);
+	// Size and content hash of a file, without reading it when it is packed
+	static GLboolean Fingerprint(const std::string &name, unsigned long long &size, unsigned long long &hash);
+	// Writes an archive holding the given files, as they are on disk
+	static GLboolean Build(const std::string &path, const std::vector<std::string> &files);
+	// 64 bit FNV-1a
+	static unsigned long long Hash(const unsigned char *data, size_t size);
+private:
+	// Private constructor, all state is static
+	ResourcePack() { }
+	struct Header
+	{
+		char               Magic[4];
+		GLuint             Version;
+		// Slots in the table (a power of two) and files in the pack
+		GLuint             TableSize, EntryCount;
+		unsigned long long TableOffset, NamesOffset;
+	};
+	struct Entry
+	{
+		// 0 marks an empty slot
+		unsigned long long NameHash, ContentHash;
+		unsigned long long Offset, Size;
+		GLuint             NameOffset, NameLength;
+	};
+	static const unsigned char *mapping;
+	static size_t               mappingSize;
+#ifdef _WIN32
+	static void                *fileHandle, *mappingHandle;
+#endif
+	// The table slot of a file, nullptr if it is not packed
+	static const Entry *find(const std::string &name);
+	// Reads a file from disk
+	static GLboolean readFile(const std::string &name, std::vector<unsigned char> &contents);
+};
+
+#endif
@@ -0,0 +1,53 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+
+
+// Lock-free single producer/single consumer FIFO with a fixed capacity
+// of N items (N must be a power of two). Push never blocks; it fails
+// when the consumer has fallen N items behind.
+template <typename T, unsigned N>
+class RingBuffer
+{
+	static_assert((N & (N - 1)) == 0, "RingBuffer capacity must be a power of two");
+public:
+	RingBuffer() : head(0), tail(0) { }
+	// Producer side: appends item, returns false if the buffer is full
+	bool Push(const T &item)
+	{
+		unsigned t = this->tail.load(std::memory_order_relaxed);
+		if (t - this->head.load(std::memory_order_acquire) == N)
+			return false;
+		this->items[t & (N - 1)] = item;
+		this->tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+	// Consumer side: copies the oldest item without removing it, returns false if the buffer is empty
+	bool Peek(T &item) const
+	{
+		unsigned h = this->head.load(std::memory_order_relaxed);
+		if (h == this->tail.load(std::memory_order_acquire))
+			return false;
+		item = this->items[h & (N - 1)];
+		return true;
+	}
+	// Consumer side: removes the oldest item (only valid after a successful Peek)
+	void Pop()
+	{
+		this->head.store(this->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+private:
+	T items[N];
+	std::atomic<unsigned> head, tail;
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef ROLLBACK_SESSION_H
+#define ROLLBACK_SESSION_H
+
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "Game.hpp"
+#include "UdpTransport.hpp"
+
+
+// RollbackSession plays one side of a versus game against a peer
+// running the same build. Each tick is simulated as soon as the local
+// input is known: the peer's input is predicted to be the last one
+// received, and the state the tick started from is saved. When the
+// peer's real inputs arrive and differ from a prediction, the game is
+// restored to the first mispredicted tick and all ticks since are
+// simulated again with the corrected inputs, within the same frame,
+// so the local paddle never waits for the network. A side only runs
+// up to MaxRollback ticks ahead of the peer's inputs; beyond that it
+// stalls. Every packet repeats all local inputs the peer has not
+// acknowledged yet, so lost packets need no retransmission, and
+// carries the state hash of the sender's latest tick with both inputs
+// known, which the receiver compares against its own to detect
+// desyncs.
+class RollbackSession
+{
+public:
+	// Most ticks a session can roll back, and the most inputs one packet carries
+	static const GLuint MAX_ROLLBACK = 16, MAX_INPUTS = 32;
+	static const GLuint NONE = ~0u;
+	// Ticks simulated again after mispredictions, how often that happened and how often Advance stalled
+	GLuint   Rollbacks, Replayed, Stalls;
+	// Time spent on rollbacks (restoring and simulating again) in ms, in total and the longest one
+	GLdouble RollbackTime, MaxRollbackTime;
+	// First tick whose state differed from the peer's, NONE while in sync
+	GLuint   DesyncTick;
+	// Constructor (player: 0 plays Game::Player, 1 Game::Opponent; tick: seconds per tick; maxRollback up to MAX_ROLLBACK)
+	RollbackSession(Game &game, UdpTransport &transport, GLuint player, GLfloat tick, GLuint maxRollback = 8);
+	// Takes in the peer's packets, rolling back if they show a misprediction
+	void      Poll();
+	// Simulates the next tick with the local PlayerInput bits; false if it has to wait for the peer's inputs instead
+	GLboolean Advance(GLubyte input);
+	// Ticks simulated so far and how many of them had both inputs known
+	GLuint    Tick() const { return this->tick; }
+	GLuint    Confirmed() const { return this->tick < this->remoteTick ? this->tick : this->remoteTick; }
+private:
+	static const GLuint MAGIC = 0x56535242; // "BRSV"
+	// Ticks of input and hashes kept; covers every input the peer can still be missing
+	static const GLuint HISTORY = 64;
+	// Both sides run the same build on the same machine (loopback), so the layout is sent as is
+	struct Packet
+	{
+		GLuint   Magic;
+		// The sender's inputs of ticks Start to Start + Count - 1
+		GLuint   Start, Count;
+		// Number of the receiver's inputs the sender has
+		GLuint   Ack;
+		// State hash after tick HashTick, the sender's latest tick with both inputs known (NONE if there is none)
+		GLuint   HashTick;
+		GLuint64 Hash;
+		GLubyte  Inputs[MAX_INPUTS];
+	};
+	// A simulated tick: the state it started from and the inputs it was simulated with
+	struct Frame
+	{
+		SimulationState State;
+		GLubyte         Inputs[2];
+	};
+	struct TickHash
+	{
+		GLuint   Tick;
+		GLuint64 Hash;
+	};
+	Game                 &game;
+	UdpTransport         &transport;
+	GLuint                player, maxRollback;
+	GLfloat               tickTime;
+	// Next tick to simulate, number of the peer's inputs received and of ours the peer acknowledged
+	GLuint                tick, remoteTick, peerAck;
+	// Rings indexed by tick: saved ticks (MAX_ROLLBACK), inputs of both sides and state hashes (HISTORY)
+	std::vector<Frame>    frames;
+	std::vector<GLubyte>  localInputs, remoteInputs;
+	std::vector<TickHash> hashes;
+	// Simulates tick t (the game has to be at its start) with the inputs known for it or predicted
+	void simulate(GLuint t);
+	// Puts the game back to the start of tick t and simulates up to the current tick again
+	void rollback(GLuint t);
+	// Sends the inputs the peer has not acknowledged
+	void send();
+	// Not copyable, it refers to the game and transport
+	RollbackSession(const RollbackSession &);
+	RollbackSession &operator=(const RollbackSession &);
+};
+
+#endif
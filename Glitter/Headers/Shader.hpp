@@ -10,6 +10,7 @@
 #define SHADER_H
 
 #include <string>
+#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -30,6 +31,9 @@ public:
     Shader  &Use();
     // Compiles the shader from given source code
     void    Compile(const GLchar *vertexSource, const GLchar *fragmentSource, const GLchar *geometrySource = nullptr); // Note: geometry source code is optional
+    // Replaces the program's code with new sources while keeping its ID and the values of uniforms that still exist, so every
+    // copy of this shader picks up the change. Returns false and leaves the program as it was if the new sources fail to build
+    GLboolean Relink(const GLchar *vertexSource, const GLchar *fragmentSource, const GLchar *geometrySource = nullptr);
     // Utility functions
     void    SetFloat    (const GLchar *name, GLfloat value, GLboolean useShader = false);
     void    SetInteger  (const GLchar *name, GLint value, GLboolean useShader = false);
@@ -41,6 +45,18 @@ public:
     void    SetVector4f (const GLchar *name, const glm::vec4 &value, GLboolean useShader = false);
     void    SetMatrix4  (const GLchar *name, const glm::mat4 &matrix, GLboolean useShader = false);
 private:
+    // Value of one active uniform (array element), read back before a relink
+    struct UniformValue
+    {
+        std::string          Name;
+        GLenum               Type;
+        std::vector<GLfloat> Floats;
+        std::vector<GLint>   Integers;
+    };
+    // Reads back the current values of all active uniforms
+    std::vector<UniformValue> saveUniforms();
+    // Sets uniforms that are still active to the saved values
+    void    restoreUniforms(const std::vector<UniformValue> &values);
     // Checks if compilation or linking failed and if so, print the error logs
     void    checkCompileErrors(GLuint object, std::string type);
 };
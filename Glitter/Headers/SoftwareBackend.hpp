@@ -0,0 +1,140 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef SOFTWARE_BACKEND_H
+#define SOFTWARE_BACKEND_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "RenderBackend.hpp"
+
+
+// SoftwareBackend renders on the CPU, one pixel per game unit, for
+// machines without a GPU (it needs no GL context; textures have to be
+// Texture2D::Headless). Draws are only recorded; whenever the target
+// changes (scene, output) the recorded triangles are rasterized tile
+// by tile on a pool of threads, each tile walking all triangles in
+// draw order, so blending stays in order without any locking. Spans
+// of four pixels are shaded together, one channel per SSE register
+// where available; sprites drawn at their texture's size without
+// rotation (the cached level, text) fetch their texels directly
+// instead of filtering them. The post effects mirror the
+// post_processor shaders, with the 3x3 kernels split into a
+// horizontal and a vertical pass.
+class SoftwareBackend : public RenderBackend
+{
+public:
+	// Size of the output in pixels
+	GLuint   Width, Height;
+	// Time spent rasterizing and post-processing since the last Clear, in ms
+	GLdouble RasterTime;
+	// Constructor (starts threads - 1 worker threads, 0 for one thread per core)/destructor
+	SoftwareBackend(GLuint width, GLuint height, GLuint threads = 0);
+	~SoftwareBackend();
+	virtual void DrawTriangles(const Texture2D &texture, const Vertex *vertices, GLsizei count, Blend blend);
+	virtual void DrawGlyphs(const Texture2D *glyphs, const Vertex *vertices, GLsizei quads);
+	virtual void BeginScene();
+	virtual void EndScene();
+	virtual void PresentScene(GLint effects, GLfloat time);
+	// Starts a frame: clears the output to opaque black
+	void                 Clear();
+	// Finishes all recorded draws and returns the output as RGBA8, rows top to bottom
+	const unsigned char *Pixels();
+	// Draws until EndLayer go into texture's headless image (which must be Width x Height), only inside the pixel
+	// rectangle [x0, x1) x [y0, y1), which is cleared to opaque black first; the rest of the image is kept.
+	// Like a GL_RGB render target, the layer keeps no alpha: its texels come out opaque
+	void                 BeginLayer(Texture2D &texture, GLint x0, GLint y0, GLint x1, GLint y1);
+	void                 EndLayer();
+private:
+	// Triangle set up for rasterization
+	struct Triangle
+	{
+		// Covered pixel rectangle [X0, X1) x [Y0, Y1), clipped to the target
+		GLint   X0, Y0, X1, Y1;
+		// Edge functions A * x + B * y + C in subpixels, non-negative inside (top-left rule folded into C)
+		long long EdgeA[3], EdgeB[3], EdgeC[3];
+		// Planes of the interpolated attributes: value at (x, y) = [0] + [1] * x + [2] * y
+		GLfloat U[3], V[3];
+		GLfloat Color[3][4];
+		const Texture2D::Image *Image;
+		GLboolean RepeatS, RepeatT, Linear;
+		// Every covered pixel (x, y) is exactly on the center of texel (x + TexelX, y + TexelY), which is inside the image
+		GLboolean Direct;
+		GLint     TexelX, TexelY;
+		// What the texture holds and how the result is blended
+		GLubyte Mode;
+	};
+	enum Mode {
+		MODE_ALPHA,
+		MODE_ADDITIVE,
+		MODE_GLYPH
+	};
+	enum Target {
+		TARGET_OUTPUT,
+		TARGET_SCENE,
+		TARGET_LAYER
+	};
+	enum Job {
+		JOB_RASTER,
+		JOB_POST,
+		JOB_RESOLVE
+	};
+	// Tiles are square and rasterized by one thread each
+	static const GLint TILE_SIZE = 64;
+	GLuint tilesX, tileCount;
+	// RGBA float images; the scene, the output, the layer and the output converted to bytes
+	std::vector<GLfloat>       scene, output, layer;
+	std::vector<unsigned char> pixels;
+	// Triangles recorded since the last flush, the image they go into, and whether it is cleared first
+	std::vector<Triangle> triangles;
+	Target                target, layerParent;
+	GLboolean             clearTarget;
+	// Pixel rectangle drawing is limited to: all of the target except for layers
+	GLint                 clipX0, clipY0, clipX1, clipY1;
+	// Image the layer is converted into by EndLayer
+	Texture2D::Image     *layerImage;
+	// JOB_RESOLVE converts resolveSource to RGBA8 in resolveTarget, inside the clip rectangle, with alpha 1 if resolveOpaque
+	const std::vector<GLfloat> *resolveSource;
+	unsigned char              *resolveTarget;
+	GLboolean                   resolveOpaque;
+	// Post effects for JOB_POST
+	GLint                 effects;
+	GLfloat               time;
+	// Worker pool: a dispatch bumps generation, every thread (the caller too) takes tiles until none are left
+	std::vector<std::thread> workers;
+	std::mutex               mutex;
+	std::condition_variable  wake, done;
+	GLuint                   generation, busy;
+	GLboolean                stopping;
+	Job                      job;
+	std::atomic<GLuint>      nextTile;
+	// Sets up a triangle and records it, unless it covers no pixels
+	void record(const Vertex &a, const Vertex &b, const Vertex &c, const Texture2D &texture, Mode mode);
+	// Rasterizes the recorded triangles into the current target
+	void flush();
+	// Runs a job over all tiles and returns once it is done
+	void dispatch(Job job);
+	void worker();
+	void work();
+	void rasterTile(GLuint tile);
+	void postTile(GLuint tile);
+	void resolveTile(GLuint tile);
+	// Pixel rectangle of a tile
+	void tileRect(GLuint tile, GLint &x0, GLint &y0, GLint &x1, GLint &y1) const;
+	// Not copyable, it owns threads
+	SoftwareBackend(const SoftwareBackend &);
+	SoftwareBackend &operator=(const SoftwareBackend &);
+};
+
+#endif
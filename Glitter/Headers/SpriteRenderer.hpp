@@ -6,25 +6,33 @@
 #define GLITTER_SPRITERENDERER_HPP
 
 
+#include <vector>
+
 #include <glm/vec2.hpp>
 #include <glad/glad.h>
 #include <glm/vec3.hpp>
-#include "Shader.hpp"
+#include "RenderBackend.hpp"
 #include "Texture2D.hpp"
 
 class SpriteRenderer
 {
 public:
-	SpriteRenderer(const Shader& shader);
-	~SpriteRenderer();
+	SpriteRenderer(RenderBackend &backend);
 
 	void DrawSprite(const Texture2D& texture, glm::vec2 position, glm::vec2 size = glm::vec2(10, 10), GLfloat rotate = 0.0f,
 			glm::vec3 color = glm::vec3(1.0f));
+	// Collects a sprite for DrawBatch instead of drawing it right away. A sprite with another texture object than the
+	// collected ones draws the batch first, so sprites sharing an atlas end up in a single draw call
+	void BatchSprite(const Texture2D& texture, glm::vec2 position, glm::vec2 size = glm::vec2(10, 10), GLfloat rotate = 0.0f,
+			glm::vec3 color = glm::vec3(1.0f));
+	// Draws the collected sprites in one call
+	void DrawBatch();
 
 private:
-	Shader shader;
-	GLuint quadVAO;
-	void initRenderData();
+	RenderBackend &backend;
+	// Texture and vertices of the sprites collected so far
+	Texture2D batchTexture;
+	std::vector<RenderBackend::Vertex> batch;
 
 };
 
@@ -0,0 +1,58 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef STATE_HASH_H
+#define STATE_HASH_H
+
+#include <glad/glad.h>
+
+#include "Fixed.hpp"
+
+
+// StateHash fingerprints a game's simulation state, one 64-bit hash
+// per part of it, so two runs (e.g. builds before and after an
+// optimization) can be checked for bit-identical simulation tick by
+// tick and a divergence pinned to the part that changed. Numbers are
+// hashed by their bits. The brick field is incremental: a level keeps
+// the XOR of BrickKey over its standing bricks and updates it when a
+// brick is destroyed, so hashing never walks the level. Balls and
+// falling power-ups are rescanned by design: every one of them moves
+// every tick, so contributions kept up to date on mutation would be
+// recomputed for all of them each tick anyway. A power-up adds its
+// TypeIndex rather than its name.
+struct StateHash
+{
+	enum Field {
+		// Game state, level, lives, power-up generator
+		FIELD_GAME,
+		FIELD_PADDLE,
+		FIELD_BALLS,
+		FIELD_BRICKS,
+		FIELD_POWER_UPS,
+		// Effect flags and the time left on their timers
+		FIELD_EFFECTS,
+		FIELDS
+	};
+	static const char *const FieldNames[FIELDS];
+	GLuint64 Fields[FIELDS];
+	StateHash() : Fields() { }
+	// Hash of all fields
+	GLuint64        Total() const;
+	// Mixes value into hash; the order of the values matters
+	static void     Add(GLuint64 &hash, GLuint64 value) { hash = Mix(hash ^ value); }
+	// Bit patterns of numbers, for Add
+	static GLuint64 Bits(GLfloat value);
+	static GLuint64 Bits(Fixed value) { return static_cast<GLuint>(value.Raw); }
+	static GLuint64 Bits(GLdouble value);
+	// Key of the brick at index in its level
+	static GLuint64 BrickKey(GLuint index) { return Mix(index + 0x9e3779b97f4a7c15ull); }
+	// Scrambles all bits of value (the splitmix64 finalizer)
+	static GLuint64 Mix(GLuint64 value);
+};
+
+#endif
@@ -0,0 +1,60 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <deque>
+
+#include <glad/glad.h>
+
+
+// A static StreamBuffer class holding the vertex data renderers
+// generate every frame in one large ring buffer, so writing it never
+// waits for the GPU to finish drawing earlier data. With GL 4.4 the
+// buffer is mapped persistently and every frame is fenced; a write
+// only waits when it would overwrite a frame the GPU still reads (the
+// ring is a few frames deep, so normally never). Older contexts map
+// each write unsynchronized and orphan the buffer's storage whenever
+// the ring wraps around. The buffer object stays the same either way,
+// so vertex arrays can be set up with it once.
+class StreamBuffer
+{
+public:
+	// Creates the buffer (render thread, before any renderer uses it)
+	static void      Init(GLsizeiptr capacity = 4 * 1024 * 1024);
+	static void      Clear();
+	// Buffer object all writes go to
+	static GLuint    Buffer();
+	// Copies size bytes into the buffer and returns their offset, a multiple of alignment; using the vertex size as
+	// alignment lets a draw call start at offset / vertex size with the attributes set up at offset 0. -1 if size doesn't fit
+	static GLintptr  Write(const void *data, GLsizeiptr size, GLsizeiptr alignment);
+	// Ends the current frame's writes (render thread, after its draw calls were issued)
+	static void      EndFrame();
+	// Whether the buffer is persistently mapped (GL 4.4) or falls back to orphaning
+	static GLboolean Persistent();
+private:
+	// Private constructor, all state is static
+	StreamBuffer() { }
+	// Fence for a frame's draw calls and the offset its writes started at
+	struct Fence
+	{
+		GLsync     Sync;
+		GLsizeiptr Begin;
+	};
+	static GLuint             buffer;
+	static GLsizeiptr         capacity, head, frameBegin;
+	static unsigned char     *mapping;
+	static std::deque<Fence>  fences;
+	// Whether size bytes at offset are not in use by the current frame or any frame still in flight
+	static GLboolean available(GLsizeiptr offset, GLsizeiptr size);
+	// Blocks until the oldest frame in flight is done and drops its fence
+	static void      retireOldest();
+};
+
+#endif
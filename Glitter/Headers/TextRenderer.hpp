@@ -6,13 +6,16 @@
 #define GLITTER_TEXTRENDERER_HPP
 
 #include <unordered_map>
+#include <vector>
+
 #include <glad/glad.h>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
-#include "Shader.hpp"
+#include "RenderBackend.hpp"
+#include "Texture2D.hpp"
 
 struct Character {
-	GLuint TextureID;
+	Texture2D Texture;
 	glm::ivec2 Size;
 	glm::ivec2 Bearing;
 	GLuint Advance;
@@ -22,12 +25,19 @@ class TextRenderer
 {
 public:
 	std::unordered_map<GLchar, Character> Characters;
-	Shader TextShader;
-	TextRenderer(GLuint width, GLuint height);
+	TextRenderer(RenderBackend &backend);
 	void RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color = glm::vec3(1.0f));
 	void Load(std::string font, GLuint fontSize);
+	// Re-rasterizes the glyphs for a new number of framebuffer pixels per game unit, so text stays sharp on high-DPI screens
+	void SetPixelScale(GLfloat pixelScale);
 private:
-	GLuint VAO, VBO;
+	RenderBackend &backend;
+	// Scratch space for the quads of one RenderText call and their glyphs
+	std::vector<RenderBackend::Vertex> vertices;
+	std::vector<Texture2D> glyphs;
+	std::string font;
+	GLuint fontSize;
+	GLfloat pixelScale;
 };
 
 
@@ -10,13 +10,26 @@
 #define TEXTURE_H
 
 
+#include <vector>
+
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "TextureCooker.hpp"
 
 // Texture2D is able to store and configure a texture in OpenGL.
 // It also hosts utility functions for easy management.
 class Texture2D
 {
 public:
+    // Image of a texture kept in memory: RGBA8 texels in the order they were given, expanded the way GL samples them
+    struct Image
+    {
+        GLuint                     Width, Height;
+        std::vector<unsigned char> Pixels;
+    };
+    // Keep texture images in memory instead of creating GL textures, for rendering without a GL context (SoftwareBackend)
+    static GLboolean Headless;
     // Holds the ID of the texture object, used for all texture operations to reference to this particlar texture
     GLuint ID;
     // Texture image dimensions
@@ -29,12 +42,25 @@ public:
     GLuint Wrap_T; // Wrapping mode on T axis
     GLuint Filter_Min; // Filtering mode if texture pixels < screen pixels
     GLuint Filter_Max; // Filtering mode if texture pixels > screen pixels
+    // Part of the texture object this texture covers, as texture coordinate offset (xy) and size (zw).
+    // All of it unless the texture is a sprite inside an atlas, which shares the atlas' ID
+    glm::vec4 UV;
     // Constructor (sets default texture modes)
     Texture2D();
     // Generates texture from image data
     void Generate(GLuint width, GLuint height, unsigned char* data);
+    // Generates texture from a cooked mip chain, taking over its internal format
+    void Generate(const CookedTexture &cooked);
     // Binds the texture as the current active GL_TEXTURE_2D texture object
     void Bind() const;
+    // Image of the texture object when Headless (shared by all sprites of an atlas), nullptr before Generate
+    const Image *Memory() const;
+    Image       *Memory();
+private:
+    // Headless images, ID - 1 indexes them
+    static std::vector<Image> images;
+    // Stores data (channels per texel, nullptr for black) as the texture object's headless image
+    void store(GLuint width, GLuint height, const unsigned char *data, GLuint channels);
 };
 
 #endif
@@ -0,0 +1,72 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+
+// S3TC formats are an extension, so the core GL headers may not have them
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// A texture in its GPU-ready form: a full (or truncated) mip chain,
+// block-compressed (BC1 without, BC3 with alpha) when the driver
+// supports it and plain RGBA8 otherwise, plus string metadata.
+struct CookedTexture
+{
+	GLuint InternalFormat;
+	GLuint Width, Height;
+	// Start and byte size of each mip level, largest first; they point into Storage or into memory owned by someone else
+	std::vector<const unsigned char*> Levels;
+	std::vector<GLsizei>              LevelSizes;
+	std::map<std::string, std::string> Metadata;
+	// Backing memory of the levels when the texture owns them
+	std::vector<unsigned char>         Storage;
+	// Whether InternalFormat is one of the block-compressed formats
+	GLboolean Compressed() const;
+};
+
+// A static TextureCooker class that turns decoded images into cooked
+// textures and reads/writes them as KTX 1.1 files, a container whose
+// levels can be handed to glCompressedTexImage2D/glTexImage2D as is.
+class TextureCooker
+{
+public:
+	// Builds the mip chain of an RGBA8 image (at most maxLevels levels, 0 for all of them) and compresses it if possible.
+	// alpha selects BC3 over BC1
+	static void      Cook(const unsigned char *rgba, GLuint width, GLuint height, GLboolean alpha, GLuint maxLevels, CookedTexture &texture);
+	// Reads a cooked texture file (through ResourcePack); false if it is missing or not a KTX file this cooker wrote
+	static GLboolean Load(const std::string &path, CookedTexture &texture);
+	// Parses a KTX image held in memory without copying it; the levels keep pointing into data
+	static GLboolean Parse(const unsigned char *data, size_t size, CookedTexture &texture);
+	static GLboolean Save(const std::string &path, const CookedTexture &texture);
+	// Whether the current GL context can sample textures of the given internal format
+	static GLboolean Supported(GLuint internalFormat);
+	// Bytes of video memory a cooked texture takes up
+	static size_t    MemorySize(const CookedTexture &texture);
+private:
+	// Private constructor, all functions are static
+	TextureCooker() { }
+	// Halves an RGBA8 image with a box filter
+	static void downsample(const std::vector<unsigned char> &source, GLuint width, GLuint height, std::vector<unsigned char> &target);
+	// Appends the BC1/BC3 blocks of an RGBA8 image
+	static void compress(const std::vector<unsigned char> &rgba, GLuint width, GLuint height, GLboolean alpha, std::vector<unsigned char> &blocks);
+};
+
+#endif
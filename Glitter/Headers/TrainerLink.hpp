@@ -0,0 +1,137 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef TRAINER_LINK_H
+#define TRAINER_LINK_H
+
+#include <atomic>
+#include <string>
+
+#include <glad/glad.h>
+
+#include "Game.hpp"
+
+
+// TrainerLink hands the state of many games to a training process and
+// takes its actions back through one POSIX shared memory segment, so
+// a step costs no copies, serialization or system calls per field.
+// The segment (/dev/shm/<name>) holds a Header, then Slots x Games
+// Observation records, then Slots x Games Action records, each part
+// 64-byte aligned; the layout is fixed and meant to be mirrored by the
+// trainer (e.g. as numpy structured arrays). Steps run in lockstep:
+//   1. The game writes step t's observations into slot t % Slots and
+//      stores Published = t + 1.
+//   2. The trainer waits until Published > t, reads slot t % Slots,
+//      writes one Action per game into slot t % Slots and stores
+//      Acted = t + 1 (or sets Stop first to end the session).
+//   3. The game waits until Acted > t, applies the actions, simulates
+//      a tick and publishes t + 1.
+// Because of the ring, records of step t stay intact while step t + 1
+// is written. Both sides spin on the counters for a while and only
+// then sleep in a futex wait on them; whoever sleeps increments the
+// counter's Sleepers word around the wait, and a side only makes the
+// FUTEX_WAKE call when Sleepers is non-zero. Linux only.
+class TrainerLink
+{
+public:
+	static const GLuint MAGIC = 0x4b4f5242; // "BROK"
+	static const GLuint VERSION = 1;
+	static const GLuint MAX_BALLS = 16, MAX_BRICKS = 512, MAX_POWER_UPS = 8;
+	// Power-up types, in the order of PowerUp::TypeNames, Observation::EffectTime and the bits of Observation::Effects
+	static const GLuint POWER_UP_TYPES = PowerUp::TYPES;
+	// Values of Action::Key: the key held down during the next tick
+	enum ActionKey {
+		ACTION_NONE,
+		ACTION_LEFT,
+		ACTION_RIGHT,
+		ACTION_LAUNCH
+	};
+	// A step counter the other side can sleep on, on its own cache line
+	struct alignas(64) Counter
+	{
+		std::atomic<GLuint> Value;
+		std::atomic<GLuint> Sleepers;
+	};
+	struct alignas(64) Header
+	{
+		GLuint  Magic, Version;
+		GLuint  Games, Slots;
+		GLuint  MaxBalls, MaxBricks, MaxPowerUps;
+		// sizeof(Observation) and sizeof(Action), for checking the trainer's mirror of the layout
+		GLuint  ObservationSize, ActionSize;
+		// Seconds of game time one step simulates
+		GLfloat Tick;
+		Counter Published, Acted;
+		// Set (non-zero) by the trainer before its last Acted store to end the session
+		std::atomic<GLuint> Stop;
+	};
+	// State of one game after a step; positions in game units (origin top left), velocities in units per second
+	struct alignas(64) Observation
+	{
+		GLuint   Step;
+		// GameState, current level and lives left
+		GLuint   State, Level, Lives;
+		// Paddle x, y, width, height
+		GLfloat  Paddle[4];
+		// Balls in play (up to MAX_BALLS): x, y, velocity x, velocity y; bit i of StuckBalls: ball i sits on the paddle
+		GLuint   BallCount, StuckBalls;
+		GLfloat  BallRadius;
+		GLfloat  Balls[MAX_BALLS][4];
+		// Bit per power-up type whose timed effect is running, and the seconds until it wears off
+		GLuint   Effects;
+		GLfloat  EffectTime[POWER_UP_TYPES];
+		// Falling power-ups (up to MAX_POWER_UPS, lowest first): x, y, type index
+		GLuint   FallingCount;
+		GLfloat  Falling[MAX_POWER_UPS][3];
+		// Bricks of the level in level order (up to MAX_BRICKS); bit i of Standing: brick i is not destroyed
+		GLuint   BrickCount;
+		GLuint64 Standing[MAX_BRICKS / 64];
+	};
+	// Action of one game for the next step
+	struct Action
+	{
+		// ActionKey
+		GLint  Key;
+		// Non-zero restarts the game (level reloaded, lives and paddle reset) before the step
+		GLuint Reset;
+	};
+	// Constructor/destructor (unmaps and removes the segment)
+	TrainerLink();
+	~TrainerLink();
+	// Creates the segment /name for games games, false on failure
+	GLboolean     Open(const std::string &name, GLuint games, GLfloat tick);
+	// Writes a game's state as its observation of the current step
+	void          Write(GLuint game, const Game &state);
+	// Makes the current step's observations visible to the trainer
+	void          Publish();
+	// Waits for the trainer's actions for the current step and advances to the next one; false once it asked to stop
+	GLboolean     WaitForActions();
+	// Actions of the step WaitForActions returned for
+	const Action &Actions(GLuint game) const;
+	// Steps published so far
+	GLuint        Step() const { return this->step; }
+private:
+	static const GLuint SLOTS = 4;
+	std::string   name;
+	int           fd;
+	void         *memory;
+	size_t        size;
+	Header       *header;
+	Observation  *observations;
+	Action       *actions;
+	GLuint        games, step;
+	// Spins, then sleeps until counter differs from value
+	static void   wait(Counter &counter, GLuint value);
+	// Stores value and wakes a sleeping waiter, if there is one
+	static void   signal(Counter &counter, GLuint value);
+	// Not copyable, it owns the mapping
+	TrainerLink(const TrainerLink &);
+	TrainerLink &operator=(const TrainerLink &);
+};
+
+#endif
@@ -0,0 +1,51 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+
+// Lock-free single producer/single consumer triple buffer. The writer
+// fills Back() and publishes it, the reader picks up the most recent
+// published slot with Consume() and reads it through Front(). Neither
+// side ever waits for the other; the writer simply overwrites frames
+// the reader did not get to.
+template <typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() : middle(1), back(2), front(0) { }
+	// Writer side: slot to fill, and hand it over to the reader
+	T   &Back() { return this->slots[this->back]; }
+	void Publish()
+	{
+		unsigned previous = this->middle.exchange(this->back | FRESH, std::memory_order_acq_rel);
+		this->back = previous & INDEX;
+	}
+	// Reader side: switches Front() to the newest published slot, returns false if nothing new was published
+	bool Consume()
+	{
+		if (!(this->middle.load(std::memory_order_relaxed) & FRESH))
+			return false;
+		unsigned previous = this->middle.exchange(this->front, std::memory_order_acq_rel);
+		this->front = previous & INDEX;
+		return true;
+	}
+	const T &Front() const { return this->slots[this->front]; }
+private:
+	// The shared middle index carries a flag telling whether it holds a frame the reader has not seen yet
+	static const unsigned FRESH = 4, INDEX = 3;
+	T slots[3];
+	std::atomic<unsigned> middle;
+	// Owned by the writer and reader thread respectively
+	unsigned back, front;
+};
+
+#endif
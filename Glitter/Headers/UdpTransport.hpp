@@ -0,0 +1,66 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#ifndef UDP_TRANSPORT_H
+#define UDP_TRANSPORT_H
+
+#include <chrono>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include <glad/glad.h>
+
+
+// UdpTransport exchanges datagrams with one peer over a non-blocking
+// UDP socket on the loopback interface. To try out netcode locally it
+// can make the connection worse than it is: sent datagrams are held
+// back for Latency ms and a Loss share of them is dropped, so two
+// processes (or two transports in one process) on the same machine
+// behave like players on a bad network. Linux only.
+class UdpTransport
+{
+public:
+	// Simulated one-way delay in ms and the share of datagrams dropped (0 to 1), applied on sending
+	GLdouble Latency, Loss;
+	// Datagrams handed to Send, dropped by the simulated loss and received
+	GLuint   Sent, Dropped, Received;
+	// Constructor/destructor (closes the socket)
+	UdpTransport();
+	~UdpTransport();
+	// Binds 127.0.0.1:port (0 picks a free port, see Port) and sends to 127.0.0.1:peerPort; false on failure
+	GLboolean Open(GLushort port, GLushort peerPort);
+	// Changes the port datagrams are sent to
+	void      SetPeer(GLushort peerPort);
+	// Port the socket is bound to
+	GLushort  Port() const { return this->port; }
+	// Queues a datagram for the peer; it goes out once the simulated latency has passed, unless it is lost
+	void      Send(const void *data, GLuint size);
+	// Copies the next datagram that arrived into data and returns its size, 0 if there is none (never blocks)
+	GLuint    Receive(void *data, GLuint capacity);
+	// Sends the held back datagrams that are due; Send and Receive call it too
+	void      Flush();
+private:
+	struct Delayed
+	{
+		std::chrono::steady_clock::time_point Due;
+		std::vector<unsigned char>            Data;
+	};
+	int                 socket;
+	GLushort            port, peerPort;
+	std::deque<Delayed> delayed;
+	// Decides which datagrams are lost; seeded from the port so runs differ per side but are repeatable
+	std::minstd_rand    random;
+	// Sends a datagram right away
+	void      transmit(const void *data, GLuint size);
+	// Not copyable, it owns the socket
+	UdpTransport(const UdpTransport &);
+	UdpTransport &operator=(const UdpTransport &);
+};
+
+#endif
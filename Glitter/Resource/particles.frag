@@ -1,24 +0,0 @@
-//#version 330 core
-//in vec2 TexCoords;
-//in vec4 ParticleColor;
-//
-//out vec4 Color;
-//
-//uniform sampler2D sprite;
-//
-//void main()
-//{
-//    Color = (texture(sprite, TexCoords) * ParticleColor);
-//}
-
-#version 330 core
-in vec2 TexCoords;
-in vec4 ParticleColor;
-out vec4 color;
-
-uniform sampler2D sprite;
-
-void main()
-{
-    color = (texture(sprite, TexCoords) * ParticleColor);
-}
\ No newline at end of file
@@ -1,49 +1,52 @@
 #version 330 core
+// Compiled once per effect combination; the CPU prepends CHAOS, CONFUSE and/or SHAKE
+// defines and picks the matching program, so no flag is tested per fragment.
 in vec2 TexCoords;
 out vec4 color;
 
 uniform sampler2D scene;
-uniform vec2 offsets[9];
-uniform int edge_kernel[9];
-uniform float blur_kernel[9];
+// Part of the scene texture that was rendered to this frame (dynamic resolution)
+uniform vec2 viewScale;
 
-uniform bool chaos;
-uniform bool confuse;
-uniform bool shake;
+// Kernel spacing in texture coordinates
+const float OFFSET = 1.0 / 300.0;
+
+// Samples the scene wrapping like GL_REPEAT, mapped into the rendered part of the texture
+// and kept half a texel inside it so filtering never picks up stale pixels
+vec3 fetchScene(vec2 uv)
+{
+    vec2 halfTexel = 0.5 / vec2(textureSize(scene, 0));
+    return texture(scene, clamp(fract(uv) * viewScale, halfTexel, viewScale - halfTexel)).rgb;
+}
 
 void main()
 {
-    color = vec4(0.0f);
-    vec3 sampled_color[9];
-    if(chaos || shake)
-    {
-        for(int i=0; i< 9; ++i)
-        {
-            sampled_color[i] = vec3(texture(scene, TexCoords.st + offsets[i]));
-        }
-    }
-    if(chaos)
-    {
-        for(int i=0; i< 9; ++i)
-        {
-            color += vec4(sampled_color[i] * edge_kernel[i], 0.0f);
-        }
-        color.a = 1.0f;
-    }
-    else if(confuse)
-    {
-        color = vec4(1.0 - texture(scene, TexCoords).rgb, 1.0);
-    }
-    else if(shake)
-    {
-        for(int i=0; i<9; ++i)
-        {
-            color += vec4(sampled_color[i] * blur_kernel[i], 0.0f);
-        }
-        color.a = 1.0f;
-    }
-    else
-    {
-        color = texture(scene, TexCoords);
-    }
+#if defined(CHAOS)
+    // Edge detection: 8 * center - sum of the 8 neighbours
+    vec3 neighbours = fetchScene(TexCoords + vec2(-OFFSET,  OFFSET))
+                    + fetchScene(TexCoords + vec2(    0.0,  OFFSET))
+                    + fetchScene(TexCoords + vec2( OFFSET,  OFFSET))
+                    + fetchScene(TexCoords + vec2(-OFFSET,     0.0))
+                    + fetchScene(TexCoords + vec2( OFFSET,     0.0))
+                    + fetchScene(TexCoords + vec2(-OFFSET, -OFFSET))
+                    + fetchScene(TexCoords + vec2(    0.0, -OFFSET))
+                    + fetchScene(TexCoords + vec2( OFFSET, -OFFSET));
+    color = vec4(8.0 * fetchScene(TexCoords) - neighbours, 1.0);
+#elif defined(CONFUSE)
+    color = vec4(1.0 - fetchScene(TexCoords), 1.0);
+#elif defined(SHAKE)
+    // 3x3 binomial blur ([1 2 1] / 4 per axis); the taps are OFFSET apart, several texels,
+    // so they cannot be folded into fewer bilinear taps and the weights are constants instead
+    vec3 corners = fetchScene(TexCoords + vec2(-OFFSET,  OFFSET))
+                 + fetchScene(TexCoords + vec2( OFFSET,  OFFSET))
+                 + fetchScene(TexCoords + vec2(-OFFSET, -OFFSET))
+                 + fetchScene(TexCoords + vec2( OFFSET, -OFFSET));
+    vec3 edges = fetchScene(TexCoords + vec2(    0.0,  OFFSET))
+               + fetchScene(TexCoords + vec2(-OFFSET,     0.0))
+               + fetchScene(TexCoords + vec2( OFFSET,     0.0))
+               + fetchScene(TexCoords + vec2(    0.0, -OFFSET));
+    color = vec4(corners / 16.0 + edges / 8.0 + fetchScene(TexCoords) / 4.0, 1.0);
+#else
+    color = vec4(fetchScene(TexCoords), 1.0);
+#endif
 }
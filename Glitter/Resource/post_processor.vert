@@ -3,34 +3,29 @@ layout (location = 0) in vec4 vertex;
 
 out vec2 TexCoords;
 
-uniform bool chaos;
-uniform bool confuse;
-uniform bool shake;
-uniform float time;
+// Shared by all programs and uploaded once per frame; layout matches FrameUniforms::Block
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    float time;
+};
 
 void main()
 {
     gl_Position = vec4(vertex.xy, 0.0f, 1.0f);
     vec2 texture = vertex.zw;
-    if(chaos)
-    {
-        float strength = 0.3;
-        vec2 pos = vec2(texture.x + sin(time) * strength, texture.y + cos(time) * strength);
-        TexCoords = pos;
-    }
-    else if(confuse)
-    {
-        TexCoords = vec2(1.0 - texture.x, 1.0 - texture.y);
-    }
-    else
-    {
-        TexCoords = texture;
-    }
+#if defined(CHAOS)
+    float strength = 0.3;
+    TexCoords = vec2(texture.x + sin(time) * strength, texture.y + cos(time) * strength);
+#elif defined(CONFUSE)
+    TexCoords = vec2(1.0 - texture.x, 1.0 - texture.y);
+#else
+    TexCoords = texture;
+#endif
 
-    if(shake)
-    {
-        float strength = 0.01;
-        gl_Position.x += cos(time * 10) * strength;
-        gl_Position.y += cos(time * 10) * strength;
-    }
-}
\ No newline at end of file
+#if defined(SHAKE)
+    float shake = 0.01;
+    gl_Position.x += cos(time * 10) * shake;
+    gl_Position.y += cos(time * 10) * shake;
+#endif
+}
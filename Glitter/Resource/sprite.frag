@@ -1,11 +1,15 @@
 #version 330 core
 in vec2 TexCoords;
+in vec4 SpriteColor;
 out vec4 color;
 
 uniform sampler2D image;
-uniform vec3 spriteColor;
 
 void main()
 {
-    color = vec4(spriteColor, 1.0) * texture(image, TexCoords);
+    color = SpriteColor * texture(image, TexCoords);
+#ifdef GRAYSCALE
+    // Luma into every channel, for single-channel targets
+    color.rgb = vec3(dot(color.rgb, vec3(0.299, 0.587, 0.114)));
+#endif
 }
\ No newline at end of file
@@ -2,12 +2,38 @@
 layout (location = 0) in vec4 vertex; // <vec2 position, vec2 texCoords>
 
 out vec2 TexCoords;
+out vec4 SpriteColor;
 
-uniform mat4 model;
-uniform mat4 projection;
+// Shared by all programs and uploaded once per frame; layout matches FrameUniforms::Block
+layout (std140) uniform Frame
+{
+    mat4 projection;
+    float time;
+};
+
+#ifdef INSTANCED
+// Instanced bricks: placement (position, size), part of the atlas and color per instance. Bricks
+// that are gone stay in the instance buffer and are collapsed to a point, so nothing is drawn
+layout (location = 1) in vec4 rect;
+layout (location = 2) in vec4 uvRect;
+layout (location = 3) in vec3 color;
+layout (location = 4) in float alive;
+
+void main()
+{
+    TexCoords = uvRect.xy + vertex.zw * uvRect.zw;
+    SpriteColor = vec4(color, 1.0);
+    gl_Position = alive * (projection * vec4(rect.xy + vertex.xy * rect.zw, 0.0, 1.0));
+}
+#else
+// Triangles come already transformed into game units and mapped into their texture, with their color per vertex
+// (RenderBackend::Vertex)
+layout (location = 1) in vec4 color;
 
 void main()
 {
     TexCoords = vertex.zw;
-    gl_Position = projection * model * vec4(vertex.xy, 0.0, 1.0);
-}
\ No newline at end of file
+    SpriteColor = color;
+    gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
+}
+#endif
@@ -0,0 +1,65 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "AtlasPacker.hpp"
+
+#include <algorithm>
+
+AtlasPacker::AtlasPacker(GLuint padding)
+	: Padding(padding)
+{
+}
+
+GLboolean AtlasPacker::Pack(const std::vector<glm::ivec2> &sizes, GLint maxSize, glm::ivec2 &atlasSize, std::vector<glm::ivec2> &positions) const
+{
+	// Tallest first keeps the rows tight
+	std::vector<GLuint> order(sizes.size());
+	for (GLuint i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::stable_sort(order.begin(), order.end(), [&sizes](GLuint a, GLuint b) { return sizes[a].y > sizes[b].y; });
+
+	// Grow the atlas one side at a time (wide before tall) until everything fits
+	for (atlasSize = glm::ivec2(64, 64); atlasSize.x <= maxSize && atlasSize.y <= maxSize; )
+	{
+		if (this->packInto(sizes, order, atlasSize, positions))
+			return GL_TRUE;
+		if (atlasSize.x <= atlasSize.y)
+			atlasSize.x *= 2;
+		else
+			atlasSize.y *= 2;
+	}
+	return GL_FALSE;
+}
+
+GLboolean AtlasPacker::packInto(const std::vector<glm::ivec2> &sizes, const std::vector<GLuint> &order, glm::ivec2 atlasSize, std::vector<glm::ivec2> &positions) const
+{
+	GLint padding = static_cast<GLint>(this->Padding);
+	positions.assign(sizes.size(), glm::ivec2(0));
+	GLint x = 0, y = 0, rowHeight = 0;
+	for (GLuint index : order)
+	{
+		// Rounded up so every sprite starts on a 4x4 block of the compressed atlas
+		GLint width = (sizes[index].x + 2 * padding + 3) & ~3;
+		GLint height = (sizes[index].y + 2 * padding + 3) & ~3;
+		if (width > atlasSize.x)
+			return GL_FALSE;
+		// Start a new row when this one is full
+		if (x + width > atlasSize.x)
+		{
+			x = 0;
+			y += rowHeight;
+			rowHeight = 0;
+		}
+		if (y + height > atlasSize.y)
+			return GL_FALSE;
+		positions[index] = glm::ivec2(x + padding, y + padding);
+		x += width;
+		rowHeight = std::max(rowHeight, height);
+	}
+	return GL_TRUE;
+}
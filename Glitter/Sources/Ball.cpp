@@ -1,8 +1,3 @@
-//
-// Created by liuhao on 2018/10/2.
-//
-
-#include "Ball.hpp"
 /******************************************************************
 ** This code is part of Breakout.
 **
@@ -11,47 +6,107 @@
 ** Creative Commons, either version 4 of the License, or (at your
 ** option) any later version.
 ******************************************************************/
+#include "Ball.hpp"
 
-BallObject::BallObject()
-		: GameObject(), Radius(12.5f), Stuck(true)  { }
+#include <algorithm>
 
-BallObject::BallObject(glm::vec2 pos, GLfloat radius, glm::vec2 velocity, Texture2D sprite)
-		:  GameObject(pos, glm::vec2(radius * 2, radius * 2), sprite, glm::vec3(1.0f), velocity),
-		Radius(radius), Stuck(true), Sticky(GL_FALSE), PassThrough(GL_FALSE) { }
+BallBatch::BallBatch()
+		: Radius(12.5f), Sticky(GL_FALSE), PassThrough(GL_FALSE), Color(1.0f), Sprite() { }
 
-glm::vec2 BallObject::Move(GLfloat dt, GLuint window_width)
+BallBatch::BallBatch(Real radius, Texture2D sprite)
+		: Radius(radius), Sticky(GL_FALSE), PassThrough(GL_FALSE), Color(1.0f), Sprite(sprite) { }
+
+void BallBatch::Add(Vec2 position, Vec2 velocity, GLboolean stuck, GLubyte owner)
 {
-	// If not stuck to player board
-	if (!this->Stuck)
+	this->PosX.push_back(position.x);
+	this->PosY.push_back(position.y);
+	this->VelX.push_back(velocity.x);
+	this->VelY.push_back(velocity.y);
+	this->Stuck.push_back(stuck);
+	this->Owner.push_back(owner);
+}
+
+void BallBatch::Reset()
+{
+	this->PosX.clear();
+	this->PosY.clear();
+	this->VelX.clear();
+	this->VelY.clear();
+	this->Stuck.clear();
+	this->Owner.clear();
+	this->Sticky = this->PassThrough = GL_FALSE;
+	this->Color = glm::vec3(1.0f);
+}
+
+void BallBatch::Move(GLfloat dt, GLuint window_width)
+{
+	// Branch-free body so the loop vectorizes: stuck balls get a zero step
+	const GLuint n = this->Count();
+	const Real zero = 0, tick = dt;
+	const Real right = window_width - this->Radius * 2;
+	Real *px = this->PosX.data(), *py = this->PosY.data();
+	Real *vx = this->VelX.data(), *vy = this->VelY.data();
+	const GLboolean *stuck = this->Stuck.data();
+	for (GLuint i = 0; i < n; ++i)
 	{
-		// Move the ball
-		this->Position += this->Velocity * dt;
+		Real step = stuck[i] ? zero : tick;
+		Real x = px[i] + vx[i] * step;
+		Real y = py[i] + vy[i] * step;
 		// Then check if outside window bounds and if so, reverse velocity and restore at correct position
-		if (this->Position.x <= 0.0f)
-		{
-			this->Velocity.x = -this->Velocity.x;
-			this->Position.x = 0.0f;
-		}
-		else if (this->Position.x + this->Size.x >= window_width)
-		{
-			this->Velocity.x = -this->Velocity.x;
-			this->Position.x = window_width - this->Size.x;
-		}
-		if (this->Position.y <= 0.0f)
-		{
-			this->Velocity.y = -this->Velocity.y;
-			this->Position.y = 0.0f;
-		}
+		GLboolean hitLeft = x <= zero, hitRight = x >= right, hitTop = y <= zero;
+		GLboolean free = !stuck[i];
+		vx[i] = free && (hitLeft || hitRight) ? -vx[i] : vx[i];
+		vy[i] = free && hitTop ? -vy[i] : vy[i];
+		px[i] = free && hitLeft ? zero : (free && hitRight ? right : x);
+		py[i] = free && hitTop ? zero : y;
+	}
+}
+
+GLuint BallBatch::Overlap(Vec2 position, Vec2 size, std::vector<GLubyte> &hits) const
+{
+	// Closest point on the box to each circle center, compared against the radius (see CheckCollision in Game.cpp)
+	const GLuint n = this->Count();
+	const Real r = this->Radius, r2 = r * r;
+	const Real hx = size.x / 2, hy = size.y / 2;
+	const Real cx = position.x + hx, cy = position.y + hy;
+	const Real *px = this->PosX.data(), *py = this->PosY.data();
+	hits.resize(n);
+	GLubyte *out = hits.data();
+	GLuint count = 0;
+	for (GLuint i = 0; i < n; ++i)
+	{
+		Real dx = px[i] + r - cx, dy = py[i] + r - cy;
+		Real qx = std::min(std::max(dx, -hx), hx) - dx;
+		Real qy = std::min(std::max(dy, -hy), hy) - dy;
+		// Far balls are rejected per axis first, so the squares stay small enough for fixed-point
+		GLubyte hit = (Abs(qx) < r) & (Abs(qy) < r) & (qx * qx + qy * qy < r2);
+		out[i] = hit;
+		count += hit;
 	}
-	return this->Position;
+	return count;
 }
 
-// Resets the ball to initial Stuck Position (if ball is outside window bounds)
-void BallObject::Reset(glm::vec2 position, glm::vec2 velocity)
+GLuint BallBatch::RemoveBelow(Real bottom)
 {
-	this->Position = position;
-	this->Velocity = velocity;
-	this->Stuck = GL_TRUE;
-	this->PassThrough = GL_FALSE;
-	this->Sticky = GL_FALSE;
+	const GLuint n = this->Count();
+	GLuint kept = 0;
+	for (GLuint i = 0; i < n; ++i)
+	{
+		if (this->PosY[i] >= bottom)
+			continue;
+		this->PosX[kept] = this->PosX[i];
+		this->PosY[kept] = this->PosY[i];
+		this->VelX[kept] = this->VelX[i];
+		this->VelY[kept] = this->VelY[i];
+		this->Stuck[kept] = this->Stuck[i];
+		this->Owner[kept] = this->Owner[i];
+		++kept;
+	}
+	this->PosX.resize(kept);
+	this->PosY.resize(kept);
+	this->VelX.resize(kept);
+	this->VelY.resize(kept);
+	this->Stuck.resize(kept);
+	this->Owner.resize(kept);
+	return n - kept;
 }
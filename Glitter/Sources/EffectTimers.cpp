@@ -0,0 +1,55 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "EffectTimers.hpp"
+
+#include <algorithm>
+
+
+EffectTimers::EffectTimers()
+	: running(), until()
+{
+}
+
+void EffectTimers::Start(TimedEffect effect, GLdouble now, GLdouble duration)
+{
+	Timer timer = { now + duration, static_cast<GLuint>(effect) };
+	this->heap.push_back(timer);
+	std::push_heap(this->heap.begin(), this->heap.end());
+	++this->running[effect];
+	this->until[effect] = std::max(this->until[effect], timer.Expiry);
+}
+
+GLboolean EffectTimers::Expire(GLdouble now, TimedEffect &effect)
+{
+	while (!this->heap.empty() && this->heap.front().Expiry <= now)
+	{
+		GLuint expired = this->heap.front().Effect;
+		std::pop_heap(this->heap.begin(), this->heap.end());
+		this->heap.pop_back();
+		if (--this->running[expired] == 0)
+		{
+			this->until[expired] = 0.0;
+			effect = static_cast<TimedEffect>(expired);
+			return GL_TRUE;
+		}
+	}
+	return GL_FALSE;
+}
+
+void EffectTimers::Clear()
+{
+	this->heap.clear();
+	std::fill(this->running, this->running + TIMED_EFFECTS, 0u);
+	std::fill(this->until, this->until + TIMED_EFFECTS, 0.0);
+}
+
+GLdouble EffectTimers::Remaining(TimedEffect effect, GLdouble now) const
+{
+	return this->running[effect] > 0 ? std::max(0.0, this->until[effect] - now) : 0.0;
+}
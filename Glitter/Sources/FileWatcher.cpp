@@ -0,0 +1,83 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "FileWatcher.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+FileWatcher::FileWatcher() : fd(-1)
+{
+#ifdef __linux__
+	this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (this->fd < 0)
+		std::cout << "ERROR::WATCHER: Failed to initialize inotify" << std::endl;
+#else
+	std::cout << "ERROR::WATCHER: Watching files needs inotify (Linux)" << std::endl;
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (this->fd >= 0)
+		close(this->fd);
+#endif
+}
+
+GLboolean FileWatcher::Watch(const std::string &directory)
+{
+#ifdef __linux__
+	if (this->fd < 0)
+		return GL_FALSE;
+	// Editors either write a file in place or write a temporary and rename it over the original
+	int watch = inotify_add_watch(this->fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (watch < 0)
+	{
+		std::cout << "ERROR::WATCHER: Failed to watch " << directory << std::endl;
+		return GL_FALSE;
+	}
+	this->directories[watch] = directory;
+	return GL_TRUE;
+#else
+	return GL_FALSE;
+#endif
+}
+
+std::vector<std::string> FileWatcher::Changes()
+{
+	std::vector<std::string> changes;
+#ifdef __linux__
+	if (this->fd < 0)
+		return changes;
+	alignas(inotify_event) char buffer[4096];
+	ssize_t length;
+	// Non-blocking: read fails with EAGAIN once the queue is drained
+	while ((length = read(this->fd, buffer, sizeof(buffer))) > 0)
+	{
+		for (char *cursor = buffer; cursor < buffer + length; )
+		{
+			const inotify_event *event = reinterpret_cast<const inotify_event*>(cursor);
+			cursor += sizeof(inotify_event) + event->len;
+			if (event->len == 0 || (event->mask & IN_ISDIR) != 0 || this->directories.count(event->wd) == 0)
+				continue;
+			std::string path = this->directories[event->wd] + "/" + event->name;
+			// Saving a file often shows up as several events
+			if (std::find(changes.begin(), changes.end(), path) == changes.end())
+				changes.push_back(path);
+		}
+	}
+#endif
+	return changes;
+}
@@ -0,0 +1,151 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "FrameCapture.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "GLState.hpp"
+#include "ResourcePack.hpp"
+#include "SoftwareBackend.hpp"
+
+
+FrameCapture::FrameCapture(GLuint width, GLuint height, SoftwareBackend *software)
+	: Every(60), Tolerance(2), MaxDifferentPixels(0.001f), Failures(0), width(width), height(height), software(software),
+	  FBO(0), texture(0), pixels(width * height * 4), image(width * height * 4)
+{
+	if (software != nullptr)
+		return;
+	glGenFramebuffers(1, &this->FBO);
+	glGenTextures(1, &this->texture);
+	GLState::BindTexture(GL_TEXTURE_2D, this->texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::CAPTURE: Failed to initialize FBO" << std::endl;
+	glGenQueries(2, this->queries);
+	// Everything that would have gone to the window ends up here from now on
+	GLState::OutputFramebuffer = this->FBO;
+}
+
+FrameCapture::~FrameCapture()
+{
+	if (this->software != nullptr)
+		return;
+	GLState::OutputFramebuffer = 0;
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+	GLState::DeleteFramebuffer(this->FBO);
+	GLState::DeleteTexture(this->texture);
+	glDeleteQueries(2, this->queries);
+}
+
+GLboolean FrameCapture::Begin()
+{
+	if (!this->log.is_open())
+	{
+		this->log.open(this->Directory + "/frames.txt");
+		if (!this->log)
+		{
+			std::cout << "ERROR::CAPTURE: Failed to write to " << this->Directory << std::endl;
+			++this->Failures;
+			return GL_FALSE;
+		}
+		this->log << "# frame hash cpu_ms gpu_ms" << std::endl;
+	}
+	if (this->software != nullptr)
+	{
+		this->software->Clear();
+		return GL_TRUE;
+	}
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glQueryCounter(this->queries[0], GL_TIMESTAMP);
+	return GL_TRUE;
+}
+
+void FrameCapture::End(GLuint frame, GLdouble cpuTime)
+{
+	size_t row = this->width * 4;
+	GLdouble renderTime;
+	if (this->software != nullptr)
+	{
+		// Software output is already top to bottom
+		const unsigned char *output = this->software->Pixels();
+		this->image.assign(output, output + this->image.size());
+		renderTime = this->software->RasterTime;
+	}
+	else
+	{
+		glQueryCounter(this->queries[1], GL_TIMESTAMP);
+		// Reading back waits for the frame anyway, so the timestamps are ready afterwards
+		GLState::BindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, this->pixels.data());
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(this->queries[0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(this->queries[1], GL_QUERY_RESULT, &end);
+		renderTime = (end - begin) / 1.0e6;
+
+		// GL rows start at the bottom, images at the top
+		for (GLuint y = 0; y < this->height; ++y)
+			std::memcpy(&this->image[y * row], &this->pixels[(this->height - 1 - y) * row], row);
+	}
+	unsigned long long hash = ResourcePack::Hash(this->image.data(), this->image.size());
+	this->log << frame << " " << std::hex << std::setw(16) << std::setfill('0') << hash << std::dec << std::setfill(' ')
+	          << std::fixed << std::setprecision(3) << " " << cpuTime << " " << renderTime << std::endl;
+
+	if (this->Every == 0 || frame % this->Every != 0)
+		return;
+	char name[32];
+	std::snprintf(name, sizeof(name), "frame_%05u.png", frame);
+	if (!stbi_write_png((this->Directory + "/" + name).c_str(), this->width, this->height, 4, this->image.data(), static_cast<int>(row)))
+		std::cout << "ERROR::CAPTURE: Failed to write " << name << std::endl;
+	if (!this->Golden.empty() && !this->compare(name))
+		++this->Failures;
+}
+
+GLboolean FrameCapture::compare(const std::string &name)
+{
+	int width, height, channel;
+	unsigned char *golden = stbi_load((this->Golden + "/" + name).c_str(), &width, &height, &channel, 4);
+	if (golden == nullptr || static_cast<GLuint>(width) != this->width || static_cast<GLuint>(height) != this->height)
+	{
+		std::cout << "CAPTURE: " << name << " has no golden image of the same size" << std::endl;
+		stbi_image_free(golden);
+		return GL_FALSE;
+	}
+	size_t different = 0;
+	GLint largest = 0;
+	for (size_t pixel = 0; pixel < this->image.size(); pixel += 4)
+	{
+		GLint difference = 0;
+		for (size_t c = 0; c < 4; ++c)
+			difference = std::max(difference, std::abs(static_cast<GLint>(this->image[pixel + c]) - golden[pixel + c]));
+		largest = std::max(largest, difference);
+		if (difference > this->Tolerance)
+			++different;
+	}
+	stbi_image_free(golden);
+	GLfloat fraction = static_cast<GLfloat>(different) / (this->width * this->height);
+	if (fraction <= this->MaxDifferentPixels)
+		return GL_TRUE;
+	std::cout << "CAPTURE: " << name << " differs from its golden image in " << different << " pixels (" << fraction * 100.0f
+	          << "%), by up to " << largest << std::endl;
+	return GL_FALSE;
+}
@@ -0,0 +1,67 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "FrameUniforms.hpp"
+
+#include "GLState.hpp"
+
+// Instantiate static variables
+glm::mat4 FrameUniforms::Projection(1.0f);
+GLfloat   FrameUniforms::Time = 0.0f;
+GLuint    FrameUniforms::buffer = 0;
+GLintptr  FrameUniforms::flippedOffset = 0;
+
+
+void FrameUniforms::Init()
+{
+	static_assert(sizeof(Block) == 80, "Block has to match the std140 layout of the Frame block");
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	flippedOffset = (sizeof(Block) + alignment - 1) / alignment * alignment;
+	glGenBuffers(1, &buffer);
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, flippedOffset + sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+}
+
+void FrameUniforms::Clear()
+{
+	GLState::DeleteBuffer(buffer);
+	buffer = 0;
+}
+
+void FrameUniforms::Attach(GLuint program)
+{
+	GLuint index = glGetUniformBlockIndex(program, "Frame");
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, index, BINDING);
+}
+
+void FrameUniforms::Upload()
+{
+	Block block;
+	block.Projection = Projection;
+	block.Time = Time;
+	block.Padding[0] = block.Padding[1] = block.Padding[2] = 0.0f;
+	// Flipping y in clip space turns the screen projection upside down
+	Block flipped = block;
+	for (GLuint column = 0; column < 4; ++column)
+		flipped.Projection[column][1] = -flipped.Projection[column][1];
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+	glBufferSubData(GL_UNIFORM_BUFFER, flippedOffset, sizeof(Block), &flipped);
+	BindFlipped(GL_FALSE);
+}
+
+void FrameUniforms::BindFlipped(GLboolean flipped)
+{
+	glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, buffer, flipped ? flippedOffset : 0, sizeof(Block));
+	// Indexed binds also replace the generic binding
+	GLState::BindBuffer(GL_UNIFORM_BUFFER, buffer);
+	// Flipping mirrors the winding, so front faces would be culled otherwise
+	glFrontFace(flipped ? GL_CW : GL_CCW);
+}
@@ -0,0 +1,97 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "GLBackend.hpp"
+
+#include "FrameUniforms.hpp"
+#include "GLState.hpp"
+#include "StreamBuffer.hpp"
+
+
+GLBackend::GLBackend(const Shader &spriteShader, const Shader &textShader, PostProcessor *effects)
+	: spriteShader(spriteShader), textShader(textShader), effects(effects)
+{
+	// Both programs read <vec2 position, vec2 texCoords> and color
+	glGenVertexArrays(1, &this->VAO);
+	GLState::BindVertexArray(this->VAO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, StreamBuffer::Buffer());
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(4 * sizeof(GLfloat)));
+}
+
+GLBackend::~GLBackend()
+{
+	GLState::DeleteVertexArray(this->VAO);
+}
+
+void GLBackend::DrawTriangles(const Texture2D &texture, const Vertex *vertices, GLsizei count, Blend blend)
+{
+	GLint first = this->write(vertices, count);
+	if (first < 0)
+		return;
+	// Additive blending gives particles their 'glow'
+	if (blend == BLEND_ADDITIVE)
+		GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE);
+	this->spriteShader.Use();
+	GLState::ActiveTexture(GL_TEXTURE0);
+	texture.Bind();
+	GLState::BindVertexArray(this->VAO);
+	glDrawArrays(GL_TRIANGLES, first, count);
+	if (blend == BLEND_ADDITIVE)
+		GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void GLBackend::DrawGlyphs(const Texture2D *glyphs, const Vertex *vertices, GLsizei quads)
+{
+	GLint first = this->write(vertices, quads * 6);
+	if (first < 0)
+		return;
+	// Every glyph still has its own texture, but the whole string went into the stream buffer at once
+	this->textShader.Use();
+	GLState::ActiveTexture(GL_TEXTURE0);
+	GLState::BindVertexArray(this->VAO);
+	for (GLsizei i = 0; i < quads; ++i, first += 6)
+	{
+		glyphs[i].Bind();
+		glDrawArrays(GL_TRIANGLES, first, 6);
+	}
+}
+
+void GLBackend::BeginScene()
+{
+	if (this->effects != nullptr)
+		this->effects->BeginRender();
+}
+
+void GLBackend::EndScene()
+{
+	if (this->effects != nullptr)
+		this->effects->EndRender();
+}
+
+void GLBackend::PresentScene(GLint effects, GLfloat /*time*/)
+{
+	if (this->effects == nullptr)
+		return;
+	// The post-processing shaders read the time from the Frame block
+	this->effects->Chaos = (effects & FrameUniforms::EFFECT_CHAOS) != 0;
+	this->effects->Confuse = (effects & FrameUniforms::EFFECT_CONFUSE) != 0;
+	this->effects->Shake = (effects & FrameUniforms::EFFECT_SHAKE) != 0;
+	this->effects->Render();
+}
+
+GLint GLBackend::write(const Vertex *vertices, GLsizei count)
+{
+	if (count <= 0)
+		return -1;
+	const GLsizeiptr stride = sizeof(Vertex);
+	GLintptr offset = StreamBuffer::Write(vertices, count * stride, stride);
+	return offset < 0 ? -1 : static_cast<GLint>(offset / stride);
+}
@@ -0,0 +1,204 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "GLState.hpp"
+
+static const GLuint UNKNOWN = static_cast<GLuint>(-1);
+
+// Instantiate static variables
+GLuint GLState::Issued = 0;
+GLuint GLState::Skipped = 0;
+GLuint GLState::OutputFramebuffer = 0;
+GLuint GLState::program = UNKNOWN;
+GLuint GLState::activeUnit = UNKNOWN;
+GLuint GLState::textures[GLState::MAX_TEXTURE_UNITS] = {
+		UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+		UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN
+};
+GLuint GLState::vertexArray = UNKNOWN;
+GLuint GLState::arrayBuffer = UNKNOWN;
+GLuint GLState::elementBuffer = UNKNOWN;
+GLuint GLState::uniformBuffer = UNKNOWN;
+GLuint GLState::readFramebuffer = UNKNOWN;
+GLuint GLState::drawFramebuffer = UNKNOWN;
+GLenum GLState::blendSrc = UNKNOWN;
+GLenum GLState::blendDst = UNKNOWN;
+
+
+void GLState::UseProgram(GLuint program)
+{
+	if (GLState::program == program)
+	{
+		++Skipped;
+		return;
+	}
+	glUseProgram(program);
+	GLState::program = program;
+	++Issued;
+}
+
+void GLState::ActiveTexture(GLenum unit)
+{
+	GLuint index = unit - GL_TEXTURE0;
+	if (activeUnit == index)
+	{
+		++Skipped;
+		return;
+	}
+	glActiveTexture(unit);
+	activeUnit = index;
+	++Issued;
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture)
+{
+	// Only 2D textures are shadowed, and only on units we know about
+	if (target != GL_TEXTURE_2D || activeUnit >= MAX_TEXTURE_UNITS)
+	{
+		glBindTexture(target, texture);
+		++Issued;
+		return;
+	}
+	if (textures[activeUnit] == texture)
+	{
+		++Skipped;
+		return;
+	}
+	glBindTexture(target, texture);
+	textures[activeUnit] = texture;
+	++Issued;
+}
+
+void GLState::BindVertexArray(GLuint vao)
+{
+	if (vertexArray == vao)
+	{
+		++Skipped;
+		return;
+	}
+	glBindVertexArray(vao);
+	vertexArray = vao;
+	// The element array binding is part of the VAO, so it changes along with it
+	elementBuffer = UNKNOWN;
+	++Issued;
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer)
+{
+	GLuint *slot = bufferSlot(target);
+	if (slot != nullptr && *slot == buffer)
+	{
+		++Skipped;
+		return;
+	}
+	glBindBuffer(target, buffer);
+	if (slot != nullptr)
+		*slot = buffer;
+	++Issued;
+}
+
+void GLState::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	GLboolean read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	GLboolean draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	if ((!read || readFramebuffer == framebuffer) && (!draw || drawFramebuffer == framebuffer))
+	{
+		++Skipped;
+		return;
+	}
+	glBindFramebuffer(target, framebuffer);
+	if (read)
+		readFramebuffer = framebuffer;
+	if (draw)
+		drawFramebuffer = framebuffer;
+	++Issued;
+}
+
+void GLState::BlendFunc(GLenum sfactor, GLenum dfactor)
+{
+	if (blendSrc == sfactor && blendDst == dfactor)
+	{
+		++Skipped;
+		return;
+	}
+	glBlendFunc(sfactor, dfactor);
+	blendSrc = sfactor;
+	blendDst = dfactor;
+	++Issued;
+}
+
+void GLState::DeleteProgram(GLuint program)
+{
+	glDeleteProgram(program);
+	// A current program is only flagged for deletion, it stays in use; nothing to forget
+}
+
+void GLState::DeleteTexture(GLuint texture)
+{
+	glDeleteTextures(1, &texture);
+	for (GLuint i = 0; i < MAX_TEXTURE_UNITS; ++i)
+		if (textures[i] == texture)
+			textures[i] = 0;
+}
+
+void GLState::DeleteVertexArray(GLuint vao)
+{
+	glDeleteVertexArrays(1, &vao);
+	if (vertexArray == vao)
+		vertexArray = 0;
+}
+
+void GLState::DeleteBuffer(GLuint buffer)
+{
+	glDeleteBuffers(1, &buffer);
+	if (arrayBuffer == buffer)
+		arrayBuffer = 0;
+	if (elementBuffer == buffer)
+		elementBuffer = 0;
+	if (uniformBuffer == buffer)
+		uniformBuffer = 0;
+}
+
+void GLState::DeleteFramebuffer(GLuint framebuffer)
+{
+	glDeleteFramebuffers(1, &framebuffer);
+	if (readFramebuffer == framebuffer)
+		readFramebuffer = 0;
+	if (drawFramebuffer == framebuffer)
+		drawFramebuffer = 0;
+}
+
+void GLState::Invalidate()
+{
+	program = activeUnit = vertexArray = UNKNOWN;
+	arrayBuffer = elementBuffer = uniformBuffer = UNKNOWN;
+	readFramebuffer = drawFramebuffer = UNKNOWN;
+	blendSrc = blendDst = UNKNOWN;
+	for (GLuint i = 0; i < MAX_TEXTURE_UNITS; ++i)
+		textures[i] = UNKNOWN;
+}
+
+void GLState::ResetCounters()
+{
+	Issued = Skipped = 0;
+}
+
+GLuint *GLState::bufferSlot(GLenum target)
+{
+	switch (target)
+	{
+		case GL_ARRAY_BUFFER:
+			return &arrayBuffer;
+		case GL_ELEMENT_ARRAY_BUFFER:
+			return &elementBuffer;
+		case GL_UNIFORM_BUFFER:
+			return &uniformBuffer;
+		default:
+			return nullptr;
+	}
+}
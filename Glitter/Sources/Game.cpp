@@ -6,6 +6,8 @@
 ** Creative Commons, either version 4 of the License, or (at your
 ** option) any later version.
 ******************************************************************/
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <sstream>
 
@@ -17,63 +19,109 @@
 #include "ParticleGenerator.hpp"
 #include "PostProcessor.hpp"
 #include "TextRenderer.hpp"
+#include "LevelCache.hpp"
+#include "FileWatcher.hpp"
+#include "StreamBuffer.hpp"
+#include "FrameUniforms.hpp"
+#include "GLBackend.hpp"
+#include "SoftwareBackend.hpp"
 
 
 //ISoundEngine* SoundEngine = createIrrKlangDevice();
 
-// Game-related State data
-SpriteRenderer    *Renderer;
-GameObject        *Player;
-BallObject        *Ball;
-ParticleGenerator *Particles;
-PostProcessor     *Effects;
-TextRenderer    *Text;
-
-GLfloat ShakeTime = 0.0f;
-
 Game::Game(GLuint width, GLuint height)
-		: State(GAME_MENU), Keys(), Width(width), Height(height), Lives(3)
+		: State(GAME_MENU), Keys(), InputTime(0.0), Width(width), Height(height), Lives(3), Clock(0.0), Versus(GL_FALSE), Scores(), Replaying(GL_FALSE), BallCount(1), Random(1),
+		  Confuse(GL_FALSE), Chaos(GL_FALSE), Shake(GL_FALSE), Samples(4), RenderScale(1.0f), TargetGpuTime(0.0f), HotReload(GL_FALSE), Software(GL_FALSE), Rasterizer(nullptr), Jobs(nullptr), ParticleCount(500), time(0.0), trailBall(0),
+		  framebufferSize(static_cast<unsigned long long>(width) << 32 | height), appliedFramebufferSize(0),
+		  renderer(nullptr), particles(nullptr), effects(nullptr), text(nullptr), brickCache(nullptr), backend(nullptr), watcher(nullptr)
 {
+	// Stages of a tick. The balls have to move before they are tested against the bricks; the particles follow the balls
+	// where the collisions left them and the power-ups are moved after the paddles had the chance to catch them, but
+	// neither touches what the other does, so those two run at the same time
+	GLuint move = this->stages.Add("move balls", [this]() { this->Balls.Move(this->stepTime, this->Width); });
+	GLuint broad = this->stages.Add("broad phase", [this]() { this->broadPhase(); }, { move });
+	GLuint collisions = this->stages.Add("collisions", [this]() { this->DoCollisions(this->stepTime); }, { broad });
+	this->stages.Add("particles", [this]() { this->updateParticles(this->stepTime); }, { collisions });
+	this->stages.Add("power-ups", [this]() { this->UpdatePowerUps(this->stepTime); }, { collisions });
 }
 
 Game::~Game()
 {
-	delete Renderer;
-	delete Player;
-	delete Ball;
-	delete Particles;
-	delete Effects;
+	delete this->renderer;
+	delete this->particles;
+	delete this->text;
+	delete this->backend;
+	delete this->effects;
+	delete this->brickCache;
+	delete this->watcher;
 }
 
 void Game::Init()
 {
-	// Load shaders
-	ResourceManager::LoadShader("Resource/sprite.vert", "Resource/sprite.frag", nullptr, "sprite");
-	ResourceManager::LoadShader("Resource/particles.vert", "Resource/particles.frag", nullptr, "particle");
-	ResourceManager::LoadShader("Resource/post_processor.vert", "Resource/post_processor.frag", nullptr, "post_processing");
-	// Configure shaders
-	glm::mat4 projection = glm::ortho(0.0f, static_cast<GLfloat>(this->Width), static_cast<GLfloat>(this->Height), 0.0f, -1.0f, 1.0f);
-	ResourceManager::GetShader("sprite").Use().SetInteger("sprite", 0);
-	ResourceManager::GetShader("sprite").SetMatrix4("projection", projection);
-	ResourceManager::GetShader("particle").Use().SetInteger("sprite", 0);
-	ResourceManager::GetShader("particle").SetMatrix4("projection", projection);
+	std::vector<Shader> postVariants;
+	if (!this->Software)
+	{
+		// Per-frame vertex data of all renderers is streamed through one buffer
+		StreamBuffer::Init();
+		// Projection, time and effect flags are shared by all programs through one uniform block
+		FrameUniforms::Init();
+		// Load shaders; particles are drawn by the sprite program with additive blending
+		ResourceManager::LoadShader("Resource/sprite.vert", "Resource/sprite.frag", nullptr, "sprite");
+		ResourceManager::LoadShader("Resource/sprite.vert", "Resource/sprite.frag", nullptr, "sprite_instanced", "#define INSTANCED\n");
+		ResourceManager::LoadShader("Resource/text.vert", "Resource/text.frag", nullptr, "text");
+		ResourceManager::LoadShader("Resource/sprite.vert", "Resource/sprite.frag", nullptr, "sprite_observation", "#define GRAYSCALE\n");
+		for (GLuint i = 0; i < PostProcessor::VARIANT_COUNT; ++i)
+			postVariants.push_back(ResourceManager::LoadShader("Resource/post_processor.vert", "Resource/post_processor.frag", nullptr,
+			                                                   "post_processing_" + std::to_string(i), PostProcessor::VariantDefines(i)));
+		// Configure shaders
+		FrameUniforms::Projection = glm::ortho(0.0f, static_cast<GLfloat>(this->Width), static_cast<GLfloat>(this->Height), 0.0f, -1.0f, 1.0f);
+		ResourceManager::GetShader("sprite").Use().SetInteger("image", 0);
+		ResourceManager::GetShader("sprite_instanced").Use().SetInteger("image", 0);
+		ResourceManager::GetShader("sprite_observation").Use().SetInteger("image", 0);
+		ResourceManager::GetShader("text").Use().SetInteger("text", 0);
+	}
 	// Load textures
 	ResourceManager::LoadTexture("Resource/background.jpg", GL_FALSE, "background");
-	ResourceManager::LoadTexture("Resource/awesomeface.png", GL_TRUE, "face");
-	ResourceManager::LoadTexture("Resource/block.png", GL_FALSE, "block");
-	ResourceManager::LoadTexture("Resource/block_solid.png", GL_FALSE, "block_solid");
-	ResourceManager::LoadTexture("Resource/paddle.png", GL_TRUE, "paddle");
-	ResourceManager::LoadTexture("Resource/particle.png", GL_TRUE, "particle");
-	ResourceManager::LoadTexture("Resource/powerup_speed.png", GL_TRUE, "powerup_speed");
-	ResourceManager::LoadTexture("Resource/powerup_sticky.png", GL_TRUE, "powerup_sticky");
-	ResourceManager::LoadTexture("Resource/powerup_increase.png", GL_TRUE, "powerup_increase");
-	ResourceManager::LoadTexture("Resource/powerup_confuse.png", GL_TRUE, "powerup_confuse");
-	ResourceManager::LoadTexture("Resource/powerup_chaos.png", GL_TRUE, "powerup_chaos");
-	ResourceManager::LoadTexture("Resource/powerup_passthrough.png", GL_TRUE, "powerup_passthrough");
+	// All sprites share one atlas texture, so drawing them needs no texture rebinds
+	ResourceManager::LoadAtlas({ "Resource/awesomeface.png", "Resource/block.png", "Resource/block_solid.png", "Resource/paddle.png",
+	                             "Resource/particle.png", "Resource/powerup_speed.png", "Resource/powerup_sticky.png",
+	                             "Resource/powerup_increase.png", "Resource/powerup_confuse.png", "Resource/powerup_chaos.png",
+	                             "Resource/powerup_passthrough.png" },
+	                           { "face", "block", "block_solid", "paddle",
+	                             "particle", "powerup_speed", "powerup_sticky",
+	                             "powerup_increase", "powerup_confuse", "powerup_chaos",
+	                             "powerup_passthrough" },
+	                           "sprites");
 	// Set render-specific controls
-	Renderer = new SpriteRenderer(ResourceManager::GetShader("sprite"));
-	Particles = new ParticleGenerator(ResourceManager::GetShader("particle"), ResourceManager::GetTexture("particle"), 500);
-	Effects = new PostProcessor(ResourceManager::GetShader("post_processing"), this->Width, this->Height);
+	if (this->Software)
+	{
+		this->backend = this->Rasterizer = new SoftwareBackend(this->Width, this->Height);
+		this->brickCache = new LevelCache(*this->Rasterizer, this->Width, this->Height);
+	}
+	else
+	{
+		this->effects = new PostProcessor(postVariants, this->Width, this->Height, this->Samples, this->RenderScale);
+		this->effects->TargetGpuTime = this->TargetGpuTime;
+		this->brickCache = new LevelCache(ResourceManager::GetShader("sprite_instanced"), this->Width, this->Height);
+		this->backend = new GLBackend(ResourceManager::GetShader("sprite"), ResourceManager::GetShader("text"), this->effects);
+	}
+	this->renderer = new SpriteRenderer(*this->backend);
+	this->particles = new ParticleGenerator(*this->backend, ResourceManager::GetTexture("particle"), this->ParticleCount);
+	this->particles->Jobs = this->Jobs;
+	this->InitSimulation();
+
+	this->text = new TextRenderer(*this->backend);
+	this->text->Load("Resource/方正粗圆_GBK_0.ttf", 24);
+
+	if (this->HotReload)
+	{
+		this->watcher = new FileWatcher();
+		this->watcher->Watch("Resource");
+	}
+}
+
+void Game::InitSimulation()
+{
 	// Load levels
 	GameLevel one; one.Load("Resource/one.lvl", this->Width, this->Height * 0.5);
 	GameLevel two; two.Load("Resource/two.lvl", this->Width, this->Height * 0.5);
@@ -85,43 +133,30 @@ void Game::Init()
 	this->Levels.push_back(four);
 	this->Level = 0;
 	// Configure game objects
-	glm::vec2 playerPos = glm::vec2(this->Width / 2 - PLAYER_SIZE.x / 2, this->Height - PLAYER_SIZE.y);
-	Player = new GameObject(playerPos, PLAYER_SIZE, ResourceManager::GetTexture("paddle"));
-	glm::vec2 ballPos = playerPos + glm::vec2(PLAYER_SIZE.x / 2 - BALL_RADIUS, -BALL_RADIUS * 2);
-	Ball = new BallObject(ballPos, BALL_RADIUS, INITIAL_BALL_VELOCITY, ResourceManager::GetTexture("face"));
+	Vec2 playerPos = Vec2(this->Width / 2 - PLAYER_SIZE.x / 2, this->Height - PLAYER_SIZE.y);
+	this->Player = GameObject(playerPos, PLAYER_SIZE, ResourceManager::GetTexture("paddle"));
+	this->Balls = BallBatch(BALL_RADIUS, ResourceManager::GetTexture("face"));
+	this->spawnBalls();
 
 //	SoundEngine->play2D("Resource/breakout.mp3", GL_TRUE);
-
-	Text = new TextRenderer(this->Width, this->Height);
-	Text->Load("Resource/方正粗圆_GBK_0.ttf", 24);
-
 }
 
 void Game::Update(GLfloat dt)
 {
-	// Update objects
-	Ball->Move(dt, this->Width);
-	// Check for collisions
-	this->DoCollisions(dt);
-	// Update particles
-	Particles->Update(dt, *Ball, 2, glm::vec2(Ball->Radius / 2));
-	this->UpdatePowerUps(dt);
-	if(ShakeTime > 0.0f)
-	{
-		ShakeTime -= dt;
-		if(ShakeTime <= 0.0f)
-		{
-			Effects->Shake = GL_FALSE;
-		}
-	}
+	this->reloadLevels();
+	// Move the balls, check for collisions, update particles and power-ups
+	this->stepTime = dt;
+	this->stages.Run(this->Jobs);
 	//Note, need be at last, Check loss condition
-	if (Ball->Position.y >= this->Height) // Did ball reach bottom edge?
+	// Balls that reached the bottom edge are out; a life is lost once none are left
+	if (this->Balls.RemoveBelow(this->Height) > 0 && this->Balls.Count() == 0)
 	{
 		--this->Lives;
 		if(this->Lives == 0)
 		{
 			this->ResetLevel();
 			this->ResetPlayer();
+			this->Scores[0] = this->Scores[1] = 0;
 		}
 		this->ResetPlayer();
 	}
@@ -130,113 +165,431 @@ void Game::Update(GLfloat dt)
 	{
 		this->ResetPlayer();
 		this->ResetLevel();
-		Effects->Chaos = GL_TRUE;
+		this->Chaos = GL_TRUE;
 		this->State = GAME_WIN;
 	}
 }
 
 
-void Game::ProcessInput(GLfloat dt)
+void Game::StartVersus()
+{
+	this->Versus = GL_TRUE;
+	this->State = GAME_ACTIVE;
+	this->Lives = 3;
+	this->Scores[0] = this->Scores[1] = 0;
+	this->Opponent = GameObject(this->Player.Position, PLAYER_SIZE, this->Player.Sprite);
+	this->ResetPlayer();
+}
+
+void Game::Step(const GLubyte inputs[2], GLfloat dt)
 {
 	if (this->State == GAME_ACTIVE)
 	{
-		GLfloat velocity = PLAYER_VELOCITY * dt;
-		// Move playerboard
-		if (this->Keys[GLFW_KEY_A])
+		Real distance = PLAYER_VELOCITY * dt;
+		GameObject *paddles[2] = { &this->Player, &this->Opponent };
+		for (GLubyte player = 0; player < 2; ++player)
 		{
-			if (Player->Position.x >= 0)
-			{
-				Player->Position.x -= velocity;
-				if (Ball->Stuck)
-					Ball->Position.x -= velocity;
-			}
+			if (inputs[player] & INPUT_LEFT)
+				this->movePaddle(*paddles[player], player, -distance);
+			if (inputs[player] & INPUT_RIGHT)
+				this->movePaddle(*paddles[player], player, distance);
+			if (inputs[player] & INPUT_LAUNCH)
+				for (GLuint i = 0; i < this->Balls.Count(); ++i)
+					if (this->Balls.Owner[i] == player)
+						this->Balls.Stuck[i] = GL_FALSE;
 		}
+	}
+	// Either player launching starts the next round
+	else if (this->State == GAME_WIN && ((inputs[0] | inputs[1]) & INPUT_LAUNCH))
+	{
+		this->Chaos = GL_FALSE;
+		this->Scores[0] = this->Scores[1] = 0;
+		this->State = GAME_ACTIVE;
+	}
+	this->Update(dt);
+}
+
+void Game::Save(SimulationState &state) const
+{
+	state.State = this->State;
+	state.Level = this->Level;
+	state.Lives = this->Lives;
+	state.Random = this->Random;
+	state.Scores[0] = this->Scores[0];
+	state.Scores[1] = this->Scores[1];
+	state.Clock = this->Clock;
+	state.Player = this->Player;
+	state.Opponent = this->Opponent;
+	// Assigning into a state saved before reuses its storage, so saving every tick doesn't allocate
+	state.Balls = this->Balls;
+	state.PowerUps = this->PowerUps;
+	state.Timers = this->Timers;
+	state.Confuse = this->Confuse;
+	state.Chaos = this->Chaos;
+	state.Shake = this->Shake;
+	const GameLevel &level = this->Levels[this->Level];
+	state.Destroyed.resize(level.Bricks.size());
+	for (GLuint i = 0; i < level.Bricks.size(); ++i)
+		state.Destroyed[i] = level.Bricks[i].Destroyed;
+	state.Standing = level.Standing;
+}
+
+void Game::Restore(const SimulationState &state)
+{
+	this->State = state.State;
+	this->Level = state.Level;
+	this->Lives = state.Lives;
+	this->Random = state.Random;
+	this->Scores[0] = state.Scores[0];
+	this->Scores[1] = state.Scores[1];
+	this->Clock = state.Clock;
+	this->Player = state.Player;
+	this->Opponent = state.Opponent;
+	this->Balls = state.Balls;
+	this->PowerUps = state.PowerUps;
+	this->Timers = state.Timers;
+	this->Confuse = state.Confuse;
+	this->Chaos = state.Chaos;
+	this->Shake = state.Shake;
+	GameLevel &level = this->Levels[this->Level];
+	GLuint bricks = std::min(static_cast<GLuint>(level.Bricks.size()), static_cast<GLuint>(state.Destroyed.size()));
+	for (GLuint i = 0; i < bricks; ++i)
+		level.Bricks[i].Destroyed = state.Destroyed[i];
+	level.Standing = state.Standing;
+}
+
+void Game::updateParticles(GLfloat dt)
+{
+	// With several balls the trail takes turns following each of them. Ticks replayed after a rollback already emitted theirs
+	if (this->particles == nullptr || this->Replaying)
+		return;
+	if (this->Balls.Count() > 0)
+	{
+		GLuint ball = this->trailBall++ % this->Balls.Count();
+		this->particles->Update(dt, ToFloat(this->Balls.Position(ball)), ToFloat(this->Balls.Velocity(ball)), 2, glm::vec2(ToFloat(this->Balls.Radius) / 2));
+	}
+	else
+		this->particles->Update(dt, glm::vec2(0.0f), glm::vec2(0.0f), 0);
+}
+
+void Game::ProcessInput(GLdouble now, GLfloat dt)
+{
+	// Integrate the paddle piecewise between the events that fall into this tick, so it moves for
+	// exactly as long as a key was held, even for taps shorter than a tick
+	GLdouble cursor = now - dt;
+	this->time = now;
+	InputEvent event;
+	while (this->Input.Peek(event) && event.Time <= now)
+	{
+		this->Input.Pop();
+		// Events that arrived before this tick started are applied at its start
+		GLdouble time = glm::max(event.Time, cursor);
+		this->movePlayer(static_cast<GLfloat>(time - cursor));
+		cursor = time;
+		this->handleKey(event);
+	}
+	this->movePlayer(static_cast<GLfloat>(now - cursor));
+}
+
+void Game::movePlayer(GLfloat dt)
+{
+	if (this->State == GAME_ACTIVE && dt > 0.0f)
+	{
+		Real velocity = PLAYER_VELOCITY * dt;
+		// Move playerboard
+		if (this->Keys[GLFW_KEY_A])
+			this->movePaddle(this->Player, 0, -velocity);
 		if (this->Keys[GLFW_KEY_D])
-		{
-			if (Player->Position.x <= this->Width - Player->Size.x)
-			{
-				Player->Position.x += velocity;
-				if (Ball->Stuck)
-					Ball->Position.x += velocity;
-			}
-		}
+			this->movePaddle(this->Player, 0, velocity);
 		if (this->Keys[GLFW_KEY_SPACE])
-			Ball->Stuck = false;
+			std::fill(this->Balls.Stuck.begin(), this->Balls.Stuck.end(), GL_FALSE);
+	}
+}
+
+void Game::movePaddle(GameObject &paddle, GLubyte owner, Real distance)
+{
+	if (distance < 0 ? paddle.Position.x < 0 : paddle.Position.x > this->Width - paddle.Size.x)
+		return;
+	paddle.Position.x += distance;
+	for (GLuint i = 0; i < this->Balls.Count(); ++i)
+		if (this->Balls.Stuck[i] && this->Balls.Owner[i] == owner)
+			this->Balls.PosX[i] += distance;
+}
+
+void Game::handleKey(const InputEvent &event)
+{
+	if (event.Key < 0 || event.Key >= 1024)
+		return;
+	if (event.Action == GLFW_RELEASE)
+	{
+		this->Keys[event.Key] = GL_FALSE;
+		return;
 	}
-	if(this->State == GAME_MENU)
+	if (event.Action != GLFW_PRESS)
+		return;
+	this->Keys[event.Key] = GL_TRUE;
+	if (this->InputTime == 0.0)
+		this->InputTime = event.Time;
+
+	// Presses act as edges, so every tap is seen exactly once no matter how short it was
+	if(this->State == GAME_ACTIVE)
 	{
-		if(this->Keys[GLFW_KEY_ENTER] && !this->KeysProcessed[GLFW_KEY_ENTER])
-		{
+		if(event.Key == GLFW_KEY_SPACE)
+			std::fill(this->Balls.Stuck.begin(), this->Balls.Stuck.end(), GL_FALSE);
+	}
+	else if(this->State == GAME_MENU)
+	{
+		if(event.Key == GLFW_KEY_ENTER)
 			this->State = GAME_ACTIVE;
-			this->KeysProcessed[GLFW_KEY_ENTER] = GL_TRUE;
-		}
-		if(this->Keys[GLFW_KEY_W] && !this->KeysProcessed[GLFW_KEY_W])
-		{
+		else if(event.Key == GLFW_KEY_W)
 			this->Level = (this->Level + 1) % 3;
-			this->KeysProcessed[GLFW_KEY_W] = GL_TRUE;
-		}
-		if(this->Keys[GLFW_KEY_S] && !this->KeysProcessed[GLFW_KEY_S])
+		else if(event.Key == GLFW_KEY_S)
 		{
 			if(this->Level > 0)
 				this->Level--;
 			else
 				this->Level = 2;
-			this->KeysProcessed[GLFW_KEY_S] = GL_TRUE;
 		}
 	}
-
-	if(this->State == GAME_WIN)
+	else if(this->State == GAME_WIN)
 	{
-		if(this->Keys[GLFW_KEY_ENTER])
+		if(event.Key == GLFW_KEY_ENTER)
 		{
-			this->KeysProcessed[GLFW_KEY_ENTER] = GL_TRUE;
-			Effects->Chaos = GL_FALSE;
+			this->Chaos = GL_FALSE;
 			this->State = GAME_ACTIVE;
 		}
 	}
 }
 
-void Game::Render()
+void Game::Snapshot(FrameSnapshot &frame)
 {
-	if (this->State == GAME_ACTIVE || this->State == GAME_MENU)
+	const GameLevel &level = this->Levels[this->Level];
+	frame.State = this->State;
+	frame.Level = this->Level;
+	frame.Revision = level.Revision;
+	frame.Lives = this->Lives;
+	frame.Player = this->Player;
+	frame.Versus = this->Versus;
+	frame.Opponent = this->Opponent;
+	frame.Scores[0] = this->Scores[0];
+	frame.Scores[1] = this->Scores[1];
+	frame.Balls = this->Balls;
+	// Assigning into the existing vectors reuses their storage, so steady-state snapshots don't allocate
+	frame.Bricks.assign(level.Bricks.begin(), level.Bricks.end());
+	frame.PowerUps.clear();
+	for (const PowerUp &powerUp : this->PowerUps)
+		if (!powerUp.Destroyed)
+			frame.PowerUps.push_back(powerUp);
+	// Simulation-only instances have no particles
+	if (this->particles != nullptr)
+		frame.Particles.assign(this->particles->Particles().begin(), this->particles->Particles().end());
+	else
+		frame.Particles.clear();
+	frame.Confuse = this->Confuse;
+	frame.Chaos = this->Chaos;
+	frame.Shake = this->Shake;
+	// Only the first snapshot after a key press carries its timestamp
+	frame.InputTime = this->InputTime;
+	this->InputTime = 0.0;
+	frame.Time = this->time;
+}
+
+void Game::Hash(StateHash &hash) const
+{
+	std::fill(hash.Fields, hash.Fields + StateHash::FIELDS, 0);
+	GLuint64 &game = hash.Fields[StateHash::FIELD_GAME];
+	StateHash::Add(game, this->State);
+	StateHash::Add(game, this->Level);
+	StateHash::Add(game, this->Lives);
+	StateHash::Add(game, this->Random);
+	StateHash::Add(game, this->Versus);
+	StateHash::Add(game, static_cast<GLuint64>(this->Scores[0]) << 32 | this->Scores[1]);
+
+	GLuint64 &paddle = hash.Fields[StateHash::FIELD_PADDLE];
+	StateHash::Add(paddle, StateHash::Bits(this->Player.Position.x));
+	StateHash::Add(paddle, StateHash::Bits(this->Player.Position.y));
+	StateHash::Add(paddle, StateHash::Bits(this->Player.Size.x));
+	StateHash::Add(paddle, StateHash::Bits(this->Player.Size.y));
+	if (this->Versus)
 	{
-		Effects->BeginRender();
-		// Draw background
-		Renderer->DrawSprite(ResourceManager::GetTexture("background"), glm::vec2(0, 0), glm::vec2(this->Width, this->Height), 0.0f);
-		// Draw level
-		this->Levels[this->Level].Draw(*Renderer);
-		// Draw player
-		Player->Draw(*Renderer);
-		// Draw particles
-		Particles->Draw();
-		// Draw ball
-		Ball->Draw(*Renderer);
+		StateHash::Add(paddle, StateHash::Bits(this->Opponent.Position.x));
+		StateHash::Add(paddle, StateHash::Bits(this->Opponent.Position.y));
+		StateHash::Add(paddle, StateHash::Bits(this->Opponent.Size.x));
+		StateHash::Add(paddle, StateHash::Bits(this->Opponent.Size.y));
+	}
+
+	GLuint64 &balls = hash.Fields[StateHash::FIELD_BALLS];
+	StateHash::Add(balls, this->Balls.Count());
+	StateHash::Add(balls, StateHash::Bits(this->Balls.Radius));
+	StateHash::Add(balls, this->Balls.Sticky << 1 | this->Balls.PassThrough);
+	for (GLuint i = 0; i < this->Balls.Count(); ++i)
+	{
+		StateHash::Add(balls, StateHash::Bits(this->Balls.PosX[i]) << 32 | StateHash::Bits(this->Balls.PosY[i]));
+		StateHash::Add(balls, StateHash::Bits(this->Balls.VelX[i]) << 32 | StateHash::Bits(this->Balls.VelY[i]));
+		StateHash::Add(balls, this->Balls.Owner[i] << 1 | this->Balls.Stuck[i]);
+	}
+
+	hash.Fields[StateHash::FIELD_BRICKS] = this->Levels[this->Level].Standing;
 
-		for(PowerUp& powerUp : this->PowerUps)
+	GLuint64 &powerUps = hash.Fields[StateHash::FIELD_POWER_UPS];
+	for (const PowerUp &powerUp : this->PowerUps)
+	{
+		if (powerUp.Destroyed)
+			continue;
+		StateHash::Add(powerUps, powerUp.TypeIndex);
+		StateHash::Add(powerUps, StateHash::Bits(powerUp.Position.x) << 32 | StateHash::Bits(powerUp.Position.y));
+	}
+
+	GLuint64 &effects = hash.Fields[StateHash::FIELD_EFFECTS];
+	StateHash::Add(effects, this->Confuse << 2 | this->Chaos << 1 | this->Shake);
+	for (GLuint effect = 0; effect < TIMED_EFFECTS; ++effect)
+		StateHash::Add(effects, StateHash::Bits(this->Timers.Remaining(static_cast<TimedEffect>(effect), this->Clock)));
+}
+
+void Game::Resize(GLuint framebufferWidth, GLuint framebufferHeight)
+{
+	// A minimized window reports 0 x 0, keep the last real size
+	if (framebufferWidth == 0 || framebufferHeight == 0)
+		return;
+	this->framebufferSize = static_cast<unsigned long long>(framebufferWidth) << 32 | framebufferHeight;
+}
+
+void Game::applyFramebufferSize()
+{
+	unsigned long long size = this->framebufferSize;
+	if (size == this->appliedFramebufferSize)
+		return;
+	this->appliedFramebufferSize = size;
+	GLuint framebufferWidth = static_cast<GLuint>(size >> 32);
+	GLuint framebufferHeight = static_cast<GLuint>(size & 0xFFFFFFFFu);
+	// Largest rectangle of the game's aspect ratio that fits, centered
+	GLfloat pixelScale = std::min(static_cast<GLfloat>(framebufferWidth) / this->Width, static_cast<GLfloat>(framebufferHeight) / this->Height);
+	GLuint width = std::max(1L, std::lround(this->Width * pixelScale));
+	GLuint height = std::max(1L, std::lround(this->Height * pixelScale));
+	GLint x = (static_cast<GLint>(framebufferWidth) - static_cast<GLint>(width)) / 2;
+	GLint y = (static_cast<GLint>(framebufferHeight) - static_cast<GLint>(height)) / 2;
+	// The projections stay in game units, only the pixel side changes. The software backend always renders one pixel per unit
+	if (this->Software)
+		return;
+	glViewport(x, y, width, height);
+	this->effects->Resize(x, y, width, height);
+	this->brickCache->Resize(pixelScale * this->effects->RenderScale);
+	this->text->SetPixelScale(pixelScale);
+}
+
+void Game::reloadResources()
+{
+	if (this->watcher == nullptr)
+		return;
+	GLboolean reloaded = GL_FALSE;
+	for (const std::string &file : this->watcher->Changes())
+	{
+		if (ResourceManager::Reload(file))
+			reloaded = GL_TRUE;
+		else
 		{
-			if(!powerUp.Destroyed)
-				powerUp.Draw(*Renderer);
+			std::lock_guard<std::mutex> lock(this->changedFilesMutex);
+			this->changedFiles.push_back(file);
 		}
+	}
+	// The cached playfield was drawn with the old background and brick sprites
+	if (reloaded && this->brickCache != nullptr)
+		this->brickCache->Invalidate();
+}
 
-		Effects->EndRender();
-		Effects->Render(glfwGetTime());
+void Game::reloadLevels()
+{
+	std::vector<std::string> files;
+	{
+		std::lock_guard<std::mutex> lock(this->changedFilesMutex);
+		files.swap(this->changedFiles);
+	}
+	for (const std::string &file : files)
+		for (GameLevel &level : this->Levels)
+		{
+			if (level.File != file)
+				continue;
+			// Keep the old layout if the file can't be parsed (e.g. it is saved half-way)
+			GameLevel reloaded;
+			reloaded.Load(file.c_str(), this->Width, this->Height * 0.5f);
+			if (reloaded.Bricks.empty())
+				std::cout << "ERROR::LEVEL: Keeping the previous version of " << file << std::endl;
+			else
+			{
+				level = reloaded;
+				std::cout << "Reloaded level " << file << std::endl;
+			}
+		}
+}
+
+void Game::Render(const FrameSnapshot &frame)
+{
+	this->applyFramebufferSize();
+	this->reloadResources();
+	FrameUniforms::Time = frame.Time;
+	if (!this->Software)
+		FrameUniforms::Upload();
+	if (frame.State == GAME_ACTIVE || frame.State == GAME_MENU)
+	{
+		// Refresh the cached background and bricks (only the parts that changed) before the scene is started
+		if (this->brickCache != nullptr)
+			this->brickCache->Update(frame.Bricks, frame.Revision, *this->renderer, ResourceManager::GetTexture("background"));
+		this->backend->BeginScene();
+		// Draw background and level; without the cache they are drawn every frame
+		if (this->brickCache != nullptr)
+			this->brickCache->Draw(*this->renderer);
+		else
+		{
+			this->renderer->DrawSprite(ResourceManager::GetTexture("background"), glm::vec2(0.0f, 0.0f), glm::vec2(this->Width, this->Height), 0.0f);
+			for (const GameObject &brick : frame.Bricks)
+				if (!brick.Destroyed)
+					this->renderer->BatchSprite(brick.Sprite, ToFloat(brick.Position), ToFloat(brick.Size), brick.Rotation, brick.Color);
+			this->renderer->DrawBatch();
+		}
+		// Draw player
+		this->renderer->DrawSprite(frame.Player.Sprite, ToFloat(frame.Player.Position), ToFloat(frame.Player.Size), frame.Player.Rotation, frame.Player.Color);
+		if (frame.Versus)
+			this->renderer->DrawSprite(frame.Opponent.Sprite, ToFloat(frame.Opponent.Position), ToFloat(frame.Opponent.Size), frame.Opponent.Rotation, frame.Opponent.Color);
+		// Draw particles
+		this->particles->Draw(frame.Particles);
+		// Draw balls and power-ups; they share the sprite atlas, so this is a single draw call
+		for (GLuint i = 0; i < frame.Balls.Count(); ++i)
+			this->renderer->BatchSprite(frame.Balls.Sprite, ToFloat(frame.Balls.Position(i)), ToFloat(frame.Balls.Size()), 0.0f, frame.Balls.Color);
+
+		for(const GameObject& powerUp : frame.PowerUps)
+			this->renderer->BatchSprite(powerUp.Sprite, ToFloat(powerUp.Position), ToFloat(powerUp.Size), powerUp.Rotation, powerUp.Color);
+		this->renderer->DrawBatch();
+
+		this->backend->EndScene();
+		this->backend->PresentScene((frame.Chaos ? FrameUniforms::EFFECT_CHAOS : 0) | (frame.Confuse ? FrameUniforms::EFFECT_CONFUSE : 0) |
+		                            (frame.Shake ? FrameUniforms::EFFECT_SHAKE : 0), static_cast<GLfloat>(frame.Time));
 
 		std::stringstream ss;
-		ss << this->Lives;
-		Text->RenderText("Lives:" + ss.str(), 5.0f, 5.0f, 1.0f);
+		ss << frame.Lives;
+		if (frame.Versus)
+			ss << "  P1:" << frame.Scores[0] << "  P2:" << frame.Scores[1];
+		this->text->RenderText("Lives:" + ss.str(), 5.0f, 5.0f, 1.0f);
 	}
 
-	if(this->State == GAME_MENU)
+	if(frame.State == GAME_MENU)
 	{
-		Text->RenderText("Press Enter To Start", 250.0f, Height/2, 1.0f);
-		Text->RenderText("Press W or S to select level", 245.0f, Height/2 + 40.0f, 0.76f);
+		this->text->RenderText("Press Enter To Start", 250.0f, Height/2, 1.0f);
+		this->text->RenderText("Press W or S to select level", 245.0f, Height/2 + 40.0f, 0.76f);
 	}
 
-	if(this->State == GAME_WIN)
+	if(frame.State == GAME_WIN && frame.Versus)
 	{
-		Text->RenderText("YOU WIN!!!", 250.0f, Height/2 - 20, 1.0f, glm::vec3(0.0, 1.0, 0.0));
-		Text->RenderText("Press ENTER to retry or ESC to quit", 130.0f, Height/2, 1.0f, glm::vec3(1.0, 1.0, 0.0));
+		const char *result = frame.Scores[0] > frame.Scores[1] ? "PLAYER 1 WINS!!!" : (frame.Scores[1] > frame.Scores[0] ? "PLAYER 2 WINS!!!" : "DRAW");
+		this->text->RenderText(result, 250.0f, Height/2 - 20, 1.0f, glm::vec3(0.0, 1.0, 0.0));
+		this->text->RenderText("Press SPACE to play again or ESC to quit", 110.0f, Height/2, 1.0f, glm::vec3(1.0, 1.0, 0.0));
 	}
+	else if(frame.State == GAME_WIN)
+	{
+		this->text->RenderText("YOU WIN!!!", 250.0f, Height/2 - 20, 1.0f, glm::vec3(0.0, 1.0, 0.0));
+		this->text->RenderText("Press ENTER to retry or ESC to quit", 130.0f, Height/2, 1.0f, glm::vec3(1.0, 1.0, 0.0));
+	}
+	if (!this->Software)
+		StreamBuffer::EndFrame();
 }
 
 
@@ -256,249 +609,347 @@ void Game::ResetLevel()
 void Game::ResetPlayer()
 {
 	// Reset player/ball stats
-	Player->Size = PLAYER_SIZE;
-	Player->Position = glm::vec2(this->Width / 2 - PLAYER_SIZE.x / 2, this->Height - PLAYER_SIZE.y);
-	Ball->Reset(Player->Position + glm::vec2(PLAYER_SIZE.x / 2 - BALL_RADIUS, -(BALL_RADIUS * 2)), INITIAL_BALL_VELOCITY);
+	this->Player.Size = PLAYER_SIZE;
+	this->Player.Position = Vec2(this->Width / 2 - PLAYER_SIZE.x / 2, this->Height - PLAYER_SIZE.y);
+	// In versus mode the paddles start in the middle of their halves
+	if (this->Versus)
+	{
+		this->Player.Position.x = this->Width / 4 - PLAYER_SIZE.x / 2;
+		this->Opponent.Size = PLAYER_SIZE;
+		this->Opponent.Position = Vec2(this->Width * 3 / 4 - PLAYER_SIZE.x / 2, this->Height - PLAYER_SIZE.y);
+		this->Opponent.Color = OPPONENT_COLOR;
+	}
+	this->spawnBalls();
 
-	Effects->Chaos = Effects->Confuse = GL_FALSE;
-	Ball->PassThrough = Ball->Sticky = GL_FALSE;
-	Player->Color = glm::vec3(1.0f);
-	Ball->Color = glm::vec3(1.0f);
+	// Every effect ends with the life it was caught in, so no timer may end one of the next life's
+	this->Timers.Clear();
+	this->Chaos = this->Confuse = this->Shake = GL_FALSE;
+	this->Player.Color = glm::vec3(1.0f);
 }
 
+void Game::spawnBalls()
+{
+	this->Balls.Reset();
+	this->addBalls(this->Player, 0);
+	if (this->Versus)
+		this->addBalls(this->Opponent, 1);
+}
 
+void Game::addBalls(const GameObject &paddle, GLubyte owner)
+{
+	Vec2 position = paddle.Position + Vec2(PLAYER_SIZE.x / 2 - BALL_RADIUS, -(BALL_RADIUS * 2));
+	Real speed = Length(INITIAL_BALL_VELOCITY);
+	for (GLuint i = 0; i < this->BallCount; ++i)
+	{
+		// Spread the launch directions evenly around the default one, keeping the speed
+		Real spread = this->BallCount > 1 ? (Real(i) / Real(this->BallCount - 1) - 0.5f) * 2 : Real(0);
+		Vec2 velocity(INITIAL_BALL_VELOCITY.x + spread * 3 * Abs(INITIAL_BALL_VELOCITY.y), INITIAL_BALL_VELOCITY.y);
+		this->Balls.Add(position, Normalize(velocity) * speed, GL_TRUE, owner);
+	}
+}
+
+
+
+// Ball-brick tests per broad phase chunk; fewer are not worth handing to another thread
+const GLuint BROAD_PHASE_PAIRS = 4096;
 
 // Collision detection
 GLboolean CheckCollision(GameObject &one, GameObject &two);
-Collision CheckCollision(BallObject &one, GameObject &two);
-Direction VectorDirection(glm::vec2 closest);
-void ActivatePowerUp(PowerUp& powerUp);
+Collision CheckCollision(const BallBatch &balls, GLuint i, GameObject &two);
+Direction VectorDirection(Vec2 closest);
 
 
+void Game::broadPhase()
+{
+	const GameLevel &level = this->Levels[this->Level];
+	GLuint count = static_cast<GLuint>(level.Bricks.size());
+	GLuint grain = std::max(1u, BROAD_PHASE_PAIRS / std::max(1u, this->Balls.Count()));
+	this->brickCandidates.assign(count, 0);
+	this->chunkHits.resize(std::max(static_cast<size_t>((count + grain - 1) / grain), this->chunkHits.size()));
+	// Chunks write disjoint parts of brickCandidates and only read the balls
+	auto test = [this, &level, grain](GLuint begin, GLuint end) {
+		std::vector<GLubyte> &hits = this->chunkHits[begin / grain];
+		for (GLuint brick = begin; brick < end; ++brick)
+		{
+			const GameObject &box = level.Bricks[brick];
+			if (!box.Destroyed)
+				this->brickCandidates[brick] = this->Balls.Overlap(box.Position, box.Size, hits) > 0;
+		}
+	};
+	if (this->Jobs != nullptr)
+		this->Jobs->ParallelFor(count, grain, test);
+	else
+		test(0, count);
+}
+
 void Game::DoCollisions(float dt)
 {
-	for (GameObject &box : this->Levels[this->Level].Bricks)
+	BallBatch &balls = this->Balls;
+	// Bricks are visited in level order and, per brick, hits are resolved in ball order. Each ball
+	// therefore sees its bricks in the same order as a lone ball would, and the outcome does not
+	// depend on anything but the state going in.
+	GameLevel &level = this->Levels[this->Level];
+	if (this->brickCandidates.size() != level.Bricks.size())
+		this->broadPhase();
+	// The broad phase saw the balls before any of them bounced off a brick. A brick it did not mark can only be hit
+	// by a ball an earlier brick pushed back this tick, so those bricks are tested again while they are near the box
+	// around all balls pushed back so far (widened by a unit against rounding)
+	GLboolean pushed = GL_FALSE;
+	Vec2 pushedMin, pushedMax;
+	for (GLuint brick = 0; brick < level.Bricks.size(); ++brick)
 	{
-		if (!box.Destroyed)
+		GameObject &box = level.Bricks[brick];
+		if (box.Destroyed)
+			continue;
+		if (!this->brickCandidates[brick] &&
+		    !(pushed && box.Position.x <= pushedMax.x + 1 && box.Position.x + box.Size.x + 1 >= pushedMin.x &&
+		      box.Position.y <= pushedMax.y + 1 && box.Position.y + box.Size.y + 1 >= pushedMin.y))
+			continue;
+		// Test all balls against this brick at once
+		if (balls.Overlap(box.Position, box.Size, this->ballHits) == 0)
+			continue;
+		// Destroy block if not solid; a brick hit by several balls in the same tick is destroyed once
+		if (!box.IsSolid)
 		{
-			Collision collision = CheckCollision(*Ball, box);
-			if (std::get<0>(collision)) // If collision is true
+			level.Destroy(brick);
+			this->SpawnPowerUps(box);
+			// In versus mode the brick goes to the owner of the first ball that hit it
+			if (this->Versus)
+				++this->Scores[balls.Owner[std::find(this->ballHits.begin(), this->ballHits.end(), 1) - this->ballHits.begin()]];
+		}
+		else
+		{
+			this->Timers.Start(EFFECT_SHAKE, this->Clock, 0.05);
+			this->Shake = GL_TRUE;
+		}
+		if (balls.PassThrough)
+			continue;
+		// Collision resolution
+		for (GLuint i = 0; i < balls.Count(); ++i)
+		{
+			if (!this->ballHits[i])
+				continue;
+			Collision collision = CheckCollision(balls, i, box);
+			Direction dir = std::get<1>(collision);
+			Vec2 diff_vector = std::get<2>(collision);
+			if (dir == LEFT || dir == RIGHT) // Horizontal collision
+			{
+				balls.VelX[i] = -balls.VelX[i]; // Reverse horizontal velocity
+				// Relocate
+				Real penetration = balls.Radius - Abs(diff_vector.x);
+				if (dir == LEFT)
+					balls.PosX[i] += penetration; // Move ball to right
+				else
+					balls.PosX[i] -= penetration; // Move ball to left;
+			}
+			else // Vertical collision
 			{
-				// Destroy block if not solid
-				if (!box.IsSolid)
-				{
-					box.Destroyed = GL_TRUE;
-					this->SpawnPowerUps(box);
-				}
+				balls.VelY[i] = -balls.VelY[i]; // Reverse vertical velocity
+				// Relocate
+				Real penetration = balls.Radius - Abs(diff_vector.y);
+				if (dir == UP)
+					balls.PosY[i] -= penetration; // Move ball bback up
 				else
-				{
-					ShakeTime = 0.05f;
-					Effects->Shake = true;
-				}
-				// Collision resolution
-				Direction dir = std::get<1>(collision);
-				glm::vec2 diff_vector = std::get<2>(collision);
-				if(!(Ball->PassThrough))
-				{
-					if (dir == LEFT || dir == RIGHT) // Horizontal collision
-					{
-						Ball->Velocity.x = -Ball->Velocity.x; // Reverse horizontal velocity
-						// Relocate
-						GLfloat penetration = Ball->Radius - std::abs(diff_vector.x);
-						if (dir == LEFT)
-							Ball->Position.x += penetration; // Move ball to right
-						else
-							Ball->Position.x -= penetration; // Move ball to left;
-					}
-					else // Vertical collision
-					{
-						Ball->Velocity.y = -Ball->Velocity.y; // Reverse vertical velocity
-						// Relocate
-						GLfloat penetration = Ball->Radius - std::abs(diff_vector.y);
-						if (dir == UP)
-							Ball->Position.y -= penetration; // Move ball bback up
-						else
-							Ball->Position.y += penetration; // Move ball back down
-					}
-
-				}
+					balls.PosY[i] += penetration; // Move ball back down
 			}
+			Vec2 low = balls.Position(i), high = low + balls.Size();
+			pushedMin = pushed ? Vec2(std::min(pushedMin.x, low.x), std::min(pushedMin.y, low.y)) : low;
+			pushedMax = pushed ? Vec2(std::max(pushedMax.x, high.x), std::max(pushedMax.y, high.y)) : high;
+			pushed = GL_TRUE;
 		}
 	}
 	// Also check collisions for player pad (unless stuck)
-	Collision result = CheckCollision(*Ball, *Player);
-	if (!Ball->Stuck && std::get<0>(result))
-	{
-		Ball->Stuck = Ball->Sticky;
-		// Check where it hit the board, and change velocity based on where it hit the board
-		GLfloat centerBoard = Player->Position.x + Player->Size.x / 2;
-		GLfloat distance = (Ball->Position.x + Ball->Radius) - centerBoard;
-		GLfloat percentage = distance / (Player->Size.x / 2);
-		// Then move accordingly
-		GLfloat strength = 2.0f;
-		glm::vec2 oldVelocity = Ball->Velocity;
-		Ball->Velocity.x = INITIAL_BALL_VELOCITY.x * percentage * strength;
-		//Ball->Velocity.y = -Ball->Velocity.y;
-		Ball->Velocity = glm::normalize(Ball->Velocity) * glm::length(oldVelocity); // Keep speed consistent over both axes (multiply by length of old velocity, so total strength is not changed)
-		// Fix sticky paddle
-		Ball->Velocity.y = -1 * abs(Ball->Velocity.y);
+	this->bouncePaddle(this->Player, 0);
+	if (this->Versus)
+		this->bouncePaddle(this->Opponent, 1);
+
+	this->collectPowerUps();
+}
+
+void Game::bouncePaddle(const GameObject &paddle, GLubyte owner)
+{
+	BallBatch &balls = this->Balls;
+	if (balls.Overlap(paddle.Position, paddle.Size, this->ballHits) > 0)
+	{
+		for (GLuint i = 0; i < balls.Count(); ++i)
+		{
+			if (balls.Stuck[i] || !this->ballHits[i])
+				continue;
+			balls.Stuck[i] = balls.Sticky;
+			balls.Owner[i] = owner;
+			// Check where it hit the board, and change velocity based on where it hit the board
+			Real centerBoard = paddle.Position.x + paddle.Size.x / 2;
+			Real distance = (balls.PosX[i] + balls.Radius) - centerBoard;
+			Real percentage = distance / (paddle.Size.x / 2);
+			// Then move accordingly
+			Real strength = 2.0f;
+			Vec2 oldVelocity = balls.Velocity(i);
+			Vec2 velocity(INITIAL_BALL_VELOCITY.x * percentage * strength, oldVelocity.y);
+			velocity = Normalize(velocity) * Length(oldVelocity); // Keep speed consistent over both axes (multiply by length of old velocity, so total strength is not changed)
+			balls.VelX[i] = velocity.x;
+			// Fix sticky paddle
+			balls.VelY[i] = -1 * Abs(velocity.y);
+		}
 	}
+}
 
-	for(PowerUp& powerUp : this->PowerUps)
+void Game::collectPowerUps()
+{
+	// Power-ups below the screen are all at the end of the list
+	while (!this->PowerUps.empty() && this->PowerUps.back().Position.y >= this->Height)
+		this->PowerUps.pop_back();
+	// Sweep up from the bottom until the power-ups are above the paddle; nothing further up can touch it
+	// (the versus opponent's paddle is at the same height)
+	std::deque<PowerUp>::iterator band = this->PowerUps.end();
+	while (band != this->PowerUps.begin() && (band - 1)->Position.y + (band - 1)->Size.y >= this->Player.Position.y)
+		--band;
+	GameObject *paddles[2] = { &this->Player, &this->Opponent };
+	GLuint paddleCount = this->Versus ? 2 : 1;
+	GLboolean caught = GL_FALSE;
+	for (std::deque<PowerUp>::iterator powerUp = band; powerUp != this->PowerUps.end(); ++powerUp)
 	{
-		if(!powerUp.Destroyed)
+		for (GLuint i = 0; i < paddleCount && !powerUp->Destroyed; ++i)
 		{
-			if(powerUp.Position.y >= this->Height)
-				powerUp.Destroyed = GL_TRUE;
-			if(CheckCollision(*Player, powerUp))
+			if (CheckCollision(*paddles[i], *powerUp))
 			{
-				ActivatePowerUp(powerUp);
-				powerUp.Destroyed = GL_TRUE;
-				powerUp.Activated = GL_TRUE;
+				this->ActivatePowerUp(*powerUp, *paddles[i]);
+				powerUp->Destroyed = GL_TRUE;
+				caught = GL_TRUE;
 			}
 		}
 	}
+	// Caught ones are removed in one go, and only ever from the band
+	if (caught)
+		this->PowerUps.erase(std::remove_if(band, this->PowerUps.end(), [](const PowerUp &powerUp) { return powerUp.Destroyed; }),
+		                     this->PowerUps.end());
 }
 
-void ActivatePowerUp(PowerUp& powerUp)
+void Game::ActivatePowerUp(PowerUp& powerUp, GameObject& paddle)
 {
 	if(powerUp.Type == "speed")
 	{
-		Ball->Velocity *= 1.2;
+		for (GLuint i = 0; i < this->Balls.Count(); ++i)
+		{
+			this->Balls.VelX[i] *= 1.2f;
+			this->Balls.VelY[i] *= 1.2f;
+		}
 	}
 	else if(powerUp.Type == "sticky")
 	{
-		Ball->Sticky = GL_TRUE;
-		Player->Color = glm::vec3(1.0f, 0.5f, 1.0f);
+		this->Balls.Sticky = GL_TRUE;
+		paddle.Color = glm::vec3(1.0f, 0.5f, 1.0f);
+		this->Timers.Start(EFFECT_STICKY, this->Clock, powerUp.Duration);
 	}
 	else if(powerUp.Type == "pass-through")
 	{
-		Ball->PassThrough = GL_TRUE;
-		Ball->Color = glm::vec3(1.0f, 0.5f, 0.5f);
+		this->Balls.PassThrough = GL_TRUE;
+		this->Balls.Color = glm::vec3(1.0f, 0.5f, 0.5f);
+		this->Timers.Start(EFFECT_PASS_THROUGH, this->Clock, powerUp.Duration);
 	}
 	else if(powerUp.Type == "pad-size-increase")
 	{
-		Player->Size.x += 50;
+		paddle.Size.x += 50;
 	}
 	else if(powerUp.Type == "confuse")
 	{
-		if(!Effects->Chaos)
-			Effects->Confuse = GL_TRUE;
+		if(!this->Chaos)
+			this->Confuse = GL_TRUE;
+		this->Timers.Start(EFFECT_CONFUSE, this->Clock, powerUp.Duration);
 	}
 	else if(powerUp.Type == "chaos")
 	{
-		if(!Effects->Confuse)
-			Effects->Chaos = GL_TRUE;
+		if(!this->Confuse)
+			this->Chaos = GL_TRUE;
+		this->Timers.Start(EFFECT_CHAOS, this->Clock, powerUp.Duration);
 	}
 }
 
-GLboolean ShouldSpawn(GLuint chance)
+GLboolean Game::shouldSpawn(GLuint chance)
 {
-	GLuint random = rand() % chance;
-	return random == 0;
+	this->Random ^= this->Random << 13;
+	this->Random ^= this->Random >> 17;
+	this->Random ^= this->Random << 5;
+	return this->Random % chance == 0;
 }
 
 void Game::SpawnPowerUps(GameObject &block)
 {
-	if(ShouldSpawn(75))
+	if(this->shouldSpawn(75))
 	{
 		auto tex_speed = ResourceManager::GetTexture("powerup_speed");
-		auto p = new PowerUp("speed", glm::vec3(0.5f, 0.5f, 1.0f), 0.0f, block.Position, tex_speed);
-		this->PowerUps.push_back(*p);
+		this->addPowerUp(PowerUp("speed", glm::vec3(0.5f, 0.5f, 1.0f), 0.0f, block.Position, tex_speed));
 	}
-	if(ShouldSpawn(75))
+	if(this->shouldSpawn(75))
 	{
 		auto tex_sticky = ResourceManager::GetTexture("powerup_sticky");
-		auto p = new PowerUp("sticky", glm::vec3(1.0f, 0.5f, 1.0f), 20.0f, block.Position, tex_sticky);
-		this->PowerUps.push_back(*p);
+		this->addPowerUp(PowerUp("sticky", glm::vec3(1.0f, 0.5f, 1.0f), 20.0f, block.Position, tex_sticky));
 	}
-	if(ShouldSpawn(75))
+	if(this->shouldSpawn(75))
 	{
 		auto tex_pass = ResourceManager::GetTexture("powerup_passthrough");
-		auto p = new PowerUp("pass-through", glm::vec3(0.5f, 1.0f, 0.5f), 10.0f, block.Position, tex_pass);
-		this->PowerUps.push_back(*p);
+		this->addPowerUp(PowerUp("pass-through", glm::vec3(0.5f, 1.0f, 0.5f), 10.0f, block.Position, tex_pass));
 	}
-	if(ShouldSpawn(75))
+	if(this->shouldSpawn(75))
 	{
 		auto tex_size = ResourceManager::GetTexture("powerup_increase");
-		auto p = new PowerUp("pad-size-increase", glm::vec3(1.0f, 0.6f, 0.4f), 0.0f, block.Position, tex_size);
-		this->PowerUps.push_back(*p);
+		this->addPowerUp(PowerUp("pad-size-increase", glm::vec3(1.0f, 0.6f, 0.4f), 0.0f, block.Position, tex_size));
 	}
-	if(ShouldSpawn(15))
+	if(this->shouldSpawn(15))
 	{
 		auto tex_confuse = ResourceManager::GetTexture("powerup_confuse");
-		auto p = new PowerUp("confuse", glm::vec3(1.0f, 0.3f, 0.3f), 15.0f, block.Position, tex_confuse);
-		this->PowerUps.push_back(*p);
+		this->addPowerUp(PowerUp("confuse", glm::vec3(1.0f, 0.3f, 0.3f), 15.0f, block.Position, tex_confuse));
 	}
-	if(ShouldSpawn(75))
+	if(this->shouldSpawn(75))
 	{
-		auto tex_chaos = ResourceManager::GetTexture("powerup_chaose");
-		auto p = new PowerUp("chaos", glm::vec3(0.9f, 0.25f, 0.25f), 15.0f, block.Position, tex_chaos);
-		this->PowerUps.push_back(*p);
+		auto tex_chaos = ResourceManager::GetTexture("powerup_chaos");
+		this->addPowerUp(PowerUp("chaos", glm::vec3(0.9f, 0.25f, 0.25f), 15.0f, block.Position, tex_chaos));
 	}
 }
 
-GLboolean isOtherPowerUpActive(std::vector<PowerUp> powerUps, std::string name)
+void Game::addPowerUp(const PowerUp &powerUp)
 {
-	for(const PowerUp& powerUp : powerUps)
-	{
-		if(powerUp.Activated && powerUp.Type == name)
-			return GL_TRUE;
-	}
-	return GL_FALSE;
+	// New ones usually start above all falling ones, so this inserts at or near the front
+	std::deque<PowerUp>::iterator position = std::upper_bound(this->PowerUps.begin(), this->PowerUps.end(), powerUp,
+			[](const PowerUp &one, const PowerUp &two) { return one.Position.y < two.Position.y; });
+	this->PowerUps.insert(position, powerUp);
 }
 
 void Game::UpdatePowerUps(GLfloat dt)
 {
 	for(PowerUp& powerUp : this->PowerUps)
-	{
 		powerUp.Position += powerUp.Velocity * dt;
-		if(powerUp.Activated)
-		{
-			powerUp.Duration -= dt;
-			if(powerUp.Duration <= 0.0f)
-			{
-				powerUp.Activated = GL_FALSE;
-
-				if(powerUp.Type == "sticky")
-				{
-					if(!isOtherPowerUpActive(this->PowerUps, "sticky"))
-					{
-						Ball->Sticky = GL_FALSE;
-						Player->Color = glm::vec3(1.0);
-					}
-				}
-				else if(powerUp.Type == "pass-through")
-				{
-					if(!isOtherPowerUpActive(this->PowerUps, "pass-through"))
-					{
-						Ball->PassThrough = GL_FALSE;
-						Ball->Color = glm::vec3(1.0f);
-					}
-				}
-				else if(powerUp.Type == "confuse")
-				{
-					if(!isOtherPowerUpActive(this->PowerUps, "sticky"))
-					{
-						Effects->Confuse = GL_FALSE;
-					}
-				}
-				else if(powerUp.Type == "chaos")
-				{
-					if(!isOtherPowerUpActive(this->PowerUps, "chaos"))
-					{
-						Effects->Chaos = GL_FALSE;
-					}
-				}
-			}
-		}
-	}
+	// Only timers that are due are touched, however many effects are running
+	this->Clock += dt;
+	TimedEffect effect;
+	while (this->Timers.Expire(this->Clock, effect))
+		this->endEffect(effect);
+}
 
-	this->PowerUps.erase(std::remove_if(this->PowerUps.begin(), this->PowerUps.end(),
-			[](const PowerUp& powerUp) {
-				return powerUp.Destroyed && !powerUp.Activated;
-			}
-	), this->PowerUps.end());
+void Game::endEffect(TimedEffect effect)
+{
+	switch (effect)
+	{
+	case EFFECT_STICKY:
+		this->Balls.Sticky = GL_FALSE;
+		this->Player.Color = glm::vec3(1.0);
+		this->Opponent.Color = OPPONENT_COLOR;
+		break;
+	case EFFECT_PASS_THROUGH:
+		this->Balls.PassThrough = GL_FALSE;
+		this->Balls.Color = glm::vec3(1.0f);
+		break;
+	case EFFECT_CONFUSE:
+		this->Confuse = GL_FALSE;
+		break;
+	case EFFECT_CHAOS:
+		this->Chaos = GL_FALSE;
+		break;
+	case EFFECT_SHAKE:
+		this->Shake = GL_FALSE;
+		break;
+	default:
+		break;
+	}
 }
 
 GLboolean CheckCollision(GameObject &one, GameObject &two) // AABB - AABB collision
@@ -513,41 +964,41 @@ GLboolean CheckCollision(GameObject &one, GameObject &two) // AABB - AABB collis
 	return collisionX && collisionY;
 }
 
-Collision CheckCollision(BallObject &one, GameObject &two) // AABB - Circle collision
+Collision CheckCollision(const BallBatch &balls, GLuint i, GameObject &two) // AABB - Circle collision
 {
 	// Get center point circle first
-	glm::vec2 center(one.Position + one.Radius);
+	Vec2 center(balls.Position(i) + balls.Radius);
 	// Calculate AABB info (center, half-extents)
-	glm::vec2 aabb_half_extents(two.Size.x / 2, two.Size.y / 2);
-	glm::vec2 aabb_center(two.Position.x + aabb_half_extents.x, two.Position.y + aabb_half_extents.y);
+	Vec2 aabb_half_extents(two.Size.x / 2, two.Size.y / 2);
+	Vec2 aabb_center(two.Position.x + aabb_half_extents.x, two.Position.y + aabb_half_extents.y);
 	// Get difference vector between both centers
-	glm::vec2 difference = center - aabb_center;
-	glm::vec2 clamped = glm::clamp(difference, -aabb_half_extents, aabb_half_extents);
+	Vec2 difference = center - aabb_center;
+	Vec2 clamped = Clamp(difference, -aabb_half_extents, aabb_half_extents);
 	// Now that we know the the clamped values, add this to AABB_center and we get the value of box closest to circle
-	glm::vec2 closest = aabb_center + clamped;
+	Vec2 closest = aabb_center + clamped;
 	// Now retrieve vector between center circle and closest point AABB and check if length < radius
 	difference = closest - center;
 
-	if (glm::length(difference) < one.Radius) // not <= since in that case a collision also occurs when object one exactly touches object two, which they are at the end of each collision resolution stage.
+	if (Length(difference) < balls.Radius) // not <= since in that case a collision also occurs when object one exactly touches object two, which they are at the end of each collision resolution stage.
 		return std::make_tuple(GL_TRUE, VectorDirection(difference), difference);
 	else
-		return std::make_tuple(GL_FALSE, UP, glm::vec2(0, 0));
+		return std::make_tuple(GL_FALSE, UP, Vec2(0, 0));
 }
 
 // Calculates which direction a vector is facing (N,E,S or W)
-Direction VectorDirection(glm::vec2 target)
+Direction VectorDirection(Vec2 target)
 {
-	glm::vec2 compass[] = {
-			glm::vec2(0.0f, 1.0f),	// up
-			glm::vec2(1.0f, 0.0f),	// right
-			glm::vec2(0.0f, -1.0f),	// down
-			glm::vec2(-1.0f, 0.0f)	// left
+	Vec2 compass[] = {
+			Vec2(0.0f, 1.0f),	// up
+			Vec2(1.0f, 0.0f),	// right
+			Vec2(0.0f, -1.0f),	// down
+			Vec2(-1.0f, 0.0f)	// left
 	};
-	GLfloat max = 0.0f;
+	Real max = 0.0f;
 	GLuint best_match = -1;
 	for (GLuint i = 0; i < 4; i++)
 	{
-		GLfloat dot_product = glm::dot(glm::normalize(target), compass[i]);
+		Real dot_product = Dot(Normalize(target), compass[i]);
 		if (dot_product > max)
 		{
 			max = dot_product;
@@ -12,22 +12,30 @@
 ** option) any later version.
 ******************************************************************/
 
-#include <fstream>
 #include <sstream>
 
+#include "ResourcePack.hpp"
+#include "StateHash.hpp"
+
+// Source of unique GameLevel::Revision values, shared by all levels
+static GLuint NextRevision = 1;
 
 void GameLevel::Load(const GLchar *file, GLuint levelWidth, GLuint levelHeight)
 {
 	// Clear old data
 	this->Bricks.clear();
+	this->Standing = 0;
+	this->Revision = NextRevision++;
+	this->File = file;
 	// Load from file
 	GLuint tileCode;
 	GameLevel level;
 	std::string line;
-	std::ifstream fstream(file);
+	ResourceData data;
 	std::vector<std::vector<GLuint>> tileData;
-	if (fstream)
+	if (ResourcePack::Read(file, data))
 	{
+		std::istringstream fstream(std::string(reinterpret_cast<const char*>(data.Data), data.Size));
 		while (std::getline(fstream, line)) // Read each line from level file
 		{
 			std::istringstream sstream(line);
@@ -41,6 +49,12 @@ void GameLevel::Load(const GLchar *file, GLuint levelWidth, GLuint levelHeight)
 	}
 }
 
+void GameLevel::Destroy(GLuint index)
+{
+	this->Bricks[index].Destroyed = GL_TRUE;
+	this->Standing ^= StateHash::BrickKey(index);
+}
+
 void GameLevel::Draw(SpriteRenderer &renderer)
 {
 	for (GameObject &tile : this->Bricks)
@@ -61,7 +75,7 @@ void GameLevel::init(std::vector<std::vector<GLuint>> tileData, GLuint levelWidt
 	// Calculate dimensions
 	GLuint height = tileData.size();
 	GLuint width = tileData[0].size(); // Note we can index vector at [0] since this function is only called if height > 0
-	GLfloat unit_width = levelWidth / static_cast<GLfloat>(width), unit_height = levelHeight / height;
+	Real unit_width = Real(levelWidth) / Real(width), unit_height = levelHeight / height;
 	// Initialize level tiles based on tileData
 	for (GLuint y = 0; y < height; ++y)
 	{
@@ -70,10 +84,11 @@ void GameLevel::init(std::vector<std::vector<GLuint>> tileData, GLuint levelWidt
 			// Check block type from level data (2D level array)
 			if (tileData[y][x] == 1) // Solid
 			{
-				glm::vec2 pos(unit_width * x, unit_height * y);
-				glm::vec2 size(unit_width, unit_height);
+				Vec2 pos(unit_width * x, unit_height * y);
+				Vec2 size(unit_width, unit_height);
 				GameObject obj(pos, size, ResourceManager::GetTexture("block_solid"), glm::vec3(0.8f, 0.8f, 0.7f));
 				obj.IsSolid = GL_TRUE;
+				this->Standing ^= StateHash::BrickKey(this->Bricks.size());
 				this->Bricks.push_back(obj);
 			}
 			else if (tileData[y][x] > 1)	// Non-solid; now determine its color based on level data
@@ -88,8 +103,9 @@ void GameLevel::init(std::vector<std::vector<GLuint>> tileData, GLuint levelWidt
 				else if (tileData[y][x] == 5)
 					color = glm::vec3(1.0f, 0.5f, 0.0f);
 
-				glm::vec2 pos(unit_width * x, unit_height * y);
-				glm::vec2 size(unit_width, unit_height);
+				Vec2 pos(unit_width * x, unit_height * y);
+				Vec2 size(unit_width, unit_height);
+				this->Standing ^= StateHash::BrickKey(this->Bricks.size());
 				this->Bricks.push_back(GameObject(pos, size, ResourceManager::GetTexture("block"), color));
 			}
 		}
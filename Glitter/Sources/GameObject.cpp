@@ -14,12 +14,12 @@
 
 
 GameObject::GameObject()
-		: Position(0, 0), Size(1, 1), Velocity(0.0f), Color(1.0f), Rotation(0.0f), Sprite(), IsSolid(false), Destroyed(false) { }
+		: Position(0, 0), Size(1, 1), Velocity(0.0f, 0.0f), Color(1.0f), Rotation(0.0f), Sprite(), IsSolid(false), Destroyed(false) { }
 
-GameObject::GameObject(glm::vec2 pos, glm::vec2 size, Texture2D sprite, glm::vec3 color, glm::vec2 velocity)
+GameObject::GameObject(Vec2 pos, Vec2 size, Texture2D sprite, glm::vec3 color, Vec2 velocity)
 		: Position(pos), Size(size), Velocity(velocity), Color(color), Rotation(0.0f), Sprite(sprite), IsSolid(false), Destroyed(false) { }
 
 void GameObject::Draw(SpriteRenderer &renderer)
 {
-	renderer.DrawSprite(this->Sprite, this->Position, this->Size, this->Rotation, this->Color);
+	renderer.DrawSprite(this->Sprite, ToFloat(this->Position), ToFloat(this->Size), this->Rotation, this->Color);
 }
@@ -0,0 +1,99 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "HeadlessContext.hpp"
+
+#include <iostream>
+#include <string>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+
+HeadlessContext::HeadlessContext()
+	: display(nullptr), context(nullptr)
+{
+}
+
+HeadlessContext::~HeadlessContext()
+{
+#ifdef __linux__
+	if (this->display == nullptr)
+		return;
+	eglMakeCurrent(this->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (this->context != nullptr)
+		eglDestroyContext(this->display, this->context);
+	eglTerminate(this->display);
+#endif
+}
+
+GLboolean HeadlessContext::Create()
+{
+#ifdef __linux__
+	// The surfaceless platform needs no X11, Wayland or GPU device; without it, try the default display
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	EGLDisplay display = EGL_NO_DISPLAY;
+	if (getPlatformDisplay != nullptr)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+	{
+		std::cout << "ERROR::CONTEXT: Failed to initialize an EGL display" << std::endl;
+		return GL_FALSE;
+	}
+	this->display = display;
+	if (!eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cout << "ERROR::CONTEXT: EGL does not support desktop OpenGL" << std::endl;
+		return GL_FALSE;
+	}
+	// Without a surface the context needs no config either (EGL_KHR_no_config_context), pick any if that is missing
+	EGLConfig config = nullptr;
+	const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+	if (extensions == nullptr || std::string(extensions).find("EGL_KHR_no_config_context") == std::string::npos)
+	{
+		const EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+		EGLint count = 0;
+		eglChooseConfig(display, configAttributes, &config, 1, &count);
+		if (count == 0)
+			config = nullptr;
+	}
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 0,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	this->context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (this->context == EGL_NO_CONTEXT)
+	{
+		this->context = nullptr;
+		std::cout << "ERROR::CONTEXT: Failed to create an OpenGL 4.0 core context (EGL error 0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+		return GL_FALSE;
+	}
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, this->context))
+	{
+		std::cout << "ERROR::CONTEXT: Failed to make the context current without a surface" << std::endl;
+		return GL_FALSE;
+	}
+	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)))
+	{
+		std::cout << "ERROR::CONTEXT: Failed to load the OpenGL functions" << std::endl;
+		return GL_FALSE;
+	}
+	return GL_TRUE;
+#else
+	std::cout << "ERROR::CONTEXT: Headless contexts need EGL (Linux)" << std::endl;
+	return GL_FALSE;
+#endif
+}
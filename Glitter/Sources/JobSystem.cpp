@@ -0,0 +1,216 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include "Profiler.hpp"
+
+
+// System and deque of the pool thread running this code; threads outside any pool use deque 0
+static thread_local JobSystem *currentSystem = nullptr;
+static thread_local GLuint     currentQueue = 0;
+
+JobSystem::JobSystem(GLuint threads)
+	: queued(0), steals(0), stopping(GL_FALSE)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	for (GLuint i = 0; i < threads; ++i)
+		this->queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	for (GLuint i = 1; i < threads; ++i)
+		this->workers.push_back(std::thread(&JobSystem::worker, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->sleepMutex);
+		this->stopping = GL_TRUE;
+	}
+	this->wake.notify_all();
+	for (std::thread &worker : this->workers)
+		worker.join();
+}
+
+void JobSystem::Push(std::function<void()> job, Counter &counter)
+{
+	Queue &queue = this->own();
+	{
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		Job entry = { std::move(job), &counter };
+		queue.Jobs.push_back(std::move(entry));
+	}
+	this->queued.fetch_add(1);
+	// Sleepers check queued under sleepMutex, so taking it once here means none can miss the notification
+	{
+		std::lock_guard<std::mutex> lock(this->sleepMutex);
+	}
+	this->wake.notify_one();
+}
+
+void JobSystem::Wait(Counter &counter)
+{
+	while (counter.load(std::memory_order_acquire) != 0)
+		if (!this->runOne())
+			std::this_thread::yield();
+}
+
+void JobSystem::ParallelFor(GLuint count, GLuint grain, const std::function<void(GLuint, GLuint)> &work)
+{
+	grain = std::max(1u, grain);
+	GLuint chunks = (count + grain - 1) / grain;
+	if (chunks <= 1)
+	{
+		if (count > 0)
+			work(0, count);
+		return;
+	}
+	// The caller takes the first chunk itself, the others are up for stealing
+	Counter pending(chunks - 1);
+	for (GLuint chunk = 1; chunk < chunks; ++chunk)
+		this->Push([&work, chunk, grain, count]() { work(chunk * grain, std::min(count, (chunk + 1) * grain)); }, pending);
+	work(0, grain);
+	this->Wait(pending);
+}
+
+JobSystem::Queue &JobSystem::own()
+{
+	return *this->queues[currentSystem == this ? currentQueue : 0];
+}
+
+GLboolean JobSystem::runOne()
+{
+	GLuint self = currentSystem == this ? currentQueue : 0;
+	Job job;
+	GLboolean found = GL_FALSE;
+	{
+		Queue &queue = *this->queues[self];
+		std::lock_guard<std::mutex> lock(queue.Mutex);
+		if (!queue.Jobs.empty())
+		{
+			job = std::move(queue.Jobs.back());
+			queue.Jobs.pop_back();
+			found = GL_TRUE;
+		}
+	}
+	for (GLuint i = 1; !found && i < this->queues.size(); ++i)
+	{
+		Queue &victim = *this->queues[(self + i) % this->queues.size()];
+		std::lock_guard<std::mutex> lock(victim.Mutex);
+		if (!victim.Jobs.empty())
+		{
+			job = std::move(victim.Jobs.front());
+			victim.Jobs.pop_front();
+			found = GL_TRUE;
+			this->steals.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	if (!found)
+		return GL_FALSE;
+	this->queued.fetch_sub(1);
+	job.Work();
+	job.Pending->fetch_sub(1, std::memory_order_release);
+	return GL_TRUE;
+}
+
+void JobSystem::worker(GLuint queue)
+{
+	currentSystem = this;
+	currentQueue = queue;
+	for (;;)
+	{
+		if (this->runOne())
+			continue;
+		std::unique_lock<std::mutex> lock(this->sleepMutex);
+		this->wake.wait(lock, [this]() { return this->stopping || this->queued.load() > 0; });
+		if (this->stopping)
+			return;
+	}
+}
+
+
+GLuint JobGraph::Add(const std::string &name, std::function<void()> work, std::initializer_list<GLuint> after)
+{
+	GLuint index = static_cast<GLuint>(this->stages.size());
+	Stage stage;
+	stage.Name = "stage " + name;
+	stage.Work = std::move(work);
+	stage.Dependencies = static_cast<GLuint>(after.size());
+	stage.Time = 0.0;
+	// Dependencies always come first, so the order of Add is a valid order to run the stages in
+	for (GLuint dependency : after)
+		this->stages[dependency].Dependents.push_back(index);
+	this->stages.push_back(std::move(stage));
+	this->waiting.reset(new std::atomic<GLuint>[this->stages.size()]);
+	return index;
+}
+
+void JobGraph::Run(JobSystem *jobs)
+{
+	if (jobs == nullptr)
+	{
+		for (GLuint stage = 0; stage < this->stages.size(); ++stage)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			this->stages[stage].Work();
+			this->stages[stage].Time = std::chrono::duration<GLdouble, std::milli>(std::chrono::steady_clock::now() - start).count();
+			Profiler::AddTime(this->stages[stage].Name, this->stages[stage].Time);
+		}
+		return;
+	}
+	for (GLuint stage = 0; stage < this->stages.size(); ++stage)
+		this->waiting[stage] = this->stages[stage].Dependencies;
+	// Pushed stage jobs that have not finished; a job pushes its successors before it finishes, so it only drops
+	// to zero once no stage is left
+	JobSystem::Counter pending(0);
+	GLuint first = NONE;
+	for (GLuint stage = 0; stage < this->stages.size(); ++stage)
+	{
+		if (this->stages[stage].Dependencies != 0)
+			continue;
+		if (first == NONE)
+			first = stage;
+		else
+			this->push(stage, jobs, pending);
+	}
+	if (first != NONE)
+		this->runStage(first, jobs, pending);
+	jobs->Wait(pending);
+}
+
+void JobGraph::runStage(GLuint stage, JobSystem *jobs, JobSystem::Counter &pending)
+{
+	// The first successor that becomes ready continues on this thread, so a chain of stages costs no hand-overs
+	while (stage != NONE)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		this->stages[stage].Work();
+		this->stages[stage].Time = std::chrono::duration<GLdouble, std::milli>(std::chrono::steady_clock::now() - start).count();
+		Profiler::AddTime(this->stages[stage].Name, this->stages[stage].Time);
+		GLuint next = NONE;
+		for (GLuint dependent : this->stages[stage].Dependents)
+		{
+			if (this->waiting[dependent].fetch_sub(1) != 1)
+				continue;
+			if (next == NONE)
+				next = dependent;
+			else
+				this->push(dependent, jobs, pending);
+		}
+		stage = next;
+	}
+}
+
+void JobGraph::push(GLuint stage, JobSystem *jobs, JobSystem::Counter &pending)
+{
+	pending.fetch_add(1);
+	jobs->Push([this, stage, jobs, &pending]() { this->runStage(stage, jobs, pending); }, pending);
+}
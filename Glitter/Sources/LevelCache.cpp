@@ -0,0 +1,238 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "LevelCache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "FrameUniforms.hpp"
+#include "GLState.hpp"
+#include "SoftwareBackend.hpp"
+
+LevelCache::LevelCache(Shader brickShader, GLuint width, GLuint height)
+	: Texture(), Width(width), Height(height), PixelScale(1.0f), rasterizer(nullptr), brickShader(brickShader), instanceCount(0), revision(0)
+{
+	glGenFramebuffers(1, &this->FBO);
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+	this->Texture.Generate(width, height, nullptr);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->Texture.ID, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::LEVELCACHE: Failed to initialize FBO" << std::endl;
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, GLState::OutputFramebuffer);
+
+	// Every brick is the unit quad, placed by its instance attributes
+	GLfloat quad[] = {
+			// Pos      // Tex
+			0.0f, 1.0f, 0.0f, 1.0f,
+			1.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 0.0f,
+
+			0.0f, 1.0f, 0.0f, 1.0f,
+			1.0f, 1.0f, 1.0f, 1.0f,
+			1.0f, 0.0f, 1.0f, 0.0f
+	};
+	glGenVertexArrays(1, &this->brickVAO);
+	glGenBuffers(1, &this->quadVBO);
+	glGenBuffers(1, &this->instanceVBO);
+	glGenBuffers(1, &this->aliveVBO);
+	GLState::BindVertexArray(this->brickVAO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, this->quadVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+	// Per brick: <vec4 rect, vec4 uvRect, vec3 color>
+	const GLsizei stride = 11 * sizeof(GLfloat);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)0);
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(4 * sizeof(GLfloat)));
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (GLvoid*)(8 * sizeof(GLfloat)));
+	glVertexAttribDivisor(3, 1);
+	// The alive flags change during play, so they get a buffer of their own
+	GLState::BindBuffer(GL_ARRAY_BUFFER, this->aliveVBO);
+	glEnableVertexAttribArray(4);
+	glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), (GLvoid*)0);
+	glVertexAttribDivisor(4, 1);
+}
+
+LevelCache::LevelCache(SoftwareBackend &rasterizer, GLuint width, GLuint height)
+	: Texture(), Width(width), Height(height), PixelScale(1.0f), FBO(0), rasterizer(&rasterizer), brickVAO(0), quadVBO(0), instanceVBO(0),
+	  aliveVBO(0), instanceCount(0), revision(0)
+{
+	this->Texture.Generate(width, height, nullptr);
+}
+
+LevelCache::~LevelCache()
+{
+	if (this->rasterizer != nullptr)
+		return;
+	GLState::DeleteFramebuffer(this->FBO);
+	GLState::DeleteTexture(this->Texture.ID);
+	GLState::DeleteVertexArray(this->brickVAO);
+	GLState::DeleteBuffer(this->quadVBO);
+	GLState::DeleteBuffer(this->instanceVBO);
+	GLState::DeleteBuffer(this->aliveVBO);
+}
+
+void LevelCache::Invalidate()
+{
+	this->revision = 0;
+}
+
+void LevelCache::Resize(GLfloat pixelScale)
+{
+	if (pixelScale == this->PixelScale)
+		return;
+	this->PixelScale = pixelScale;
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+	this->Texture.Generate(std::max(1L, std::lround(this->Width * pixelScale)), std::max(1L, std::lround(this->Height * pixelScale)), nullptr);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->Texture.ID, 0);
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, GLState::OutputFramebuffer);
+	this->Invalidate();
+}
+
+void LevelCache::Update(const std::vector<GameObject> &bricks, GLuint revision, SpriteRenderer &renderer, const Texture2D &background)
+{
+	// A different layout (level switch or reload) means everything is stale
+	if (revision != this->revision || bricks.size() != this->destroyed.size())
+	{
+		this->revision = revision;
+		this->destroyed.assign(bricks.size(), GL_FALSE);
+		for (GLuint i = 0; i < bricks.size(); ++i)
+			this->destroyed[i] = bricks[i].Destroyed;
+		this->uploadBricks(bricks);
+		this->redraw(renderer, background, glm::vec4(0.0f, 0.0f, this->Width, this->Height));
+		return;
+	}
+	// Otherwise collect the union of all bricks destroyed since the last update
+	glm::vec4 dirty(this->Width, this->Height, 0.0f, 0.0f);
+	GLboolean changed = GL_FALSE;
+	for (GLuint i = 0; i < bricks.size(); ++i)
+	{
+		if (bricks[i].Destroyed == this->destroyed[i])
+			continue;
+		this->destroyed[i] = bricks[i].Destroyed;
+		// Only the brick's flag changes on the GPU
+		if (this->rasterizer == nullptr)
+		{
+			GLfloat alive = this->destroyed[i] ? 0.0f : 1.0f;
+			GLState::BindBuffer(GL_ARRAY_BUFFER, this->aliveVBO);
+			glBufferSubData(GL_ARRAY_BUFFER, i * sizeof(GLfloat), sizeof(GLfloat), &alive);
+		}
+		glm::vec2 position = ToFloat(bricks[i].Position), size = ToFloat(bricks[i].Size);
+		dirty.x = glm::min(dirty.x, position.x);
+		dirty.y = glm::min(dirty.y, position.y);
+		dirty.z = glm::max(dirty.z, position.x + size.x);
+		dirty.w = glm::max(dirty.w, position.y + size.y);
+		changed = GL_TRUE;
+	}
+	if (changed)
+		this->redraw(renderer, background, dirty);
+}
+
+void LevelCache::Draw(SpriteRenderer &renderer)
+{
+	renderer.DrawSprite(this->Texture, glm::vec2(0.0f, 0.0f), glm::vec2(this->Width, this->Height), 0.0f);
+}
+
+void LevelCache::redraw(SpriteRenderer &renderer, const Texture2D &background, glm::vec4 rect)
+{
+	// Snap the rectangle outwards to whole game units
+	GLint x0 = std::max(0, static_cast<GLint>(std::floor(rect.x)));
+	GLint y0 = std::max(0, static_cast<GLint>(std::floor(rect.y)));
+	GLint x1 = std::min(static_cast<GLint>(this->Width), static_cast<GLint>(std::ceil(rect.z)));
+	GLint y1 = std::min(static_cast<GLint>(this->Height), static_cast<GLint>(std::ceil(rect.w)));
+	if (x1 <= x0 || y1 <= y0)
+		return;
+
+	if (this->rasterizer != nullptr)
+	{
+		// One pixel per game unit, and the layer's rows already run like game y coordinates
+		this->rasterizer->BeginLayer(this->Texture, x0, y0, x1, y1);
+		renderer.DrawSprite(background, glm::vec2(0.0f, 0.0f), glm::vec2(this->Width, this->Height), 0.0f);
+		Texture2D sprite = this->brickTexture;
+		for (GLuint i = 0; i < this->instanceCount; ++i)
+		{
+			if (this->destroyed[i])
+				continue;
+			const GLfloat *instance = &this->instances[i * 11];
+			sprite.UV = glm::vec4(instance[4], instance[5], instance[6], instance[7]);
+			renderer.BatchSprite(sprite, glm::vec2(instance[0], instance[1]), glm::vec2(instance[2], instance[3]), 0.0f,
+			                     glm::vec3(instance[8], instance[9], instance[10]));
+		}
+		renderer.DrawBatch();
+		this->rasterizer->EndLayer();
+		return;
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+	glViewport(0, 0, this->Texture.Width, this->Texture.Height);
+	// Render upside down compared to the screen so the cached texture can be drawn like any other sprite;
+	// this also makes framebuffer rows match game y coordinates, so the scissor box needs no flipping
+	FrameUniforms::BindFlipped(GL_TRUE);
+	glEnable(GL_SCISSOR_TEST);
+	GLint sx0 = static_cast<GLint>(std::floor(x0 * this->PixelScale)), sy0 = static_cast<GLint>(std::floor(y0 * this->PixelScale));
+	GLint sx1 = static_cast<GLint>(std::ceil(x1 * this->PixelScale)), sy1 = static_cast<GLint>(std::ceil(y1 * this->PixelScale));
+	glScissor(sx0, sy0, sx1 - sx0, sy1 - sy0);
+
+	renderer.DrawSprite(background, glm::vec2(0.0f, 0.0f), glm::vec2(this->Width, this->Height), 0.0f);
+	// All bricks in one call, whatever their number; the scissor box discards everything outside the dirty rectangle
+	if (this->instanceCount > 0)
+	{
+		this->brickShader.Use();
+		GLState::ActiveTexture(GL_TEXTURE0);
+		this->brickTexture.Bind();
+		GLState::BindVertexArray(this->brickVAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, this->instanceCount);
+	}
+
+	glDisable(GL_SCISSOR_TEST);
+	FrameUniforms::BindFlipped(GL_FALSE);
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, GLState::OutputFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void LevelCache::uploadBricks(const std::vector<GameObject> &bricks)
+{
+	std::vector<GLfloat> instances;
+	std::vector<GLfloat> alive;
+	instances.reserve(bricks.size() * 11);
+	alive.reserve(bricks.size());
+	for (const GameObject &brick : bricks)
+	{
+		// Bricks never move or rotate, so position and size are all the placement they need
+		glm::vec2 position = ToFloat(brick.Position), size = ToFloat(brick.Size);
+		GLfloat instance[11] = {
+				position.x, position.y, size.x, size.y,
+				brick.Sprite.UV.x, brick.Sprite.UV.y, brick.Sprite.UV.z, brick.Sprite.UV.w,
+				brick.Color.x, brick.Color.y, brick.Color.z
+		};
+		instances.insert(instances.end(), instance, instance + 11);
+		alive.push_back(brick.Destroyed ? 0.0f : 1.0f);
+	}
+	this->instanceCount = static_cast<GLuint>(bricks.size());
+	if (!bricks.empty())
+		this->brickTexture = bricks[0].Sprite;
+	if (this->rasterizer != nullptr)
+	{
+		this->instances.swap(instances);
+		return;
+	}
+	GLState::BindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(GLfloat), instances.data(), GL_STATIC_DRAW);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, this->aliveVBO);
+	glBufferData(GL_ARRAY_BUFFER, alive.size() * sizeof(GLfloat), alive.data(), GL_DYNAMIC_DRAW);
+}
@@ -0,0 +1,188 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "ObservationRenderer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "FrameUniforms.hpp"
+#include "GLState.hpp"
+#include "Profiler.hpp"
+#include "ResourceManager.hpp"
+
+
+ObservationRenderer::ObservationRenderer(const Shader &shader, GLuint width, GLuint height, GLuint count, GLuint gameWidth, GLuint gameHeight)
+	: Width(width), Height(height), Count(std::max(1u, count)), gameWidth(gameWidth), gameHeight(gameHeight), FBO(0), texture(0), PBO(0), slotSize(0),
+	  mapping(nullptr), nextSlot(0), observed(0), mapped(GL_FALSE), backend(shader, shader, nullptr), sprites(backend)
+{
+	// As many tiles per column as the target can be high, columns side by side
+	GLint maxSize = 4096;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	GLuint fit = (static_cast<GLuint>(maxSize) / height) * (static_cast<GLuint>(maxSize) / width);
+	if (this->Count > fit)
+	{
+		std::cout << "ERROR::OBSERVATION: Only " << fit << " of " << this->Count << " observations of " << width << " x " << height
+		          << " fit into the largest render target" << std::endl;
+		this->Count = fit;
+	}
+	this->rows = std::min(this->Count, static_cast<GLuint>(maxSize) / height);
+	this->columns = this->rows > 0 ? (this->Count + this->rows - 1) / this->rows : 0;
+	if (this->Count == 0)
+		return;
+
+	glGenTextures(1, &this->texture);
+	GLState::BindTexture(GL_TEXTURE_2D, this->texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, this->columns * width, this->rows * height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glGenFramebuffers(1, &this->FBO);
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::OBSERVATION: Failed to initialize FBO" << std::endl;
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, GLState::OutputFramebuffer);
+
+	this->slotSize = static_cast<GLsizeiptr>(this->Count) * width * height;
+	glGenBuffers(1, &this->PBO);
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, this->PBO);
+	if (GLAD_GL_VERSION_4_4)
+	{
+		// Coherent, so the read backs are visible through the mapping as soon as their fences signal
+		const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_PIXEL_PACK_BUFFER, SLOTS * this->slotSize, nullptr, flags);
+		this->mapping = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, SLOTS * this->slotSize, flags));
+		if (this->mapping == nullptr)
+			std::cout << "ERROR::OBSERVATION: Failed to map the read back buffer persistently" << std::endl;
+	}
+	else
+		glBufferData(GL_PIXEL_PACK_BUFFER, SLOTS * this->slotSize, nullptr, GL_STREAM_READ);
+	// Left bound, glReadPixels elsewhere would write into it
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+ObservationRenderer::~ObservationRenderer()
+{
+	this->unmap();
+	for (const Pending &read : this->pending)
+		glDeleteSync(read.Sync);
+	if (this->mapping != nullptr)
+	{
+		GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, this->PBO);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	GLState::DeleteBuffer(this->PBO);
+	GLState::DeleteFramebuffer(this->FBO);
+	GLState::DeleteTexture(this->texture);
+}
+
+void ObservationRenderer::Render(const std::vector<FrameSnapshot> &frames)
+{
+	this->unmap();
+	GLuint count = std::min(static_cast<GLuint>(frames.size()), this->Count);
+	if (count == 0)
+		return;
+	if (this->pending.size() == SLOTS)
+	{
+		glDeleteSync(this->pending.front().Sync);
+		this->pending.pop_front();
+	}
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, this->FBO);
+	glViewport(0, 0, this->columns * this->Width, this->rows * this->Height);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	// Framebuffer rows follow game y, so every tile reads back top row first
+	FrameUniforms::BindFlipped(GL_TRUE);
+	// Layers in the order Game::Render draws them; tiles don't overlap, so each layer is one batch across all games
+	Texture2D background = ResourceManager::GetTexture("background");
+	for (GLuint i = 0; i < count; ++i)
+		this->batch(i, background, glm::vec2(0.0f, 0.0f), glm::vec2(this->gameWidth, this->gameHeight), 0.0f, glm::vec3(1.0f));
+	this->sprites.DrawBatch();
+	// Bricks, paddle, balls and power-ups are all in the sprite atlas
+	for (GLuint i = 0; i < count; ++i)
+	{
+		const FrameSnapshot &frame = frames[i];
+		for (const GameObject &brick : frame.Bricks)
+			if (!brick.Destroyed)
+				this->batch(i, brick.Sprite, ToFloat(brick.Position), ToFloat(brick.Size), brick.Rotation, brick.Color);
+		this->batch(i, frame.Player.Sprite, ToFloat(frame.Player.Position), ToFloat(frame.Player.Size), frame.Player.Rotation, frame.Player.Color);
+		for (GLuint ball = 0; ball < frame.Balls.Count(); ++ball)
+			this->batch(i, frame.Balls.Sprite, ToFloat(frame.Balls.Position(ball)), ToFloat(frame.Balls.Size()), 0.0f, frame.Balls.Color);
+		for (const GameObject &powerUp : frame.PowerUps)
+			this->batch(i, powerUp.Sprite, ToFloat(powerUp.Position), ToFloat(powerUp.Size), powerUp.Rotation, powerUp.Color);
+	}
+	this->sprites.DrawBatch();
+	FrameUniforms::BindFlipped(GL_FALSE);
+
+	// Each column reads back as a block of consecutive images
+	Pending read = { nullptr, this->nextSlot, count };
+	this->nextSlot = (this->nextSlot + 1) % SLOTS;
+	const GLsizeiptr image = static_cast<GLsizeiptr>(this->Width) * this->Height;
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, this->PBO);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for (GLuint column = 0; column * this->rows < count; ++column)
+	{
+		GLuint images = std::min(this->rows, count - column * this->rows);
+		GLsizeiptr offset = read.Slot * this->slotSize + column * this->rows * image;
+		glReadPixels(column * this->Width, 0, this->Width, images * this->Height, GL_RED, GL_UNSIGNED_BYTE, reinterpret_cast<GLvoid*>(offset));
+	}
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	read.Sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	this->pending.push_back(read);
+
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, GLState::OutputFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+const unsigned char *ObservationRenderer::Observations()
+{
+	this->unmap();
+	if (this->pending.empty())
+		return nullptr;
+	Pending read = this->pending.front();
+	this->pending.pop_front();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	GLenum result;
+	do
+		result = glClientWaitSync(read.Sync, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+	while (result == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(read.Sync);
+	Profiler::AddTime("observation read back stall", std::chrono::duration<GLdouble, std::milli>(std::chrono::steady_clock::now() - start).count());
+	this->observed = read.Frames;
+	if (this->mapping != nullptr)
+		return this->mapping + read.Slot * this->slotSize;
+	// Without persistent mapping the slot stays mapped until the next call
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, this->PBO);
+	void *images = glMapBufferRange(GL_PIXEL_PACK_BUFFER, read.Slot * this->slotSize, static_cast<GLsizeiptr>(read.Frames) * this->Width * this->Height, GL_MAP_READ_BIT);
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	this->mapped = images != nullptr;
+	return static_cast<const unsigned char*>(images);
+}
+
+void ObservationRenderer::batch(GLuint tile, const Texture2D &texture, glm::vec2 position, glm::vec2 size, GLfloat rotate, glm::vec3 color)
+{
+	// Every tile gets an equal share of the projection's game units, i.e. Width x Height pixels of the target
+	glm::vec2 scale(1.0f / this->columns, 1.0f / this->rows);
+	glm::vec2 origin(static_cast<GLfloat>(tile / this->rows * this->gameWidth), static_cast<GLfloat>(tile % this->rows * this->gameHeight));
+	this->sprites.BatchSprite(texture, (origin + position) * scale, size * scale, rotate, color);
+}
+
+void ObservationRenderer::unmap()
+{
+	if (!this->mapped)
+		return;
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, this->PBO);
+	glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	GLState::BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	this->mapped = GL_FALSE;
+}
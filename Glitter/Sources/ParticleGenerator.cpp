@@ -5,49 +5,82 @@
 #include <iostream>
 #include "ParticleGenerator.hpp"
 
-ParticleGenerator::ParticleGenerator(Shader shader, Texture2D texture, GLuint amount)
-	: shader(shader), texture(texture), amount(amount)
+ParticleGenerator::ParticleGenerator(RenderBackend &backend, Texture2D texture, GLuint amount)
+	: Jobs(nullptr), amount(amount), backend(backend), texture(texture)
 {
 	this->init();
 }
 
 void ParticleGenerator::Update(GLfloat dt, const GameObject &object, GLuint newParticles, glm::vec2 offset)
+{
+	this->Update(dt, ToFloat(object.Position), ToFloat(object.Velocity), newParticles, offset);
+}
+
+void ParticleGenerator::Update(GLfloat dt, glm::vec2 position, glm::vec2 velocity, GLuint newParticles, glm::vec2 offset)
 {
 	for (int i = 0; i < newParticles; ++i)
 	{
 		int unusedParticle = this->firstUnusedParticle();
-		this->respawnParticle(this->particles[unusedParticle], object, offset);
+		this->respawnParticle(this->particles[unusedParticle], position, velocity, offset);
 	}
-	for (int j = 0; j < this->amount; ++j)
-	{
-		Particle& particle = this->particles[j];
-		particle.Life -= dt;
-		if(particle.Life > 0.0f)
+	// Particles move independently of each other, so large budgets are split across the job system
+	auto move = [this, dt](GLuint begin, GLuint end) {
+		for (GLuint j = begin; j < end; ++j)
 		{
-			particle.Position -= particle.Velocity * dt;
-			particle.Color -= dt * 2.5;
+			Particle& particle = this->particles[j];
+			particle.Life -= dt;
+			if(particle.Life > 0.0f)
+			{
+				particle.Position -= particle.Velocity * dt;
+				particle.Color -= dt * 2.5;
+			}
 		}
-	}
+	};
+	if (this->Jobs != nullptr)
+		this->Jobs->ParallelFor(this->amount, 4096, move);
+	else
+		move(0, this->amount);
 }
 
 void ParticleGenerator::Draw()
 {
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-	this->shader.Use();
-	for (int i = 0; i < this->particles.size(); ++i)
+	this->Draw(this->particles);
+}
+
+void ParticleGenerator::Draw(const std::vector<Particle> &particles)
+{
+	// Corners of a particle's quad: position (in particle sizes) and texture coordinates
+	static const GLfloat quad[6][4] = {
+			{ 0.0f, 1.0f, 0.0f, 1.0f },
+			{ 1.0f, 0.0f, 1.0f, 0.0f },
+			{ 0.0f, 0.0f, 0.0f, 0.0f },
+
+			{ 0.0f, 1.0f, 0.0f, 1.0f },
+			{ 1.0f, 1.0f, 1.0f, 1.0f },
+			{ 1.0f, 0.0f, 1.0f, 0.0f }
+	};
+	const GLfloat size = 10.0f;
+	const glm::vec4 &uv = this->texture.UV;
+	// All live particles go into one batch of quads, drawn with a single call
+	this->vertices.clear();
+	for (const Particle &particle : particles)
 	{
-		auto particle = this->particles[i];
-		if(particle.Life > 0.0f)
+		if (particle.Life <= 0.0f)
+			continue;
+		for (const GLfloat *corner : quad)
 		{
-			this->shader.SetVector2f("offset", particle.Position);
-			this->shader.SetVector4f("color", particle.Color);
-			this->texture.Bind();
-			glBindVertexArray(this->VAO);
-			glDrawArrays(GL_TRIANGLES, 0, 6);
-			glBindVertexArray(0);
+			RenderBackend::Vertex vertex = {
+					particle.Position.x + corner[0] * size, particle.Position.y + corner[1] * size,
+					uv.x + corner[2] * uv.z, uv.y + corner[3] * uv.w,
+					particle.Color.x, particle.Color.y, particle.Color.z, particle.Color.w
+			};
+			this->vertices.push_back(vertex);
 		}
 	}
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC1_ALPHA);
+	if (this->vertices.empty())
+		return;
+	// Use additive blending to give it a 'glow' effect
+	this->backend.DrawTriangles(this->texture, this->vertices.data(), static_cast<GLsizei>(this->vertices.size()), RenderBackend::BLEND_ADDITIVE);
 }
 
 GLuint lastUsedParticle = 0;
@@ -74,38 +107,18 @@ GLuint ParticleGenerator::firstUnusedParticle()
 	return 0;
 }
 
-void ParticleGenerator::respawnParticle(Particle &particle, const GameObject &object, glm::vec2 offset)
+void ParticleGenerator::respawnParticle(Particle &particle, glm::vec2 position, glm::vec2 velocity, glm::vec2 offset)
 {
 	GLfloat random = ((rand() % 100) - 50) / 10.0f;
 	GLfloat rColor = 0.5 + ((rand() % 100) / 100.0f);
-	particle.Position = object.Position + random + offset;
+	particle.Position = position + random + offset;
 	particle.Color = glm::vec4(rColor, rColor, rColor, 1.0f);
 	particle.Life = 1.0f;
-	particle.Velocity = object.Velocity * 0.1f;
+	particle.Velocity = velocity * 0.1f;
 }
 
 void ParticleGenerator::init()
 {
-	GLuint VBO;
-	GLfloat particle_quad[] = {
-			0.0f, 1.0f, 0.0f, 1.0f,
-			1.0f, 0.0f, 1.0f, 0.0f,
-			0.0f, 0.0f, 0.0f, 0.0f,
-
-			0.0f, 1.0f, 0.0f, 1.0f,
-			1.0f, 1.0f, 1.0f, 1.0f,
-			1.0f, 0.0f, 1.0f, 0.0f
-	};
-
-	glGenVertexArrays(1, &this->VAO);
-	glGenBuffers(1, &VBO);
-	glBindVertexArray(this->VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
-	glBindVertexArray(0);
-
 	for (int i = 0; i < this->amount; ++i)
 	{
 		this->particles.push_back(Particle());
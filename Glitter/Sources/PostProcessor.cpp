@@ -18,86 +18,236 @@
 ******************************************************************/
 #include "PostProcessor.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
-PostProcessor::PostProcessor(Shader shader, GLuint width, GLuint height)
-	: PostProcessingShader(shader), Texture(), Width(width), Height(height), Confuse(GL_FALSE), Chaos(GL_FALSE), Shake(GL_FALSE)
+#include "GLState.hpp"
+#include "Profiler.hpp"
+
+std::string PostProcessor::VariantDefines(GLuint variant)
 {
-	glGenFramebuffers(1, &this->MSFBO);
-	glGenFramebuffers(1, &this->FBO);
-	glGenRenderbuffers(1, &this->RBO);
-
-	glBindFramebuffer(GL_FRAMEBUFFER, this->MSFBO);
-	glBindRenderbuffer(GL_RENDERBUFFER, this->RBO);
-	glRenderbufferStorageMultisample(GL_RENDERBUFFER, 4, GL_RGB, width, height);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->RBO);
-	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "ERROR:POSTPROCESSOR: Failed to initialize MSFBO" << std::endl;
-
-	glBindFramebuffer(GL_FRAMEBUFFER, this->FBO);
-	this->Texture.Generate(width, height, nullptr);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->Texture.ID, 0);
-	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-		std::cout << "ERROR:POSTPROCESSOR: Failed to initialize FBO" << std::endl;
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	std::string defines;
+	if (variant / 2 == 1)
+		defines += "#define CHAOS\n";
+	else if (variant / 2 == 2)
+		defines += "#define CONFUSE\n";
+	if (variant % 2 == 1)
+		defines += "#define SHAKE\n";
+	return defines;
+}
+
+PostProcessor::PostProcessor(const std::vector<Shader> &variants, GLuint width, GLuint height, GLuint samples, GLfloat renderScale)
+	: Variants(variants), Texture(), OutputX(0), OutputY(0), Width(width), Height(height), Confuse(GL_FALSE), Chaos(GL_FALSE), Shake(GL_FALSE),
+	  Samples(samples), RenderScale(renderScale), TargetGpuTime(0.0f), DynamicScale(1.0f), MinDynamicScale(0.5f),
+	  MSFBO(0), FBO(0), targetWidth(0), targetHeight(0), viewWidth(0), viewHeight(0), targetsDirty(GL_TRUE), dirtyFrames(0),
+	  queryFrame(0), framesSinceResize(0), timing(GL_FALSE), gpuTime(0.0f)
+{
+	glGenQueries(QUERY_COUNT, this->queries);
+	// Texture is only a view of the current target's texture
+	GLState::DeleteTexture(this->Texture.ID);
+	this->acquireTargets();
 
 	this->initRenderData();
-	this->PostProcessingShader.SetInteger("scene", 0, GL_TRUE);
-	GLfloat offset = 1.0f / 300.0f;
-	GLfloat offsets[9][2] = {
-			{-offset, offset},
-			{0, offset},
-			{offset, offset},
-			{-offset, 0},
-			{0, 0},
-			{offset, 0},
-			{-offset, -offset},
-			{0, -offset},
-			{offset, -offset}
-	};
-	glUniform2fv(glGetUniformLocation(this->PostProcessingShader.ID, "offsets"), 9, (GLfloat*)offsets);
-	GLint edge_kernel[9] = {
-			-1, -1, -1,
-			-1, 8, -1,
-			-1, -1, -1
-	};
-	glUniform1iv(glGetUniformLocation(this->PostProcessingShader.ID, "edge_kernel"), 9, edge_kernel);
-	GLfloat blur_kernel[9] = {
-			1.0/16, 2.0/16, 1.0/16,
-			2.0/16, 4.0/16, 2.0/16,
-			1.0/16, 2.0/16, 1.0/16
-	};
-	glUniform1fv(glGetUniformLocation(this->PostProcessingShader.ID, "blur_kernel"), 9, blur_kernel);
+	// Kernel offsets and weights are compiled into the variants, only the sampler needs setting up
+	for (Shader &shader : this->Variants)
+		shader.SetInteger("scene", 0, GL_TRUE);
+}
+
+PostProcessor::~PostProcessor()
+{
+	for (Target &target : this->pool)
+	{
+		GLState::DeleteFramebuffer(target.MSFBO);
+		GLState::DeleteFramebuffer(target.FBO);
+		glDeleteRenderbuffers(1, &target.RBO);
+		GLState::DeleteTexture(target.Texture.ID);
+	}
+	glDeleteQueries(QUERY_COUNT, this->queries);
+}
+
+void PostProcessor::SetSamples(GLuint samples)
+{
+	if (samples != this->Samples)
+	{
+		this->Samples = samples;
+		this->targetsDirty = GL_TRUE;
+		this->dirtyFrames = RESIZE_SETTLE_FRAMES;
+	}
+}
+
+void PostProcessor::SetRenderScale(GLfloat scale)
+{
+	if (scale != this->RenderScale)
+	{
+		this->RenderScale = scale;
+		this->targetsDirty = GL_TRUE;
+		this->dirtyFrames = RESIZE_SETTLE_FRAMES;
+	}
+}
+
+void PostProcessor::Resize(GLint x, GLint y, GLuint width, GLuint height)
+{
+	this->OutputX = x;
+	this->OutputY = y;
+	if (width != this->Width || height != this->Height)
+	{
+		this->Width = width;
+		this->Height = height;
+		this->targetsDirty = GL_TRUE;
+		this->dirtyFrames = 0;
+	}
+}
+
+void PostProcessor::acquireTargets()
+{
+	GLint maxSamples = 1;
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	this->Samples = glm::clamp(this->Samples, 1u, static_cast<GLuint>(maxSamples));
+	this->RenderScale = glm::clamp(this->RenderScale, 0.1f, 2.0f);
+	GLuint width = std::max(1u, static_cast<GLuint>(std::lround(this->Width * this->RenderScale)));
+	GLuint height = std::max(1u, static_cast<GLuint>(std::lround(this->Height * this->RenderScale)));
+	this->targetsDirty = GL_FALSE;
+
+	GLuint found = 0;
+	while (found < this->pool.size() && !(this->pool[found].Width == width && this->pool[found].Height == height && this->pool[found].Samples == this->Samples))
+		++found;
+	if (found < this->pool.size())
+	{
+		// Move the reused target to the back, the most recently used end
+		std::rotate(this->pool.begin() + found, this->pool.begin() + found + 1, this->pool.end());
+	}
+	else
+	{
+		if (this->pool.size() == POOL_SIZE)
+		{
+			Target &oldest = this->pool.front();
+			GLState::DeleteFramebuffer(oldest.MSFBO);
+			GLState::DeleteFramebuffer(oldest.FBO);
+			glDeleteRenderbuffers(1, &oldest.RBO);
+			GLState::DeleteTexture(oldest.Texture.ID);
+			this->pool.erase(this->pool.begin());
+		}
+		Target target;
+		target.Width = width;
+		target.Height = height;
+		target.Samples = this->Samples;
+		target.MSFBO = target.RBO = 0;
+		// Only the multisampled path needs a renderbuffer to resolve from
+		if (target.Samples > 1)
+		{
+			glGenFramebuffers(1, &target.MSFBO);
+			glGenRenderbuffers(1, &target.RBO);
+			GLState::BindFramebuffer(GL_FRAMEBUFFER, target.MSFBO);
+			glBindRenderbuffer(GL_RENDERBUFFER, target.RBO);
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, target.Samples, GL_RGB, width, height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target.RBO);
+			if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+				std::cout << "ERROR:POSTPROCESSOR: Failed to initialize MSFBO" << std::endl;
+		}
+
+		glGenFramebuffers(1, &target.FBO);
+		GLState::BindFramebuffer(GL_FRAMEBUFFER, target.FBO);
+		target.Texture.Generate(width, height, nullptr);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.Texture.ID, 0);
+		if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cout << "ERROR:POSTPROCESSOR: Failed to initialize FBO" << std::endl;
+		GLState::BindFramebuffer(GL_FRAMEBUFFER, GLState::OutputFramebuffer);
+		this->pool.push_back(target);
+	}
+
+	const Target &current = this->pool.back();
+	this->MSFBO = current.MSFBO;
+	this->FBO = current.FBO;
+	this->Texture = current.Texture;
+	this->targetWidth = current.Width;
+	this->targetHeight = current.Height;
 }
 
 void PostProcessor::BeginRender()
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, this->MSFBO);
+	// Sample count and scale changes apply right away, sizes only once the window stopped changing
+	if (this->targetsDirty && ++this->dirtyFrames >= RESIZE_SETTLE_FRAMES)
+		this->acquireTargets();
+
+	// Collect the oldest timer query before its object gets reused; if the GPU is still
+	// behind by QUERY_COUNT frames the sample is dropped rather than waited for
+	this->timing = this->TargetGpuTime > 0.0f || Profiler::Enabled;
+	GLuint query = this->queries[this->queryFrame % QUERY_COUNT];
+	if (this->timing && this->queryFrame >= QUERY_COUNT)
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+			this->adjustResolution(elapsed / 1.0e6f);
+		}
+	}
+	if (this->timing)
+		glBeginQuery(GL_TIME_ELAPSED, query);
+
+	this->viewWidth = std::max(1u, static_cast<GLuint>(std::lround(this->targetWidth * this->DynamicScale)));
+	this->viewHeight = std::max(1u, static_cast<GLuint>(std::lround(this->targetHeight * this->DynamicScale)));
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, this->Samples > 1 ? this->MSFBO : this->FBO);
+	glViewport(0, 0, this->viewWidth, this->viewHeight);
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 }
 
 void PostProcessor::EndRender()
 {
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, this->MSFBO);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->FBO);
-	glBlitFramebuffer(0, 0, this->Width, this->Height, 0, 0, this->Width, this->Height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (this->Samples > 1)
+	{
+		GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, this->MSFBO);
+		GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, this->FBO);
+		glBlitFramebuffer(0, 0, this->viewWidth, this->viewHeight, 0, 0, this->viewWidth, this->viewHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+	GLState::BindFramebuffer(GL_FRAMEBUFFER, GLState::OutputFramebuffer);
+	glViewport(this->OutputX, this->OutputY, this->Width, this->Height);
+}
+
+void PostProcessor::adjustResolution(GLfloat ms)
+{
+	Profiler::AddTime("gpu scene + post", ms);
+	this->gpuTime = this->gpuTime == 0.0f ? ms : this->gpuTime * 0.9f + ms * 0.1f;
+	if (this->TargetGpuTime <= 0.0f)
+		return;
+	// Give a change time to show up in the (late) measurements before judging it
+	if (++this->framesSinceResize < 2 * QUERY_COUNT)
+		return;
+	GLfloat scale = this->DynamicScale;
+	if (this->gpuTime > this->TargetGpuTime)
+		// Cost is about proportional to the pixel count, i.e. the square of the scale
+		scale *= std::max(0.85f, std::sqrt(this->TargetGpuTime / this->gpuTime));
+	else if (this->gpuTime < 0.75f * this->TargetGpuTime)
+		scale += 0.05f;
+	scale = glm::clamp(scale, this->MinDynamicScale, 1.0f);
+	if (std::abs(scale - this->DynamicScale) >= 0.01f)
+	{
+		this->DynamicScale = scale;
+		this->framesSinceResize = 0;
+	}
 }
 
-void PostProcessor::Render(GLfloat time)
+void PostProcessor::Render()
 {
-	this->PostProcessingShader.Use();
-	this->PostProcessingShader.SetFloat("time", time);
-	this->PostProcessingShader.SetInteger("confuse", this->Confuse);
-	this->PostProcessingShader.SetInteger("chaos", this->Chaos);
-	this->PostProcessingShader.SetInteger("shake", this->Shake);
+	// The animated variants read the time from the Frame block
+	Shader &shader = this->Variants[this->variant()];
+	shader.Use();
+	shader.SetVector2f("viewScale", static_cast<GLfloat>(this->viewWidth) / this->targetWidth, static_cast<GLfloat>(this->viewHeight) / this->targetHeight);
 
-	glActiveTexture(GL_TEXTURE0);
+	GLState::ActiveTexture(GL_TEXTURE0);
 	this->Texture.Bind();
-	glBindVertexArray(this->VAO);
+	GLState::BindVertexArray(this->VAO);
 	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glBindVertexArray(0);
+
+	if (this->timing)
+	{
+		glEndQuery(GL_TIME_ELAPSED);
+		++this->queryFrame;
+	}
 }
 
 //void PostProcessor::initRenderData()
@@ -128,6 +278,12 @@ void PostProcessor::Render(GLfloat time)
 //}
 
 
+GLuint PostProcessor::variant() const
+{
+	GLuint effect = this->Chaos ? 1 : (this->Confuse ? 2 : 0);
+	return effect * 2 + (this->Shake ? 1 : 0);
+}
+
 void PostProcessor::initRenderData()
 {
 	GLuint VBO;
@@ -162,12 +318,10 @@ void PostProcessor::initRenderData()
 	glGenVertexArrays(1, &this->VAO);
 	glGenBuffers(1, &VBO);
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-	glBindVertexArray(this->VAO);
+	GLState::BindVertexArray(this->VAO);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GL_FLOAT), (void*)0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
 }
@@ -3,3 +3,6 @@
 //
 
 #include "PowerUp.hpp"
+
+// Instantiate static variables
+const char *const PowerUp::TypeNames[PowerUp::TYPES] = { "speed", "sticky", "pass-through", "pad-size-increase", "confuse", "chaos" };
@@ -0,0 +1,100 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "Profiler.hpp"
+
+#include <cstdio>
+
+#include "GLState.hpp"
+
+typedef std::chrono::steady_clock Clock;
+
+// Instantiate static variables
+GLboolean Profiler::Enabled = GL_FALSE;
+GLdouble  Profiler::ReportInterval = 1.0;
+std::mutex Profiler::mutex;
+std::map<std::string, Profiler::Sample> Profiler::samples;
+Clock::time_point Profiler::frameStart;
+Clock::time_point Profiler::lastReport;
+GLuint   Profiler::frames = 0;
+GLdouble Profiler::frameTotal = 0.0;
+GLdouble Profiler::glIssued = 0.0;
+GLdouble Profiler::glSkipped = 0.0;
+
+
+void Profiler::BeginFrame()
+{
+	if (!Enabled)
+		return;
+	frameStart = Clock::now();
+	if (lastReport == Clock::time_point())
+		lastReport = frameStart;
+}
+
+void Profiler::EndFrame()
+{
+	if (!Enabled)
+		return;
+	Clock::time_point now = Clock::now();
+	frameTotal += std::chrono::duration<GLdouble, std::milli>(now - frameStart).count();
+	++frames;
+	glIssued += GLState::Issued;
+	glSkipped += GLState::Skipped;
+	GLState::ResetCounters();
+
+	GLdouble elapsed = std::chrono::duration<GLdouble>(now - lastReport).count();
+	if (elapsed >= ReportInterval)
+	{
+		report(elapsed);
+		lastReport = now;
+	}
+}
+
+void Profiler::AddTime(const std::string &name, GLdouble ms)
+{
+	if (!Enabled)
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	Sample &sample = samples[name];
+	sample.Total += ms;
+	sample.Count += 1;
+	if (ms > sample.Max)
+		sample.Max = ms;
+}
+
+Profiler::Scope::Scope(const char *name)
+	: name(name), start(Clock::now())
+{
+}
+
+Profiler::Scope::~Scope()
+{
+	Profiler::AddTime(this->name, std::chrono::duration<GLdouble, std::milli>(Clock::now() - this->start).count());
+}
+
+void Profiler::report(GLdouble seconds)
+{
+	GLdouble calls = glIssued + glSkipped;
+	printf("PROFILER: %.1f fps, frame %.2f ms | GL state calls %.0f/frame, %.0f skipped (%.1f%% redundant)\n",
+	       frames / seconds, frameTotal / frames,
+	       calls / frames, glSkipped / frames, calls > 0.0 ? 100.0 * glSkipped / calls : 0.0);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (auto &iter : samples)
+		{
+			const Sample &sample = iter.second;
+			if (sample.Count > 0)
+				printf("PROFILER:   %-24s avg %.3f ms, max %.3f ms (%u samples)\n",
+				       iter.first.c_str(), sample.Total / sample.Count, sample.Max, sample.Count);
+		}
+		samples.clear();
+	}
+	fflush(stdout);
+	frames = 0;
+	frameTotal = glIssued = glSkipped = 0.0;
+}
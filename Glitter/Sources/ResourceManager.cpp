@@ -12,17 +12,17 @@
 ** option) any later version.
 ******************************************************************/
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <set>
 #include <sstream>
-#include <fstream>
-#ifdef __APPLE__
-#include <mach-o/dyld.h> /* _NSGetExecutablePath */
-#else
-#ifdef _WIN32
-#include <windows.h>
-#else
-#endif
-#endif
+
+#include "AtlasPacker.hpp"
+#include "GLState.hpp"
+#include "ResourcePack.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -30,79 +30,296 @@
 // Instantiate static variables
 std::map<std::string, Texture2D>    ResourceManager::Textures;
 std::map<std::string, Shader>       ResourceManager::Shaders;
+GLboolean                           ResourceManager::CookTextures = GL_TRUE;
+GLboolean                           ResourceManager::Recook = GL_FALSE;
+GLdouble                            ResourceManager::TextureLoadTime = 0.0;
+size_t                              ResourceManager::TextureMemory = 0;
+std::map<std::string, ResourceManager::ShaderSource>  ResourceManager::shaderSources;
+std::map<std::string, ResourceManager::TextureSource> ResourceManager::textureSources;
+std::mutex                                            ResourceManager::mutex;
+
+namespace
+{
+	typedef std::chrono::steady_clock Clock;
+
+	GLdouble millisecondsSince(Clock::time_point start)
+	{
+		return std::chrono::duration<GLdouble, std::milli>(Clock::now() - start).count();
+	}
+}
 
 
-Shader ResourceManager::LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, std::string name)
+Shader ResourceManager::LoadShader(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, std::string name, const std::string &defines)
 {
-	Shaders[name] = loadShaderFromFile(vShaderFile, fShaderFile, gShaderFile);
+	Shaders[name] = loadShaderFromFile(vShaderFile, fShaderFile, gShaderFile, defines);
+	ShaderSource source = { vShaderFile, fShaderFile, gShaderFile != nullptr ? gShaderFile : "", defines };
+	shaderSources[name] = source;
 	return Shaders[name];
 }
 
 Shader ResourceManager::GetShader(std::string name)
 {
+	std::lock_guard<std::mutex> lock(mutex);
 	return Shaders[name];
 }
 
 Texture2D ResourceManager::LoadTexture(const GLchar *file, GLboolean alpha, std::string name)
 {
-	Textures[name] = loadTextureFromFile(file, alpha);
+	Clock::time_point start = Clock::now();
+	Texture2D texture;
+	size_t memory = TextureMemory;
+	loadTextureFromFile(file, alpha, texture);
+	Textures[name] = texture;
+	TextureSource source = { std::vector<std::string>(1, file), std::vector<std::string>(), alpha, TextureMemory - memory };
+	textureSources[name] = source;
+	TextureLoadTime += millisecondsSince(start);
 	return Textures[name];
 }
 
 Texture2D ResourceManager::GetTexture(std::string name)
 {
+	std::lock_guard<std::mutex> lock(mutex);
 	return Textures[name];
 }
 
+Texture2D ResourceManager::LoadAtlas(const std::vector<std::string> &files, const std::vector<std::string> &names, std::string name)
+{
+	Clock::time_point start = Clock::now();
+	Texture2D atlas;
+	atlas.Wrap_S = GL_CLAMP_TO_EDGE;
+	atlas.Wrap_T = GL_CLAMP_TO_EDGE;
+	size_t memory = TextureMemory;
+	buildAtlas(files, names, name, atlas);
+	TextureSource source = { files, names, GL_TRUE, TextureMemory - memory };
+	textureSources[name] = source;
+	TextureLoadTime += millisecondsSince(start);
+	return atlas;
+}
+
+GLboolean ResourceManager::Reload(const std::string &file)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	GLboolean used = GL_FALSE;
+	for (auto &iter : shaderSources)
+	{
+		const ShaderSource &source = iter.second;
+		if (file != source.Vertex && file != source.Fragment && file != source.Geometry)
+			continue;
+		used = GL_TRUE;
+		std::string vertexCode, fragmentCode, geometryCode;
+		GLboolean geometry = !source.Geometry.empty();
+		if (!readShaderFile(source.Vertex.c_str(), source.Defines, vertexCode) ||
+		    !readShaderFile(source.Fragment.c_str(), source.Defines, fragmentCode) ||
+		    (geometry && !readShaderFile(source.Geometry.c_str(), source.Defines, geometryCode)) ||
+		    !Shaders[iter.first].Relink(vertexCode.c_str(), fragmentCode.c_str(), geometry ? geometryCode.c_str() : nullptr))
+			std::cout << "ERROR::SHADER: Keeping the previous version of " << iter.first << std::endl;
+		else
+			std::cout << "Reloaded shader " << iter.first << std::endl;
+	}
+	for (auto &iter : textureSources)
+	{
+		TextureSource &source = iter.second;
+		if (std::find(source.Files.begin(), source.Files.end(), file) == source.Files.end())
+			continue;
+		used = GL_TRUE;
+		size_t memory = TextureMemory;
+		GLboolean reloaded = source.Names.empty() ? loadTextureFromFile(file.c_str(), source.Alpha, Textures[iter.first])
+		                                          : buildAtlas(source.Files, source.Names, iter.first, Textures[iter.first]);
+		if (reloaded)
+		{
+			// The new version takes the old one's place in the same texture object
+			size_t added = TextureMemory - memory;
+			TextureMemory -= source.Memory;
+			source.Memory = added;
+			std::cout << "Reloaded texture " << iter.first << std::endl;
+		}
+		else
+			std::cout << "ERROR::TEXTURE: Keeping the previous version of " << iter.first << std::endl;
+	}
+	return used;
+}
+
+GLboolean ResourceManager::buildAtlas(const std::vector<std::string> &files, const std::vector<std::string> &names, const std::string &name, Texture2D &atlas)
+{
+	// The cooked atlas also records where each sprite went
+	std::string cookedPath = files.empty() ? name + ".ktx" : files[0].substr(0, files[0].find_last_of('/') + 1) + name + ".ktx";
+	std::vector<std::string> sources(files);
+	sources.insert(sources.end(), names.begin(), names.end());
+	std::string stamp = sourceStamp(sources);
+	CookedTexture cooked;
+	if (CookTextures && !Recook && loadCooked(cookedPath, stamp, cooked))
+	{
+		std::vector<glm::ivec4> rects(names.size());
+		GLboolean complete = GL_TRUE;
+		for (GLuint i = 0; i < names.size() && complete; ++i)
+		{
+			std::istringstream rect(cooked.Metadata["Breakout.sprite." + names[i]]);
+			complete = (rect >> rects[i].x >> rects[i].y >> rects[i].z >> rects[i].w) ? GL_TRUE : GL_FALSE;
+			// When reloading, a cooked layout other than the current one would move sprites under the live objects
+			if (complete && atlas.Width > 0)
+			{
+				glm::ivec4 current = spriteRect(atlas, Textures[names[i]]);
+				complete = rects[i].x == current.x && rects[i].y == current.y && rects[i].z == current.z && rects[i].w == current.w;
+			}
+		}
+		if (complete)
+		{
+			atlas.Generate(cooked);
+			Textures[name] = atlas;
+			for (GLuint i = 0; i < names.size(); ++i)
+			{
+				Texture2D sprite = atlas;
+				sprite.Width = rects[i].z;
+				sprite.Height = rects[i].w;
+				sprite.UV = glm::vec4(rects[i].x, rects[i].y, rects[i].z, rects[i].w) / glm::vec4(cooked.Width, cooked.Height, cooked.Width, cooked.Height);
+				Textures[names[i]] = sprite;
+			}
+			TextureMemory += TextureCooker::MemorySize(cooked);
+			return GL_TRUE;
+		}
+	}
+
+	// Load every image as RGBA, images without alpha come out opaque
+	std::vector<unsigned char*> images(files.size());
+	std::vector<glm::ivec2> sizes(files.size());
+	for (GLuint i = 0; i < files.size(); ++i)
+	{
+		int width = 0, height = 0, channel;
+		ResourceData data;
+		images[i] = ResourcePack::Read(files[i], data) ? stbi_load_from_memory(data.Data, static_cast<int>(data.Size), &width, &height, &channel, 4) : nullptr;
+		if (images[i] == nullptr)
+			std::cout << "ERROR::ATLAS: Failed to load " << files[i] << std::endl;
+		sizes[i] = glm::ivec2(width, height);
+	}
+	// When reloading, a sprite that can't be read (e.g. a half-written file) would blank out; keep the old atlas
+	if (atlas.Width > 0 && std::find(images.begin(), images.end(), nullptr) != images.end())
+	{
+		for (unsigned char *image : images)
+			stbi_image_free(image);
+		return GL_FALSE;
+	}
+
+	// The padding has to cover the filter footprint on every mip level: with 16 pixels, mip level 4 still has 1
+	AtlasPacker packer(16);
+	GLuint levels = 1;
+	for (GLuint padding = packer.Padding; padding > 1; padding /= 2)
+		++levels;
+	GLint maxSize = 2048;
+	if (!Texture2D::Headless)
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	glm::ivec2 atlasSize;
+	std::vector<glm::ivec2> positions;
+	atlas.Internal_Format = GL_RGBA;
+	atlas.Image_Format = GL_RGBA;
+	if (atlas.Width > 0)
+	{
+		// Objects hold copies of their sprites (and LevelCache their UV rects), so a reload keeps every sprite where it is
+		// and only replaces the atlas' contents. An image whose size changed doesn't fit its old place
+		atlasSize = glm::ivec2(atlas.Width, atlas.Height);
+		positions.resize(files.size());
+		for (GLuint i = 0; i < names.size() && i < files.size(); ++i)
+		{
+			glm::ivec4 rect = spriteRect(atlas, Textures[names[i]]);
+			if (rect.z != sizes[i].x || rect.w != sizes[i].y)
+			{
+				std::cout << "ERROR::ATLAS: " << files[i] << " changed size from " << rect.z << "x" << rect.w << " to " << sizes[i].x << "x"
+				          << sizes[i].y << ", which needs a restart to repack the atlas" << std::endl;
+				for (unsigned char *image : images)
+					stbi_image_free(image);
+				return GL_FALSE;
+			}
+			positions[i] = glm::ivec2(rect.x, rect.y);
+		}
+	}
+	else if (!packer.Pack(sizes, maxSize, atlasSize, positions))
+	{
+		std::cout << "ERROR::ATLAS: Images do not fit into a " << maxSize << "x" << maxSize << " atlas" << std::endl;
+		for (unsigned char *image : images)
+			stbi_image_free(image);
+		return GL_FALSE;
+	}
+
+	// Copy each image to its place and extrude its edge pixels into the padding around it
+	std::vector<unsigned char> pixels(atlasSize.x * atlasSize.y * 4, 0);
+	GLint padding = static_cast<GLint>(packer.Padding);
+	for (GLuint i = 0; i < images.size(); ++i)
+	{
+		if (images[i] == nullptr)
+			continue;
+		for (GLint y = -padding; y < sizes[i].y + padding; ++y)
+		{
+			GLint sourceY = glm::clamp(y, 0, sizes[i].y - 1);
+			for (GLint x = -padding; x < sizes[i].x + padding; ++x)
+			{
+				GLint sourceX = glm::clamp(x, 0, sizes[i].x - 1);
+				const unsigned char *source = images[i] + (sourceY * sizes[i].x + sourceX) * 4;
+				std::memcpy(&pixels[((positions[i].y + y) * atlasSize.x + positions[i].x + x) * 4], source, 4);
+			}
+		}
+		stbi_image_free(images[i]);
+	}
+	if (CookTextures)
+	{
+		TextureCooker::Cook(pixels.data(), atlasSize.x, atlasSize.y, GL_TRUE, levels, cooked);
+		cooked.Metadata["Breakout.source"] = stamp;
+		for (GLuint i = 0; i < names.size() && i < files.size(); ++i)
+		{
+			std::ostringstream rect;
+			rect << positions[i].x << " " << positions[i].y << " " << sizes[i].x << " " << sizes[i].y;
+			cooked.Metadata["Breakout.sprite." + names[i]] = rect.str();
+		}
+		TextureCooker::Save(cookedPath, cooked);
+		atlas.Generate(cooked);
+		TextureMemory += TextureCooker::MemorySize(cooked);
+	}
+	else
+	{
+		atlas.Generate(atlasSize.x, atlasSize.y, pixels.data());
+		TextureMemory += pixels.size();
+	}
+	Textures[name] = atlas;
+
+	for (GLuint i = 0; i < names.size() && i < files.size(); ++i)
+	{
+		Texture2D sprite = atlas;
+		sprite.Width = sizes[i].x;
+		sprite.Height = sizes[i].y;
+		sprite.UV = glm::vec4(glm::vec2(positions[i]) / glm::vec2(atlasSize), glm::vec2(sizes[i]) / glm::vec2(atlasSize));
+		Textures[names[i]] = sprite;
+	}
+	return GL_TRUE;
+}
+
+glm::ivec4 ResourceManager::spriteRect(const Texture2D &atlas, const Texture2D &sprite)
+{
+	return glm::ivec4(static_cast<GLint>(std::lround(sprite.UV.x * atlas.Width)), static_cast<GLint>(std::lround(sprite.UV.y * atlas.Height)),
+	                  static_cast<GLint>(sprite.Width), static_cast<GLint>(sprite.Height));
+}
+
 void ResourceManager::Clear()
 {
 	// (Properly) delete all shaders
 	for (auto iter : Shaders)
-		glDeleteProgram(iter.second.ID);
-	// (Properly) delete all textures
+		GLState::DeleteProgram(iter.second.ID);
+	// (Properly) delete all textures; atlas sprites share their atlas' texture object. Headless ones have nothing to delete
+	if (Texture2D::Headless)
+		return;
+	std::set<GLuint> textures;
 	for (auto iter : Textures)
-		glDeleteTextures(1, &iter.second.ID);
+		textures.insert(iter.second.ID);
+	for (GLuint texture : textures)
+		GLState::DeleteTexture(texture);
 }
 
-Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile)
+Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLchar *fShaderFile, const GLchar *gShaderFile, const std::string &defines)
 {
 	// 1. Retrieve the vertex/fragment source code from filePath
 	std::string vertexCode;
 	std::string fragmentCode;
 	std::string geometryCode;
-	try
-	{
-		// Open files
-		std::ifstream vertexShaderFile(vShaderFile);
-		if(!vertexShaderFile.good())
-		{
-			std::cout <<"file not exist" << std::endl;
-		}
-		std::ifstream fragmentShaderFile(fShaderFile);
-		std::stringstream vShaderStream, fShaderStream;
-		// Read file's buffer contents into streams
-		vShaderStream << vertexShaderFile.rdbuf();
-		fShaderStream << fragmentShaderFile.rdbuf();
-		// close file handlers
-		vertexShaderFile.close();
-		fragmentShaderFile.close();
-		// Convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
-		// If geometry shader path is present, also load a geometry shader
-		if (gShaderFile != nullptr)
-		{
-			std::ifstream geometryShaderFile(gShaderFile);
-			std::stringstream gShaderStream;
-			gShaderStream << geometryShaderFile.rdbuf();
-			geometryShaderFile.close();
-			geometryCode = gShaderStream.str();
-		}
-	}
-	catch (std::exception e)
-	{
+	if (!readShaderFile(vShaderFile, defines, vertexCode) || !readShaderFile(fShaderFile, defines, fragmentCode) ||
+	    (gShaderFile != nullptr && !readShaderFile(gShaderFile, defines, geometryCode)))
 		std::cout << "ERROR::SHADER: Failed to read shader files" << std::endl;
-	}
 	const GLchar *vShaderCode = vertexCode.c_str();
 	const GLchar *fShaderCode = fragmentCode.c_str();
 	const GLchar *gShaderCode = geometryCode.c_str();
@@ -112,36 +329,102 @@ Shader ResourceManager::loadShaderFromFile(const GLchar *vShaderFile, const GLch
 	return shader;
 }
 
-Texture2D ResourceManager::loadTextureFromFile(const GLchar *file, GLboolean alpha)
+GLboolean ResourceManager::readShaderFile(const GLchar *file, const std::string &defines, std::string &code)
 {
-	// Create Texture object
-	Texture2D texture;
+	ResourceData data;
+	if (!ResourcePack::Read(file, data))
+		return GL_FALSE;
+	code.assign(reinterpret_cast<const char*>(data.Data), data.Size);
+	if (!defines.empty())
+		code = injectDefines(code, defines);
+	return GL_TRUE;
+}
+
+std::string ResourceManager::injectDefines(const std::string &source, const std::string &defines)
+{
+	// #version has to stay the first statement, so the defines go on the line after it
+	std::string::size_type version = source.find("#version");
+	if (version == std::string::npos)
+		return defines + source;
+	std::string::size_type lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return source + "\n" + defines;
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
+
+std::string ResourceManager::sourceStamp(const std::vector<std::string> &files)
+{
+	std::ostringstream stamp;
+	for (const std::string &file : files)
+	{
+		// Content based, so a pack holding sources and cooked files together stays consistent
+		unsigned long long size, hash;
+		if (ResourcePack::Fingerprint(file, size, hash))
+			stamp << file << ":" << size << ":" << std::hex << hash << std::dec << ";";
+		else
+			stamp << file << ";";
+	}
+	return stamp.str();
+}
+
+GLboolean ResourceManager::loadCooked(const std::string &path, const std::string &stamp, CookedTexture &cooked)
+{
+	// A file cooked on a machine with different compression support has to be cooked again
+	return TextureCooker::Load(path, cooked) && cooked.Metadata["Breakout.source"] == stamp && TextureCooker::Supported(cooked.InternalFormat);
+}
+
+GLboolean ResourceManager::loadTextureFromFile(const GLchar *file, GLboolean alpha, Texture2D &texture)
+{
+	if (CookTextures)
+	{
+		std::string cookedPath = std::string(file) + ".ktx";
+		std::string stamp = sourceStamp(std::vector<std::string>(1, file));
+		CookedTexture cooked;
+		if (Recook || !loadCooked(cookedPath, stamp, cooked))
+		{
+			int width = 0, height = 0, channel;
+			ResourceData data;
+			unsigned char* image = ResourcePack::Read(file, data) ? stbi_load_from_memory(data.Data, static_cast<int>(data.Size), &width, &height, &channel, 4) : nullptr;
+			if (image == nullptr)
+			{
+				std::cout << "ERROR::TEXTURE: Failed to load " << file << std::endl;
+				return GL_FALSE;
+			}
+			TextureCooker::Cook(image, width, height, alpha, 0, cooked);
+			stbi_image_free(image);
+			cooked.Metadata["Breakout.source"] = stamp;
+			TextureCooker::Save(cookedPath, cooked);
+		}
+		texture.Generate(cooked);
+		TextureMemory += TextureCooker::MemorySize(cooked);
+		return GL_TRUE;
+	}
+
 	if (alpha)
 	{
 		texture.Internal_Format = GL_RGBA;
 		texture.Image_Format = GL_RGBA;
 	}
 
-	std::ifstream file_fs(file);
-	if(!file_fs.good())
+	ResourceData data;
+	if (!ResourcePack::Read(file, data))
 	{
-		std::cout <<"file not exist:" << file << std::endl;
-//		namespace fs = std::filesystem;
-//		std::cout << "Current path is " << fs::current_path() << '\n';
-		char path[1024];
-		uint32_t size = sizeof(path);
-		if (_NSGetExecutablePath(path, &size) == 0)
-			printf("executable path is %s\n", path);
-		else
-			printf("buffer too small; need size %u\n", size);
+		std::cout << "ERROR::TEXTURE: Failed to read " << file << std::endl;
+		return GL_FALSE;
 	}
 	// Load image
 	int width, height, channel;
 //	unsigned char* image = SOIL_load_image(file, &width, &height, 0, texture.Image_Format == GL_RGBA ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB);
-	unsigned char* image = stbi_load(file, &width, &height, &channel, 0);
+	unsigned char* image = stbi_load_from_memory(data.Data, static_cast<int>(data.Size), &width, &height, &channel, 0);
+	if (image == nullptr)
+	{
+		std::cout << "ERROR::TEXTURE: Failed to load " << file << std::endl;
+		return GL_FALSE;
+	}
 	// Now generate texture
 	texture.Generate(width, height, image);
+	TextureMemory += width * height * channel;
 	// And finally free image data
 	stbi_image_free(image);
-	return texture;
+	return GL_TRUE;
 }
@@ -0,0 +1,264 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "ResourcePack.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char   PACK_MAGIC[4] = { 'B', 'K', 'P', 'K' };
+	const GLuint PACK_VERSION = 1;
+	// File data starts on multiples of this, so e.g. KTX levels stay aligned
+	const size_t PACK_ALIGNMENT = 16;
+}
+
+// Instantiate static variables
+const unsigned char *ResourcePack::mapping = nullptr;
+size_t               ResourcePack::mappingSize = 0;
+#ifdef _WIN32
+void                *ResourcePack::fileHandle = nullptr;
+void                *ResourcePack::mappingHandle = nullptr;
+#endif
+
+unsigned long long ResourcePack::Hash(const unsigned char *data, size_t size)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+GLboolean ResourcePack::Open(const std::string &path)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return GL_FALSE;
+	LARGE_INTEGER size;
+	HANDLE map = GetFileSizeEx(file, &size) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	const void *view = map ? MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (view == nullptr)
+	{
+		if (map)
+			CloseHandle(map);
+		CloseHandle(file);
+		return GL_FALSE;
+	}
+	fileHandle = file;
+	mappingHandle = map;
+	mapping = static_cast<const unsigned char*>(view);
+	mappingSize = static_cast<size_t>(size.QuadPart);
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return GL_FALSE;
+	struct stat info;
+	void *view = fstat(file, &info) == 0 && info.st_size > 0 ? mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	// The mapping keeps the file alive
+	close(file);
+	if (view == MAP_FAILED)
+		return GL_FALSE;
+	mapping = static_cast<const unsigned char*>(view);
+	mappingSize = static_cast<size_t>(info.st_size);
+#endif
+
+	// Validate the header and table bounds once, so lookups can trust them
+	Header header;
+	GLboolean valid = mappingSize >= sizeof(header);
+	if (valid)
+	{
+		std::memcpy(&header, mapping, sizeof(header));
+		valid = std::memcmp(header.Magic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0 && header.Version == PACK_VERSION &&
+		        header.TableSize > 0 && (header.TableSize & (header.TableSize - 1)) == 0 &&
+		        header.TableOffset % alignof(Entry) == 0 &&
+		        header.TableOffset + header.TableSize * sizeof(Entry) <= mappingSize && header.NamesOffset <= mappingSize;
+	}
+	if (!valid)
+	{
+		std::cout << "ERROR::RESOURCEPACK: " << path << " is not a resource pack" << std::endl;
+		Close();
+		return GL_FALSE;
+	}
+	return GL_TRUE;
+}
+
+void ResourcePack::Close()
+{
+	if (mapping == nullptr)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(mapping);
+	CloseHandle(static_cast<HANDLE>(mappingHandle));
+	CloseHandle(static_cast<HANDLE>(fileHandle));
+#else
+	munmap(const_cast<unsigned char*>(mapping), mappingSize);
+#endif
+	mapping = nullptr;
+	mappingSize = 0;
+}
+
+GLboolean ResourcePack::IsOpen()
+{
+	return mapping != nullptr;
+}
+
+const ResourcePack::Entry *ResourcePack::find(const std::string &name)
+{
+	if (mapping == nullptr)
+		return nullptr;
+	Header header;
+	std::memcpy(&header, mapping, sizeof(header));
+	const Entry *table = reinterpret_cast<const Entry*>(mapping + header.TableOffset);
+	unsigned long long hash = Hash(reinterpret_cast<const unsigned char*>(name.data()), name.size());
+	if (hash == 0)
+		hash = 1;
+	// Linear probing; the builder keeps the table at most half full, so an empty slot always ends the search
+	for (GLuint probe = 0; probe < header.TableSize; ++probe)
+	{
+		const Entry &entry = table[(hash + probe) & (header.TableSize - 1)];
+		if (entry.NameHash == 0)
+			return nullptr;
+		if (entry.NameHash == hash && entry.NameLength == name.size() &&
+		    header.NamesOffset + entry.NameOffset + entry.NameLength <= mappingSize &&
+		    std::memcmp(mapping + header.NamesOffset + entry.NameOffset, name.data(), name.size()) == 0)
+			return entry.Offset + entry.Size <= mappingSize ? &entry : nullptr;
+	}
+	return nullptr;
+}
+
+GLboolean ResourcePack::Read(const std::string &name, ResourceData &data)
+{
+	const Entry *entry = find(name);
+	if (entry != nullptr)
+	{
+		data.Storage.clear();
+		data.Data = mapping + entry->Offset;
+		data.Size = static_cast<size_t>(entry->Size);
+		return GL_TRUE;
+	}
+	if (!readFile(name, data.Storage))
+	{
+		data.Data = nullptr;
+		data.Size = 0;
+		return GL_FALSE;
+	}
+	data.Data = data.Storage.data();
+	data.Size = data.Storage.size();
+	return GL_TRUE;
+}
+
+GLboolean ResourcePack::Fingerprint(const std::string &name, unsigned long long &size, unsigned long long &hash)
+{
+	const Entry *entry = find(name);
+	if (entry != nullptr)
+	{
+		size = entry->Size;
+		hash = entry->ContentHash;
+		return GL_TRUE;
+	}
+	std::vector<unsigned char> contents;
+	if (!readFile(name, contents))
+		return GL_FALSE;
+	size = contents.size();
+	hash = Hash(contents.data(), contents.size());
+	return GL_TRUE;
+}
+
+GLboolean ResourcePack::readFile(const std::string &name, std::vector<unsigned char> &contents)
+{
+	std::ifstream file(name, std::ios::binary);
+	if (!file.good())
+		return GL_FALSE;
+	contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return GL_TRUE;
+}
+
+GLboolean ResourcePack::Build(const std::string &path, const std::vector<std::string> &files)
+{
+	Header header;
+	std::memcpy(header.Magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+	header.Version = PACK_VERSION;
+	header.EntryCount = static_cast<GLuint>(files.size());
+	// At most half full keeps probe sequences short
+	header.TableSize = 1;
+	while (header.TableSize < 2 * files.size())
+		header.TableSize *= 2;
+	std::vector<Entry> table(header.TableSize);
+	std::memset(table.data(), 0, table.size() * sizeof(Entry));
+
+	std::string names;
+	for (const std::string &file : files)
+		names += file;
+	header.TableOffset = sizeof(Header);
+	header.NamesOffset = header.TableOffset + table.size() * sizeof(Entry);
+	unsigned long long offset = header.NamesOffset + names.size();
+
+	std::vector<std::vector<unsigned char>> contents(files.size());
+	GLuint nameOffset = 0;
+	for (GLuint i = 0; i < files.size(); ++i)
+	{
+		if (!readFile(files[i], contents[i]))
+		{
+			std::cout << "ERROR::RESOURCEPACK: Failed to read " << files[i] << std::endl;
+			return GL_FALSE;
+		}
+		unsigned long long hash = Hash(reinterpret_cast<const unsigned char*>(files[i].data()), files[i].size());
+		if (hash == 0)
+			hash = 1;
+		GLuint slot = static_cast<GLuint>(hash & (header.TableSize - 1));
+		while (table[slot].NameHash != 0)
+			slot = (slot + 1) & (header.TableSize - 1);
+		offset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+		Entry &entry = table[slot];
+		entry.NameHash = hash;
+		entry.ContentHash = Hash(contents[i].data(), contents[i].size());
+		entry.Offset = offset;
+		entry.Size = contents[i].size();
+		entry.NameOffset = nameOffset;
+		entry.NameLength = static_cast<GLuint>(files[i].size());
+		nameOffset += entry.NameLength;
+		offset += entry.Size;
+	}
+
+	std::ofstream pack(path, std::ios::binary | std::ios::trunc);
+	if (!pack.good())
+	{
+		std::cout << "ERROR::RESOURCEPACK: Failed to write " << path << std::endl;
+		return GL_FALSE;
+	}
+	pack.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	pack.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(Entry));
+	pack.write(names.data(), names.size());
+	// Files go in the order they were listed, which is also the order of their offsets
+	const char zeros[PACK_ALIGNMENT] = { 0 };
+	offset = header.NamesOffset + names.size();
+	for (const std::vector<unsigned char> &content : contents)
+	{
+		unsigned long long aligned = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+		pack.write(zeros, aligned - offset);
+		pack.write(reinterpret_cast<const char*>(content.data()), content.size());
+		offset = aligned + content.size();
+	}
+	return pack.good() ? GL_TRUE : GL_FALSE;
+}
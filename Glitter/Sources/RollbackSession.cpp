@@ -0,0 +1,126 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "RollbackSession.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "Profiler.hpp"
+#include "StateHash.hpp"
+
+
+RollbackSession::RollbackSession(Game &game, UdpTransport &transport, GLuint player, GLfloat tick, GLuint maxRollback)
+	: Rollbacks(0), Replayed(0), Stalls(0), RollbackTime(0.0), MaxRollbackTime(0.0), DesyncTick(NONE),
+	  game(game), transport(transport), player(player), maxRollback(std::max(1u, std::min(maxRollback, MAX_ROLLBACK))), tickTime(tick),
+	  tick(0), remoteTick(0), peerAck(0), frames(MAX_ROLLBACK), localInputs(HISTORY), remoteInputs(HISTORY), hashes(HISTORY)
+{
+	TickHash none = { NONE, 0 };
+	std::fill(this->hashes.begin(), this->hashes.end(), none);
+}
+
+void RollbackSession::Poll()
+{
+	Packet packet;
+	GLuint mispredicted = NONE;
+	TickHash peerHash = { NONE, 0 };
+	while (this->transport.Receive(&packet, sizeof(packet)) == sizeof(packet))
+	{
+		if (packet.Magic != MAGIC || packet.Count > MAX_INPUTS || packet.Ack > this->tick)
+			continue;
+		this->peerAck = std::max(this->peerAck, packet.Ack);
+		// Packets that arrive late or out of order only add what follows the inputs already received
+		while (this->remoteTick >= packet.Start && this->remoteTick < packet.Start + packet.Count)
+		{
+			GLuint t = this->remoteTick++;
+			GLubyte input = packet.Inputs[t - packet.Start];
+			this->remoteInputs[t % HISTORY] = input;
+			if (t < this->tick && input != this->frames[t % MAX_ROLLBACK].Inputs[1 - this->player])
+				mispredicted = std::min(mispredicted, t);
+		}
+		if (packet.HashTick != NONE && (peerHash.Tick == NONE || packet.HashTick > peerHash.Tick))
+		{
+			peerHash.Tick = packet.HashTick;
+			peerHash.Hash = packet.Hash;
+		}
+	}
+	if (mispredicted != NONE)
+		this->rollback(mispredicted);
+	// Hashes can only be compared once the ticks both sides have all inputs of are simulated with them
+	const TickHash &own = this->hashes[peerHash.Tick % HISTORY];
+	if (peerHash.Tick != NONE && peerHash.Tick < this->Confirmed() && own.Tick == peerHash.Tick && own.Hash != peerHash.Hash &&
+	    this->DesyncTick == NONE)
+	{
+		this->DesyncTick = peerHash.Tick;
+		std::cout << "ERROR::ROLLBACK: State differs from the peer's after tick " << peerHash.Tick << std::endl;
+	}
+}
+
+GLboolean RollbackSession::Advance(GLubyte input)
+{
+	// A misprediction further back could not be undone
+	if (this->tick >= this->remoteTick + this->maxRollback)
+	{
+		++this->Stalls;
+		this->send();
+		return GL_FALSE;
+	}
+	this->localInputs[this->tick % HISTORY] = input;
+	this->simulate(this->tick++);
+	this->send();
+	return GL_TRUE;
+}
+
+void RollbackSession::simulate(GLuint t)
+{
+	Frame &frame = this->frames[t % MAX_ROLLBACK];
+	this->game.Save(frame.State);
+	frame.Inputs[this->player] = this->localInputs[t % HISTORY];
+	// The peer's input is predicted to stay what it was last (players hold keys for many ticks)
+	if (t < this->remoteTick)
+		frame.Inputs[1 - this->player] = this->remoteInputs[t % HISTORY];
+	else
+		frame.Inputs[1 - this->player] = this->remoteTick > 0 ? this->remoteInputs[(this->remoteTick - 1) % HISTORY] : 0;
+	this->game.Step(frame.Inputs, this->tickTime);
+	StateHash hash;
+	this->game.Hash(hash);
+	TickHash tickHash = { t, hash.Total() };
+	this->hashes[t % HISTORY] = tickHash;
+}
+
+void RollbackSession::rollback(GLuint t)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	this->game.Restore(this->frames[t % MAX_ROLLBACK].State);
+	this->game.Replaying = GL_TRUE;
+	for (GLuint replay = t; replay < this->tick; ++replay)
+		this->simulate(replay);
+	this->game.Replaying = GL_FALSE;
+	GLdouble ms = std::chrono::duration<GLdouble, std::milli>(std::chrono::steady_clock::now() - start).count();
+	++this->Rollbacks;
+	this->Replayed += this->tick - t;
+	this->RollbackTime += ms;
+	this->MaxRollbackTime = std::max(this->MaxRollbackTime, ms);
+	Profiler::AddTime("rollback", ms);
+}
+
+void RollbackSession::send()
+{
+	Packet packet = Packet();
+	packet.Magic = MAGIC;
+	packet.Start = this->peerAck;
+	packet.Count = std::min(this->tick - this->peerAck, MAX_INPUTS);
+	for (GLuint i = 0; i < packet.Count; ++i)
+		packet.Inputs[i] = this->localInputs[(packet.Start + i) % HISTORY];
+	packet.Ack = this->remoteTick;
+	GLuint confirmed = this->Confirmed();
+	packet.HashTick = confirmed > 0 ? confirmed - 1 : NONE;
+	packet.Hash = confirmed > 0 ? this->hashes[(confirmed - 1) % HISTORY].Hash : 0;
+	this->transport.Send(&packet, sizeof(packet));
+}
@@ -10,9 +10,12 @@
 
 #include <iostream>
 
+#include "FrameUniforms.hpp"
+#include "GLState.hpp"
+
 Shader &Shader::Use()
 {
-    glUseProgram(this->ID);
+    GLState::UseProgram(this->ID);
     return *this;
 }
 
@@ -45,6 +48,7 @@ void Shader::Compile(const GLchar* vertexSource, const GLchar* fragmentSource, c
         glAttachShader(this->ID, gShader);
     glLinkProgram(this->ID);
     checkCompileErrors(this->ID, "PROGRAM");
+    FrameUniforms::Attach(this->ID);
     // Delete the shaders as they're linked into our program now and no longer necessery
     glDeleteShader(sVertex);
     glDeleteShader(sFragment);
@@ -52,6 +56,107 @@ void Shader::Compile(const GLchar* vertexSource, const GLchar* fragmentSource, c
         glDeleteShader(gShader);
 }
 
+GLboolean Shader::Relink(const GLchar *vertexSource, const GLchar *fragmentSource, const GLchar *geometrySource)
+{
+    // Build the new sources into a scratch program first, so errors leave this one untouched
+    Shader scratch;
+    scratch.Compile(vertexSource, fragmentSource, geometrySource);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(scratch.ID, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE)
+    {
+        GLState::DeleteProgram(scratch.ID);
+        return GL_FALSE;
+    }
+    // Relinking resets all uniforms to their defaults
+    std::vector<UniformValue> values = this->saveUniforms();
+    // Swap the stages: the old ones are freed once detached, the new ones once the scratch program is deleted
+    GLuint stages[3];
+    GLsizei count = 0;
+    glGetAttachedShaders(this->ID, 3, &count, stages);
+    for (GLsizei i = 0; i < count; ++i)
+        glDetachShader(this->ID, stages[i]);
+    glGetAttachedShaders(scratch.ID, 3, &count, stages);
+    for (GLsizei i = 0; i < count; ++i)
+        glAttachShader(this->ID, stages[i]);
+    glLinkProgram(this->ID);
+    checkCompileErrors(this->ID, "PROGRAM");
+    FrameUniforms::Attach(this->ID);
+    for (GLsizei i = 0; i < count; ++i)
+        glDetachShader(this->ID, stages[i]);
+    GLState::DeleteProgram(scratch.ID);
+    this->restoreUniforms(values);
+    return GL_TRUE;
+}
+
+std::vector<Shader::UniformValue> Shader::saveUniforms()
+{
+    std::vector<UniformValue> values;
+    GLint uniforms = 0;
+    glGetProgramiv(this->ID, GL_ACTIVE_UNIFORMS, &uniforms);
+    for (GLint i = 0; i < uniforms; ++i)
+    {
+        GLchar name[256];
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = GL_NONE;
+        glGetActiveUniform(this->ID, i, sizeof(name), &length, &size, &type, name);
+        // Arrays are reported once as "name[0]", their elements are read one by one
+        std::string base(name, length);
+        if (size > 1 && base.size() > 3 && base.compare(base.size() - 3, 3, "[0]") == 0)
+            base.erase(base.size() - 3);
+        for (GLint element = 0; element < size; ++element)
+        {
+            UniformValue value;
+            value.Name = size > 1 ? base + "[" + std::to_string(element) + "]" : base;
+            value.Type = type;
+            GLint location = glGetUniformLocation(this->ID, value.Name.c_str());
+            // Uniforms in blocks have no location, their values live in buffers
+            if (location < 0)
+                continue;
+            switch (type)
+            {
+            case GL_FLOAT:      value.Floats.resize(1);  break;
+            case GL_FLOAT_VEC2: value.Floats.resize(2);  break;
+            case GL_FLOAT_VEC3: value.Floats.resize(3);  break;
+            case GL_FLOAT_VEC4: value.Floats.resize(4);  break;
+            case GL_FLOAT_MAT4: value.Floats.resize(16); break;
+            case GL_INT:
+            case GL_BOOL:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_2D_MULTISAMPLE: value.Integers.resize(1); break;
+            default: continue;
+            }
+            if (!value.Floats.empty())
+                glGetUniformfv(this->ID, location, value.Floats.data());
+            else
+                glGetUniformiv(this->ID, location, value.Integers.data());
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+void Shader::restoreUniforms(const std::vector<UniformValue> &values)
+{
+    this->Use();
+    for (const UniformValue &value : values)
+    {
+        GLint location = glGetUniformLocation(this->ID, value.Name.c_str());
+        if (location < 0)
+            continue;
+        switch (value.Type)
+        {
+        case GL_FLOAT:      glUniform1fv(location, 1, value.Floats.data()); break;
+        case GL_FLOAT_VEC2: glUniform2fv(location, 1, value.Floats.data()); break;
+        case GL_FLOAT_VEC3: glUniform3fv(location, 1, value.Floats.data()); break;
+        case GL_FLOAT_VEC4: glUniform4fv(location, 1, value.Floats.data()); break;
+        case GL_FLOAT_MAT4: glUniformMatrix4fv(location, 1, GL_FALSE, value.Floats.data()); break;
+        default:            glUniform1iv(location, 1, value.Integers.data()); break;
+        }
+    }
+}
+
 void Shader::SetFloat(const GLchar *name, GLfloat value, GLboolean useShader)
 {
     if (useShader)
@@ -0,0 +1,732 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "SoftwareBackend.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTWARE_SSE2
+#endif
+
+#include "FrameUniforms.hpp"
+
+// Subpixel precision of vertex positions (1 / SUBPIXELS of a pixel); edge functions are evaluated exactly
+// in these units, so pixels on an edge shared by two triangles are drawn exactly once
+static const long long SUBPIXELS = 16;
+// Kernel spacing of the post effects in texture coordinates, as in post_processor.frag
+static const GLfloat POST_OFFSET = 1.0f / 300.0f;
+// Largest distance from a texel center, in texels, at which a sprite still counts as drawn at its texture's size
+static const GLfloat DIRECT_TOLERANCE = 1.0f / 1024.0f;
+
+// Four floats processed together: an SSE register where available, plain floats otherwise. They are the four
+// channels of one color (post effects) or one channel of four neighbouring pixels (rasterization)
+#ifdef SOFTWARE_SSE2
+typedef __m128 Channels;
+
+static inline Channels load(const GLfloat *p)                                  { return _mm_loadu_ps(p); }
+static inline void     store(GLfloat *p, Channels c)                           { _mm_storeu_ps(p, c); }
+static inline Channels splat(GLfloat f)                                        { return _mm_set1_ps(f); }
+static inline Channels channels(GLfloat r, GLfloat g, GLfloat b, GLfloat a)    { return _mm_setr_ps(r, g, b, a); }
+static inline Channels add(Channels a, Channels b)                             { return _mm_add_ps(a, b); }
+static inline Channels sub(Channels a, Channels b)                             { return _mm_sub_ps(a, b); }
+static inline Channels mul(Channels a, Channels b)                             { return _mm_mul_ps(a, b); }
+static inline Channels saturate(Channels c)                                    { return _mm_min_ps(_mm_max_ps(c, _mm_setzero_ps()), _mm_set1_ps(1.0f)); }
+// Turns four pixels into four channels and back
+static inline void     transpose(Channels *c)                                  { _MM_TRANSPOSE4_PS(c[0], c[1], c[2], c[3]); }
+
+// Rounds four values down, also to integers
+static inline Channels floorLanes(Channels c, GLint *integers)
+{
+	__m128i truncated = _mm_cvttps_epi32(c);
+	// Truncation rounds negative values up; those lanes are all ones, i.e. -1
+	__m128i above = _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), c));
+	__m128i floored = _mm_add_epi32(truncated, above);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(integers), floored);
+	return _mm_cvtepi32_ps(floored);
+}
+
+// Four RGBA8 texels (16 bytes) as one register per channel, in [0, 255]
+static inline void split(const unsigned char *texels, Channels *rgba)
+{
+	__m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i *>(texels));
+	__m128i low = _mm_set1_epi32(0xFF);
+	rgba[0] = _mm_cvtepi32_ps(_mm_and_si128(bits, low));
+	rgba[1] = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(bits, 8), low));
+	rgba[2] = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(bits, 16), low));
+	rgba[3] = _mm_cvtepi32_ps(_mm_srli_epi32(bits, 24));
+}
+
+// Rounds a color in [0, 1] to RGBA8
+static inline void pack(Channels c, unsigned char *texel)
+{
+	__m128i values = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(saturate(c), _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+	values = _mm_packs_epi32(values, values);
+	GLint bits = _mm_cvtsi128_si32(_mm_packus_epi16(values, values));
+	std::memcpy(texel, &bits, 4);
+}
+#else
+struct Channels
+{
+	GLfloat V[4];
+};
+
+static inline Channels channels(GLfloat r, GLfloat g, GLfloat b, GLfloat a) { Channels c = { { r, g, b, a } }; return c; }
+static inline Channels load(const GLfloat *p)                               { return channels(p[0], p[1], p[2], p[3]); }
+static inline void     store(GLfloat *p, Channels c)                        { std::memcpy(p, c.V, sizeof(c.V)); }
+static inline Channels splat(GLfloat f)                                     { return channels(f, f, f, f); }
+static inline Channels add(Channels a, Channels b)                          { return channels(a.V[0] + b.V[0], a.V[1] + b.V[1], a.V[2] + b.V[2], a.V[3] + b.V[3]); }
+static inline Channels sub(Channels a, Channels b)                          { return channels(a.V[0] - b.V[0], a.V[1] - b.V[1], a.V[2] - b.V[2], a.V[3] - b.V[3]); }
+static inline Channels mul(Channels a, Channels b)                          { return channels(a.V[0] * b.V[0], a.V[1] * b.V[1], a.V[2] * b.V[2], a.V[3] * b.V[3]); }
+
+static inline Channels saturate(Channels c)
+{
+	for (GLfloat &v : c.V)
+		v = std::min(std::max(v, 0.0f), 1.0f);
+	return c;
+}
+
+static inline void transpose(Channels *c)
+{
+	for (GLuint i = 0; i < 4; ++i)
+		for (GLuint j = i + 1; j < 4; ++j)
+			std::swap(c[i].V[j], c[j].V[i]);
+}
+
+static inline Channels floorLanes(Channels c, GLint *integers)
+{
+	for (GLuint i = 0; i < 4; ++i)
+	{
+		c.V[i] = std::floor(c.V[i]);
+		integers[i] = static_cast<GLint>(c.V[i]);
+	}
+	return c;
+}
+
+static inline void split(const unsigned char *texels, Channels *rgba)
+{
+	for (GLuint channel = 0; channel < 4; ++channel)
+		rgba[channel] = channels(texels[channel], texels[4 + channel], texels[8 + channel], texels[12 + channel]);
+}
+
+static inline void pack(Channels c, unsigned char *texel)
+{
+	c = saturate(c);
+	for (GLuint i = 0; i < 4; ++i)
+		texel[i] = static_cast<unsigned char>(c.V[i] * 255.0f + 0.5f);
+}
+#endif
+
+static inline Channels lerp(Channels a, Channels b, GLfloat t)
+{
+	return add(a, mul(sub(b, a), splat(t)));
+}
+
+static inline Channels lerp(Channels a, Channels b, Channels t)
+{
+	return add(a, mul(sub(b, a), t));
+}
+
+static inline GLint wrap(GLint i, GLint size, GLboolean repeat)
+{
+	if (repeat)
+	{
+		i %= size;
+		return i < 0 ? i + size : i;
+	}
+	return i < 0 ? 0 : (i >= size ? size - 1 : i);
+}
+
+// Samples an image at GL texture coordinates (v = 0 is its first row) for count pixels, one per lane, filtered and wrapped like
+// the GL texture would be. The texels come out in [0, 255], one register per channel
+static void sample(const Texture2D::Image &image, Channels u, Channels v, GLboolean repeatS, GLboolean repeatT, GLboolean linear,
+                   GLint count, Channels *texel)
+{
+	GLint width = static_cast<GLint>(image.Width), height = static_cast<GLint>(image.Height);
+	const unsigned char *pixels = image.Pixels.data();
+	Channels x = mul(u, splat(static_cast<GLfloat>(width))), y = mul(v, splat(static_cast<GLfloat>(height)));
+	GLint columns[4], rows[4];
+	if (!linear)
+	{
+		floorLanes(x, columns);
+		floorLanes(y, rows);
+		unsigned char texels[16] = { 0 };
+		for (GLint i = 0; i < count; ++i)
+			std::memcpy(texels + i * 4, pixels + (wrap(rows[i], height, repeatT) * width + wrap(columns[i], width, repeatS)) * 4, 4);
+		split(texels, texel);
+		return;
+	}
+	// Texel centers are at half coordinates
+	x = sub(x, splat(0.5f));
+	y = sub(y, splat(0.5f));
+	Channels tx = sub(x, floorLanes(x, columns)), ty = sub(y, floorLanes(y, rows));
+	// Top left, top right, bottom left and bottom right texel of every pixel
+	unsigned char corners[4][16] = { { 0 } };
+	for (GLint i = 0; i < count; ++i)
+	{
+		GLint x0 = wrap(columns[i], width, repeatS) * 4, x1 = wrap(columns[i] + 1, width, repeatS) * 4;
+		const unsigned char *row0 = pixels + wrap(rows[i], height, repeatT) * width * 4, *row1 = pixels + wrap(rows[i] + 1, height, repeatT) * width * 4;
+		std::memcpy(corners[0] + i * 4, row0 + x0, 4);
+		std::memcpy(corners[1] + i * 4, row0 + x1, 4);
+		std::memcpy(corners[2] + i * 4, row1 + x0, 4);
+		std::memcpy(corners[3] + i * 4, row1 + x1, 4);
+	}
+	Channels values[4][4];
+	for (GLuint corner = 0; corner < 4; ++corner)
+		split(corners[corner], values[corner]);
+	for (GLuint channel = 0; channel < 4; ++channel)
+		texel[channel] = lerp(lerp(values[0][channel], values[1][channel], tx), lerp(values[2][channel], values[3][channel], tx), ty);
+}
+
+// Blends count pixels with the given texels ([0, 255]) and colors, one register per channel, into the RGBA pixels of the target.
+// Only the pixels whose bit is set in covered are written
+static void blend(const Channels *texel, const Channels *color, GLboolean glyph, GLboolean additive, GLint count, GLuint covered, GLfloat *pixel)
+{
+	const Channels scale = splat(1.0f / 255.0f);
+	Channels source[4];
+	// Glyph textures hold coverage in red, which becomes the alpha of the text color
+	for (GLuint channel = 0; channel < 3; ++channel)
+		source[channel] = glyph ? color[channel] : mul(color[channel], mul(texel[channel], scale));
+	source[3] = mul(color[3], mul(texel[glyph ? 0 : 3], scale));
+	Channels destination[4];
+	for (GLint i = 0; i < 4; ++i)
+		destination[i] = i < count ? load(pixel + i * 4) : splat(0.0f);
+	transpose(destination);
+	// GL_SRC_ALPHA with GL_ONE_MINUS_SRC_ALPHA, or GL_ONE for additive blending; clamped like a normalized target
+	const Channels alpha = source[3], inverse = sub(splat(1.0f), alpha);
+	for (GLuint channel = 0; channel < 4; ++channel)
+		destination[channel] = saturate(add(mul(source[channel], alpha), additive ? destination[channel] : mul(destination[channel], inverse)));
+	transpose(destination);
+	for (GLint i = 0; i < count; ++i)
+		if (covered & (1u << i))
+			store(pixel + i * 4, destination[i]);
+}
+
+// Where one tap of a post effect reads the scene along one axis: between texels First and Second, Weight of the way to Second
+struct PostTap
+{
+	GLint   First, Second;
+	GLfloat Weight;
+};
+
+// Tap at texture coordinate c along an axis of size texels, like post_processor.frag's fetchScene: wrapped and kept half a
+// texel inside. flip counts texels from the other end, for rows, which GL counts from the bottom
+static PostTap postTap(GLfloat c, GLint size, GLboolean flip)
+{
+	c -= std::floor(c);
+	GLfloat half = 0.5f / size;
+	c = std::min(std::max(c, half), 1.0f - half);
+	GLfloat position = (flip ? 1.0f - c : c) * size - 0.5f;
+	PostTap tap;
+	tap.First = static_cast<GLint>(position);
+	tap.Second = std::min(tap.First + 1, size - 1);
+	tap.Weight = position - tap.First;
+	return tap;
+}
+
+
+SoftwareBackend::SoftwareBackend(GLuint width, GLuint height, GLuint threads)
+	: Width(width), Height(height), RasterTime(0.0), scene(width * height * 4), output(width * height * 4), pixels(width * height * 4),
+	  target(TARGET_OUTPUT), layerParent(TARGET_OUTPUT), clearTarget(GL_TRUE), clipX0(0), clipY0(0), clipX1(static_cast<GLint>(width)),
+	  clipY1(static_cast<GLint>(height)), layerImage(nullptr), resolveSource(nullptr), resolveTarget(nullptr), resolveOpaque(GL_FALSE),
+	  effects(0), time(0.0f), generation(0), busy(0), stopping(GL_FALSE), job(JOB_RASTER), nextTile(0)
+{
+	this->tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	this->tileCount = this->tilesX * ((height + TILE_SIZE - 1) / TILE_SIZE);
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	// The thread dispatching a job works on it too
+	for (GLuint i = 1; i < threads; ++i)
+		this->workers.push_back(std::thread(&SoftwareBackend::worker, this));
+}
+
+SoftwareBackend::~SoftwareBackend()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = GL_TRUE;
+	}
+	this->wake.notify_all();
+	for (std::thread &worker : this->workers)
+		worker.join();
+}
+
+void SoftwareBackend::DrawTriangles(const Texture2D &texture, const Vertex *vertices, GLsizei count, Blend blend)
+{
+	Mode mode = blend == BLEND_ADDITIVE ? MODE_ADDITIVE : MODE_ALPHA;
+	for (GLsizei i = 0; i + 2 < count; i += 3)
+		this->record(vertices[i], vertices[i + 1], vertices[i + 2], texture, mode);
+}
+
+void SoftwareBackend::DrawGlyphs(const Texture2D *glyphs, const Vertex *vertices, GLsizei quads)
+{
+	for (GLsizei i = 0; i < quads; ++i)
+	{
+		const Vertex *quad = vertices + i * 6;
+		this->record(quad[0], quad[1], quad[2], glyphs[i], MODE_GLYPH);
+		this->record(quad[3], quad[4], quad[5], glyphs[i], MODE_GLYPH);
+	}
+}
+
+void SoftwareBackend::BeginScene()
+{
+	this->flush();
+	this->target = TARGET_SCENE;
+	this->clearTarget = GL_TRUE;
+}
+
+void SoftwareBackend::EndScene()
+{
+	this->flush();
+	this->target = TARGET_OUTPUT;
+}
+
+void SoftwareBackend::PresentScene(GLint effects, GLfloat time)
+{
+	this->flush();
+	this->effects = effects;
+	this->time = time;
+	this->dispatch(JOB_POST);
+}
+
+void SoftwareBackend::Clear()
+{
+	this->flush();
+	this->RasterTime = 0.0;
+	this->target = TARGET_OUTPUT;
+	this->clearTarget = GL_TRUE;
+	this->clipX0 = this->clipY0 = 0;
+	this->clipX1 = static_cast<GLint>(this->Width);
+	this->clipY1 = static_cast<GLint>(this->Height);
+}
+
+const unsigned char *SoftwareBackend::Pixels()
+{
+	this->flush();
+	this->resolveSource = &this->output;
+	this->resolveTarget = this->pixels.data();
+	this->resolveOpaque = GL_FALSE;
+	this->dispatch(JOB_RESOLVE);
+	return this->pixels.data();
+}
+
+void SoftwareBackend::BeginLayer(Texture2D &texture, GLint x0, GLint y0, GLint x1, GLint y1)
+{
+	this->flush();
+	this->layerParent = this->target;
+	this->target = TARGET_LAYER;
+	this->clearTarget = GL_TRUE;
+	this->layerImage = texture.Memory();
+	if (this->layerImage == nullptr || this->layerImage->Width != this->Width || this->layerImage->Height != this->Height)
+	{
+		std::cout << "ERROR::SOFTWARE_BACKEND: A layer has to be a headless texture of the output's size" << std::endl;
+		this->layerImage = nullptr;
+		x1 = x0;
+	}
+	if (this->layer.empty())
+		this->layer.resize(this->Width * this->Height * 4);
+	this->clipX0 = std::max(0, x0);
+	this->clipY0 = std::max(0, y0);
+	this->clipX1 = std::min(static_cast<GLint>(this->Width), x1);
+	this->clipY1 = std::min(static_cast<GLint>(this->Height), y1);
+}
+
+void SoftwareBackend::EndLayer()
+{
+	this->flush();
+	if (this->layerImage != nullptr)
+	{
+		this->resolveSource = &this->layer;
+		this->resolveTarget = this->layerImage->Pixels.data();
+		this->resolveOpaque = GL_TRUE;
+		this->dispatch(JOB_RESOLVE);
+	}
+	this->layerImage = nullptr;
+	this->target = this->layerParent;
+	this->clearTarget = GL_FALSE;
+	this->clipX0 = this->clipY0 = 0;
+	this->clipX1 = static_cast<GLint>(this->Width);
+	this->clipY1 = static_cast<GLint>(this->Height);
+}
+
+void SoftwareBackend::record(const Vertex &a, const Vertex &b, const Vertex &c, const Texture2D &texture, Mode mode)
+{
+	const Texture2D::Image *image = texture.Memory();
+	if (image == nullptr || image->Width == 0 || image->Height == 0)
+		return;
+	// Snap the corners to the subpixel grid
+	const Vertex *corners[3] = { &a, &b, &c };
+	long long x[3], y[3];
+	for (GLuint i = 0; i < 3; ++i)
+	{
+		x[i] = std::llround(corners[i]->X * SUBPIXELS);
+		y[i] = std::llround(corners[i]->Y * SUBPIXELS);
+	}
+	long long area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (area == 0)
+		return;
+
+	Triangle triangle;
+	// Pixels whose centers can be inside
+	const GLfloat half = SUBPIXELS / 2.0f;
+	GLfloat minX = static_cast<GLfloat>(std::min(x[0], std::min(x[1], x[2]))), maxX = static_cast<GLfloat>(std::max(x[0], std::max(x[1], x[2])));
+	GLfloat minY = static_cast<GLfloat>(std::min(y[0], std::min(y[1], y[2]))), maxY = static_cast<GLfloat>(std::max(y[0], std::max(y[1], y[2])));
+	triangle.X0 = std::max(this->clipX0, static_cast<GLint>(std::ceil((minX - half) / SUBPIXELS)));
+	triangle.Y0 = std::max(this->clipY0, static_cast<GLint>(std::ceil((minY - half) / SUBPIXELS)));
+	triangle.X1 = std::min(this->clipX1, static_cast<GLint>(std::floor((maxX - half) / SUBPIXELS)) + 1);
+	triangle.Y1 = std::min(this->clipY1, static_cast<GLint>(std::floor((maxY - half) / SUBPIXELS)) + 1);
+	if (triangle.X0 >= triangle.X1 || triangle.Y0 >= triangle.Y1)
+		return;
+
+	// Edge i runs from corner i to the next one; it is zero on the edge and equals area at the opposite corner,
+	// so flipping by the sign of area makes the inside positive for either winding
+	long long sign = area > 0 ? 1 : -1;
+	for (GLuint i = 0; i < 3; ++i)
+	{
+		GLuint j = (i + 1) % 3;
+		long long edgeA = -(y[j] - y[i]) * sign, edgeB = (x[j] - x[i]) * sign;
+		// Top-left rule (y points down): a pixel exactly on an edge belongs to the triangle to its right or below it.
+		// Exclusive edges need a value of at least 1, so every edge is tested with >= 0
+		GLboolean inclusive = edgeA > 0 || (edgeA == 0 && edgeB > 0);
+		triangle.EdgeA[i] = edgeA;
+		triangle.EdgeB[i] = edgeB;
+		triangle.EdgeC[i] = -(edgeA * x[i] + edgeB * y[i]) - (inclusive ? 0 : 1);
+	}
+
+	// Attribute planes through the three corners, in pixels
+	GLfloat dx1 = b.X - a.X, dy1 = b.Y - a.Y, dx2 = c.X - a.X, dy2 = c.Y - a.Y;
+	GLfloat determinant = dx1 * dy2 - dx2 * dy1;
+	if (determinant == 0.0f)
+		return;
+	auto plane = [&](GLfloat va, GLfloat vb, GLfloat vc, GLfloat *result) {
+		GLfloat d1 = vb - va, d2 = vc - va;
+		result[1] = (d1 * dy2 - d2 * dy1) / determinant;
+		result[2] = (d2 * dx1 - d1 * dx2) / determinant;
+		result[0] = va - result[1] * a.X - result[2] * a.Y;
+	};
+	plane(a.U, b.U, c.U, triangle.U);
+	plane(a.V, b.V, c.V, triangle.V);
+	const GLfloat Vertex::*colors[4] = { &Vertex::R, &Vertex::G, &Vertex::B, &Vertex::A };
+	for (GLuint channel = 0; channel < 4; ++channel)
+	{
+		GLfloat values[3];
+		plane(a.*colors[channel], b.*colors[channel], c.*colors[channel], values);
+		for (GLuint term = 0; term < 3; ++term)
+			triangle.Color[term][channel] = values[term];
+	}
+	triangle.Image = image;
+	triangle.RepeatS = texture.Wrap_S == GL_REPEAT;
+	triangle.RepeatT = texture.Wrap_T == GL_REPEAT;
+	triangle.Linear = texture.Filter_Max == GL_LINEAR;
+	triangle.Mode = static_cast<GLubyte>(mode);
+	// A sprite drawn at its texture's size without rotation puts every pixel center on a texel center, filtered or not.
+	// The offset from the pixel to its texel is linear, so it is the same integer everywhere if it is one at the corners
+	triangle.Direct = GL_TRUE;
+	const GLfloat textureWidth = static_cast<GLfloat>(image->Width), textureHeight = static_cast<GLfloat>(image->Height);
+	const GLfloat cornersX[2] = { triangle.X0 + 0.5f, triangle.X1 - 0.5f }, cornersY[2] = { triangle.Y0 + 0.5f, triangle.Y1 - 0.5f };
+	triangle.TexelX = static_cast<GLint>(std::lround((triangle.U[0] + triangle.U[1] * cornersX[0] + triangle.U[2] * cornersY[0]) * textureWidth - cornersX[0]));
+	triangle.TexelY = static_cast<GLint>(std::lround((triangle.V[0] + triangle.V[1] * cornersX[0] + triangle.V[2] * cornersY[0]) * textureHeight - cornersY[0]));
+	for (GLfloat px : cornersX)
+		for (GLfloat py : cornersY)
+		{
+			GLfloat texelX = (triangle.U[0] + triangle.U[1] * px + triangle.U[2] * py) * textureWidth - px;
+			GLfloat texelY = (triangle.V[0] + triangle.V[1] * px + triangle.V[2] * py) * textureHeight - py;
+			if (std::fabs(texelX - triangle.TexelX) > DIRECT_TOLERANCE || std::fabs(texelY - triangle.TexelY) > DIRECT_TOLERANCE)
+				triangle.Direct = GL_FALSE;
+		}
+	// Without wrapping
+	if (triangle.X0 + triangle.TexelX < 0 || triangle.X1 + triangle.TexelX > static_cast<GLint>(image->Width) ||
+	    triangle.Y0 + triangle.TexelY < 0 || triangle.Y1 + triangle.TexelY > static_cast<GLint>(image->Height))
+		triangle.Direct = GL_FALSE;
+	this->triangles.push_back(triangle);
+}
+
+void SoftwareBackend::flush()
+{
+	if (this->triangles.empty() && !this->clearTarget)
+		return;
+	this->dispatch(JOB_RASTER);
+	this->triangles.clear();
+	this->clearTarget = GL_FALSE;
+}
+
+void SoftwareBackend::dispatch(Job job)
+{
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+	this->job = job;
+	this->nextTile = 0;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		++this->generation;
+		this->busy = static_cast<GLuint>(this->workers.size());
+	}
+	this->wake.notify_all();
+	this->work();
+	// Every worker has to have seen this job run out before the next one may start
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->done.wait(lock, [this]() { return this->busy == 0; });
+	this->RasterTime += std::chrono::duration<GLdouble, std::milli>(Clock::now() - start).count();
+}
+
+void SoftwareBackend::worker()
+{
+	GLuint seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->wake.wait(lock, [&]() { return this->stopping || this->generation != seen; });
+			if (this->stopping)
+				return;
+			seen = this->generation;
+		}
+		this->work();
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (--this->busy == 0)
+			this->done.notify_one();
+	}
+}
+
+void SoftwareBackend::work()
+{
+	for (GLuint tile = this->nextTile++; tile < this->tileCount; tile = this->nextTile++)
+	{
+		if (this->job == JOB_RASTER)
+			this->rasterTile(tile);
+		else if (this->job == JOB_POST)
+			this->postTile(tile);
+		else
+			this->resolveTile(tile);
+	}
+}
+
+void SoftwareBackend::tileRect(GLuint tile, GLint &x0, GLint &y0, GLint &x1, GLint &y1) const
+{
+	x0 = static_cast<GLint>(tile % this->tilesX) * TILE_SIZE;
+	y0 = static_cast<GLint>(tile / this->tilesX) * TILE_SIZE;
+	x1 = std::min(x0 + TILE_SIZE, static_cast<GLint>(this->Width));
+	y1 = std::min(y0 + TILE_SIZE, static_cast<GLint>(this->Height));
+}
+
+void SoftwareBackend::rasterTile(GLuint tile)
+{
+	GLint x0, y0, x1, y1;
+	this->tileRect(tile, x0, y0, x1, y1);
+	std::vector<GLfloat> &image = this->target == TARGET_SCENE ? this->scene : (this->target == TARGET_LAYER ? this->layer : this->output);
+	const GLint stride = static_cast<GLint>(this->Width) * 4;
+	if (this->clearTarget)
+	{
+		Channels black = channels(0.0f, 0.0f, 0.0f, 1.0f);
+		for (GLint y = std::max(y0, this->clipY0); y < std::min(y1, this->clipY1); ++y)
+			for (GLint x = std::max(x0, this->clipX0); x < std::min(x1, this->clipX1); ++x)
+				store(&image[y * stride + x * 4], black);
+	}
+	// Offsets of the four pixels of a span
+	const Channels ramp = channels(0.0f, 1.0f, 2.0f, 3.0f);
+	for (const Triangle &triangle : this->triangles)
+	{
+		GLint left = std::max(x0, triangle.X0), right = std::min(x1, triangle.X1);
+		GLint top = std::max(y0, triangle.Y0), bottom = std::min(y1, triangle.Y1);
+		if (left >= right || top >= bottom)
+			continue;
+		const GLboolean glyph = triangle.Mode == MODE_GLYPH, additive = triangle.Mode == MODE_ADDITIVE;
+		const GLint textureWidth = static_cast<GLint>(triangle.Image->Width);
+		const Channels stepU = splat(triangle.U[1] * 4.0f), stepV = splat(triangle.V[1] * 4.0f);
+		Channels stepColor[4];
+		for (GLuint channel = 0; channel < 4; ++channel)
+			stepColor[channel] = splat(triangle.Color[1][channel] * 4.0f);
+		for (GLint y = top; y < bottom; ++y)
+		{
+			// Pixel centers, in subpixels for the edges and in pixels for the attributes
+			long long sx = left * SUBPIXELS + SUBPIXELS / 2, sy = y * SUBPIXELS + SUBPIXELS / 2;
+			long long e0 = triangle.EdgeA[0] * sx + triangle.EdgeB[0] * sy + triangle.EdgeC[0];
+			long long e1 = triangle.EdgeA[1] * sx + triangle.EdgeB[1] * sy + triangle.EdgeC[1];
+			long long e2 = triangle.EdgeA[2] * sx + triangle.EdgeB[2] * sy + triangle.EdgeC[2];
+			const long long step0 = triangle.EdgeA[0] * SUBPIXELS, step1 = triangle.EdgeA[1] * SUBPIXELS, step2 = triangle.EdgeA[2] * SUBPIXELS;
+			GLfloat px = left + 0.5f, py = y + 0.5f;
+			Channels u = add(splat(triangle.U[0] + triangle.U[1] * px + triangle.U[2] * py), mul(splat(triangle.U[1]), ramp));
+			Channels v = add(splat(triangle.V[0] + triangle.V[1] * px + triangle.V[2] * py), mul(splat(triangle.V[1]), ramp));
+			Channels color[4];
+			for (GLuint channel = 0; channel < 4; ++channel)
+				color[channel] = add(splat(triangle.Color[0][channel] + triangle.Color[1][channel] * px + triangle.Color[2][channel] * py),
+				                     mul(splat(triangle.Color[1][channel]), ramp));
+			GLfloat *pixel = &image[y * stride + left * 4];
+			const unsigned char *texels = triangle.Direct ? triangle.Image->Pixels.data() + ((y + triangle.TexelY) * textureWidth + left + triangle.TexelX) * 4
+			                                              : nullptr;
+			for (GLint x = left; x < right; x += 4, pixel += 16)
+			{
+				GLint count = std::min(4, right - x);
+				GLuint covered = 0;
+				for (GLint i = 0; i < count; ++i)
+				{
+					if ((e0 | e1 | e2) >= 0)
+						covered |= 1u << i;
+					e0 += step0;
+					e1 += step1;
+					e2 += step2;
+				}
+				if (covered != 0)
+				{
+					Channels texel[4];
+					if (texels == nullptr)
+						sample(*triangle.Image, u, v, triangle.RepeatS, triangle.RepeatT, triangle.Linear, count, texel);
+					else if (count == 4)
+						split(texels + (x - left) * 4, texel);
+					else
+					{
+						// Don't read past the triangle's texels
+						unsigned char last[16] = { 0 };
+						std::memcpy(last, texels + (x - left) * 4, count * 4);
+						split(last, texel);
+					}
+					blend(texel, color, glyph, additive, count, covered, pixel);
+				}
+				u = add(u, stepU);
+				v = add(v, stepV);
+				for (GLuint channel = 0; channel < 4; ++channel)
+					color[channel] = add(color[channel], stepColor[channel]);
+			}
+		}
+	}
+}
+
+void SoftwareBackend::postTile(GLuint tile)
+{
+	GLint x0, y0, x1, y1;
+	this->tileRect(tile, x0, y0, x1, y1);
+	const GLint width = static_cast<GLint>(this->Width), height = static_cast<GLint>(this->Height);
+	GLboolean chaos = (this->effects & FrameUniforms::EFFECT_CHAOS) != 0;
+	GLboolean confuse = !chaos && (this->effects & FrameUniforms::EFFECT_CONFUSE) != 0;
+	GLboolean shake = (this->effects & FrameUniforms::EFFECT_SHAKE) != 0;
+	// post_processor.vert: shaking moves the whole quad, chaos scrolls the texture coordinates
+	GLfloat shakeOffset = shake ? std::cos(this->time * 10.0f) * 0.01f : 0.0f;
+	GLfloat chaosU = chaos ? std::sin(this->time) * 0.3f : 0.0f, chaosV = chaos ? std::cos(this->time) * 0.3f : 0.0f;
+	const Channels opaque = channels(0.0f, 0.0f, 0.0f, 1.0f), colorOnly = channels(1.0f, 1.0f, 1.0f, 0.0f);
+
+	// Edge detection and the blur (shaking without another effect) read 3x3 taps, the others one. Where a tap reads depends on
+	// the column or on the row only, so the taps are set up once per tile and axis. The moved quad may leave some of them uncovered
+	const GLint taps = chaos || (shake && !confuse) ? 3 : 1, columns = x1 - x0, rows = y1 - y0;
+	std::vector<PostTap> columnTaps(columns * taps), rowTaps(rows * taps);
+	std::vector<GLboolean> columnCovered(columns), rowCovered(rows);
+	for (GLint x = x0; x < x1; ++x)
+	{
+		// Pixel center in normalized device coordinates
+		GLfloat ndcX = (x + 0.5f) / width * 2.0f - 1.0f - shakeOffset;
+		columnCovered[x - x0] = ndcX >= -1.0f && ndcX <= 1.0f;
+		GLfloat u = (ndcX + 1.0f) * 0.5f + chaosU;
+		for (GLint tap = 0; tap < taps; ++tap)
+			columnTaps[(x - x0) * taps + tap] = postTap((confuse ? 1.0f - u : u) + (tap - taps / 2) * POST_OFFSET, width, GL_FALSE);
+	}
+	for (GLint y = y0; y < y1; ++y)
+	{
+		// y points up
+		GLfloat ndcY = 1.0f - (y + 0.5f) / height * 2.0f - shakeOffset;
+		rowCovered[y - y0] = ndcY >= -1.0f && ndcY <= 1.0f;
+		GLfloat v = (ndcY + 1.0f) * 0.5f + chaosV;
+		for (GLint tap = 0; tap < taps; ++tap)
+			rowTaps[(y - y0) * taps + tap] = postTap((confuse ? 1.0f - v : v) + (tap - taps / 2) * POST_OFFSET, height, GL_TRUE);
+	}
+	const GLfloat *scene = this->scene.data();
+	// Bilinear fetch of the scene through a column tap and a row tap
+	auto fetch = [&](const PostTap &column, const PostTap &row) {
+		const GLfloat *first = scene + row.First * width * 4, *second = scene + row.Second * width * 4;
+		return lerp(lerp(load(first + column.First * 4), load(first + column.Second * 4), column.Weight),
+		            lerp(load(second + column.First * 4), load(second + column.Second * 4), column.Weight), row.Weight);
+	};
+
+	// The 3x3 kernels are separable: every scene row a row tap reads is filtered across the column taps first ([1 2 1] / 4 for the
+	// binomial blur, all ones for edge detection), then the filtered rows are combined through the row taps with the same weights
+	static const GLfloat blur[3] = { 0.25f, 0.5f, 0.25f }, box[3] = { 1.0f, 1.0f, 1.0f };
+	const GLfloat *weights = chaos ? box : blur;
+	std::vector<GLint> slots;
+	std::vector<GLfloat> filtered;
+	if (taps == 3)
+	{
+		slots.assign(height, -1);
+		GLint used = 0;
+		for (const PostTap &tap : rowTaps)
+		{
+			if (slots[tap.First] < 0)
+				slots[tap.First] = used++;
+			if (slots[tap.Second] < 0)
+				slots[tap.Second] = used++;
+		}
+		filtered.resize(used * columns * 4);
+		for (GLint row = 0; row < height; ++row)
+		{
+			if (slots[row] < 0)
+				continue;
+			const GLfloat *source = scene + row * width * 4;
+			GLfloat *target = &filtered[slots[row] * columns * 4];
+			for (GLint column = 0; column < columns; ++column)
+			{
+				Channels sum = splat(0.0f);
+				for (GLint tap = 0; tap < 3; ++tap)
+				{
+					const PostTap &columnTap = columnTaps[column * 3 + tap];
+					sum = add(sum, mul(splat(weights[tap]), lerp(load(source + columnTap.First * 4), load(source + columnTap.Second * 4), columnTap.Weight)));
+				}
+				store(target + column * 4, sum);
+			}
+		}
+	}
+
+	for (GLint y = y0; y < y1; ++y)
+	{
+		if (!rowCovered[y - y0])
+			continue;
+		const PostTap *row = &rowTaps[(y - y0) * taps];
+		for (GLint x = x0; x < x1; ++x)
+		{
+			if (!columnCovered[x - x0])
+				continue;
+			const PostTap *column = &columnTaps[(x - x0) * taps];
+			Channels color;
+			if (taps == 1)
+			{
+				color = fetch(column[0], row[0]);
+				if (confuse)
+					color = sub(splat(1.0f), color);
+			}
+			else
+			{
+				Channels sum = splat(0.0f);
+				for (GLint tap = 0; tap < 3; ++tap)
+				{
+					const GLfloat *first = &filtered[(slots[row[tap].First] * columns + x - x0) * 4];
+					const GLfloat *second = &filtered[(slots[row[tap].Second] * columns + x - x0) * 4];
+					sum = add(sum, mul(splat(weights[tap]), lerp(load(first), load(second), row[tap].Weight)));
+				}
+				// Edge detection: 8 * center - sum of the 8 neighbours, which is 9 * center - sum of all 9 taps
+				color = chaos ? sub(mul(splat(9.0f), fetch(column[1], row[1])), sum) : sum;
+			}
+			store(&this->output[(y * width + x) * 4], add(mul(saturate(color), colorOnly), opaque));
+		}
+	}
+}
+
+void SoftwareBackend::resolveTile(GLuint tile)
+{
+	GLint x0, y0, x1, y1;
+	this->tileRect(tile, x0, y0, x1, y1);
+	const Channels keep = this->resolveOpaque ? channels(1.0f, 1.0f, 1.0f, 0.0f) : splat(1.0f);
+	const Channels opaque = this->resolveOpaque ? channels(0.0f, 0.0f, 0.0f, 1.0f) : splat(0.0f);
+	for (GLint y = std::max(y0, this->clipY0); y < std::min(y1, this->clipY1); ++y)
+		for (GLint x = std::max(x0, this->clipX0); x < std::min(x1, this->clipX1); ++x)
+		{
+			size_t index = (static_cast<size_t>(y) * this->Width + x) * 4;
+			pack(add(mul(load(&(*this->resolveSource)[index]), keep), opaque), this->resolveTarget + index);
+		}
+}
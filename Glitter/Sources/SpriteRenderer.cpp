@@ -5,64 +5,44 @@
 
 #include "SpriteRenderer.hpp"
 
-SpriteRenderer::SpriteRenderer(const Shader &shader)
-{
-	this->shader = shader;
-	this->initRenderData();
-}
+#include <cmath>
 
-SpriteRenderer::~SpriteRenderer()
+SpriteRenderer::SpriteRenderer(RenderBackend &backend)
+	: backend(backend)
 {
-	glDeleteVertexArrays(1, &this->quadVAO);
 }
 
 void SpriteRenderer::DrawSprite(const Texture2D &texture, glm::vec2 position, glm::vec2 size, GLfloat rotate, glm::vec3 color)
 {
-	this->shader.Use();
-	glm::mat4 model(1.0f);
-	model = glm::translate(model, glm::vec3(position, 0.0f));
-
-	model = glm::translate(model, glm::vec3(0.5f * size.x, 0.5f * size.y, 0.0f));
-	model = glm::rotate(model, rotate, glm::vec3(0.0f, 0.0f, 1.0f));
-	model = glm::translate(model, glm::vec3(-0.5f * size.x, -0.5f * size.y, 0.0f));
-
-	model = glm::scale(model, glm::vec3(size, 1.0f));
-
-	this->shader.SetMatrix4("model", model);
-	this->shader.SetVector3f("spriteColor", color);
-
-	glActiveTexture(GL_TEXTURE0);
-	texture.Bind();
-
-	glBindVertexArray(this->quadVAO);
-	glDrawArrays(GL_TRIANGLES, 0, 6);
-	glBindVertexArray(0);
+	this->BatchSprite(texture, position, size, rotate, color);
+	this->DrawBatch();
 }
 
-void SpriteRenderer::initRenderData()
+void SpriteRenderer::BatchSprite(const Texture2D &texture, glm::vec2 position, glm::vec2 size, GLfloat rotate, glm::vec3 color)
 {
-	// Configure VAO/VBO
-	GLuint VBO;
-	GLfloat vertices[] = {
-			// Pos      // Tex
-			0.0f, 1.0f, 0.0f, 1.0f,
-			1.0f, 0.0f, 1.0f, 0.0f,
-			0.0f, 0.0f, 0.0f, 0.0f,
-
-			0.0f, 1.0f, 0.0f, 1.0f,
-			1.0f, 1.0f, 1.0f, 1.0f,
-			1.0f, 0.0f, 1.0f, 0.0f
-	};
-
-	glGenVertexArrays(1, &this->quadVAO);
-	glGenBuffers(1, &VBO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	if (!this->batch.empty() && texture.ID != this->batchTexture.ID)
+		this->DrawBatch();
+	this->batchTexture = texture;
+	// Corners of the unit quad, rotated around the sprite's center and then placed
+	static const GLfloat quad[6][2] = { { 0.0f, 1.0f }, { 1.0f, 0.0f }, { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f }, { 1.0f, 0.0f } };
+	GLfloat c = std::cos(rotate), s = std::sin(rotate);
+	glm::vec2 center = position + 0.5f * size;
+	for (const GLfloat *corner : quad)
+	{
+		glm::vec2 local = (glm::vec2(corner[0], corner[1]) - 0.5f) * size;
+		RenderBackend::Vertex vertex = {
+				center.x + local.x * c - local.y * s, center.y + local.x * s + local.y * c,
+				texture.UV.x + corner[0] * texture.UV.z, texture.UV.y + corner[1] * texture.UV.w,
+				color.x, color.y, color.z, 1.0f
+		};
+		this->batch.push_back(vertex);
+	}
+}
 
-	glBindVertexArray(this->quadVAO);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GL_FLOAT), (GLvoid*)0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+void SpriteRenderer::DrawBatch()
+{
+	if (this->batch.empty())
+		return;
+	this->backend.DrawTriangles(this->batchTexture, this->batch.data(), static_cast<GLsizei>(this->batch.size()), RenderBackend::BLEND_ALPHA);
+	this->batch.clear();
 }
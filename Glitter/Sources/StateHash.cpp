@@ -0,0 +1,44 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "StateHash.hpp"
+
+#include <cstring>
+
+// Instantiate static variables
+const char *const StateHash::FieldNames[StateHash::FIELDS] = { "game", "paddle", "balls", "bricks", "power-ups", "effects" };
+
+
+GLuint64 StateHash::Total() const
+{
+	GLuint64 total = 0;
+	for (GLuint i = 0; i < FIELDS; ++i)
+		Add(total, this->Fields[i]);
+	return total;
+}
+
+GLuint64 StateHash::Bits(GLfloat value)
+{
+	GLuint bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+GLuint64 StateHash::Bits(GLdouble value)
+{
+	GLuint64 bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+GLuint64 StateHash::Mix(GLuint64 value)
+{
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+	return value ^ (value >> 31);
+}
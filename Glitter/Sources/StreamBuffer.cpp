@@ -0,0 +1,155 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "StreamBuffer.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "GLState.hpp"
+#include "Profiler.hpp"
+
+// Instantiate static variables
+GLuint                            StreamBuffer::buffer = 0;
+GLsizeiptr                        StreamBuffer::capacity = 0;
+GLsizeiptr                        StreamBuffer::head = 0;
+GLsizeiptr                        StreamBuffer::frameBegin = 0;
+unsigned char                    *StreamBuffer::mapping = nullptr;
+std::deque<StreamBuffer::Fence>   StreamBuffer::fences;
+
+
+void StreamBuffer::Init(GLsizeiptr capacity)
+{
+	StreamBuffer::capacity = capacity;
+	head = frameBegin = 0;
+	glGenBuffers(1, &buffer);
+	GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+	if (GLAD_GL_VERSION_4_4)
+	{
+		// Coherent, so writes are visible to draw calls issued after them without any flushing
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, capacity, nullptr, flags);
+		mapping = static_cast<unsigned char*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, capacity, flags));
+		if (mapping == nullptr)
+			std::cout << "ERROR::STREAM_BUFFER: Failed to map the buffer persistently" << std::endl;
+	}
+	else
+		glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+}
+
+void StreamBuffer::Clear()
+{
+	for (const Fence &fence : fences)
+		glDeleteSync(fence.Sync);
+	fences.clear();
+	if (mapping != nullptr)
+	{
+		GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		mapping = nullptr;
+	}
+	GLState::DeleteBuffer(buffer);
+	buffer = 0;
+}
+
+GLuint StreamBuffer::Buffer()
+{
+	return buffer;
+}
+
+GLboolean StreamBuffer::Persistent()
+{
+	return mapping != nullptr;
+}
+
+GLintptr StreamBuffer::Write(const void *data, GLsizeiptr size, GLsizeiptr alignment)
+{
+	if (size >= capacity)
+	{
+		std::cout << "ERROR::STREAM_BUFFER: Write of " << size << " bytes exceeds the buffer" << std::endl;
+		return -1;
+	}
+	GLsizeiptr offset = (head + alignment - 1) / alignment * alignment;
+	GLboolean wrap = offset + size > capacity;
+	if (wrap)
+		offset = 0;
+	if (mapping != nullptr)
+	{
+		while (!available(offset, size))
+		{
+			if (fences.empty())
+			{
+				// The current frame alone filled the ring; nothing to do but let the GPU catch up
+				static GLboolean warned = GL_FALSE;
+				if (!warned)
+					std::cout << "ERROR::STREAM_BUFFER: A frame streams more than " << capacity << " bytes, stalling" << std::endl;
+				warned = GL_TRUE;
+				glFinish();
+				frameBegin = offset;
+				break;
+			}
+			retireOldest();
+		}
+		std::memcpy(mapping + offset, data, size);
+	}
+	else
+	{
+		GLState::BindBuffer(GL_ARRAY_BUFFER, buffer);
+		// Fresh storage on every wrap; the driver keeps the old one alive for the draw calls still using it
+		if (wrap)
+			glBufferData(GL_ARRAY_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+		// Nothing written since the last orphaning overlaps, so the write doesn't need to wait for the GPU
+		void *target = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (target == nullptr)
+			return -1;
+		std::memcpy(target, data, size);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
+	head = offset + size;
+	return offset;
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (mapping == nullptr || head == frameBegin)
+		return;
+	Fence fence = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), frameBegin };
+	fences.push_back(fence);
+	frameBegin = head;
+	// Drop the fences of frames the GPU already finished, without waiting
+	while (!fences.empty() && glClientWaitSync(fences.front().Sync, 0, 0) != GL_TIMEOUT_EXPIRED)
+	{
+		glDeleteSync(fences.front().Sync);
+		fences.pop_front();
+	}
+}
+
+GLboolean StreamBuffer::available(GLsizeiptr offset, GLsizeiptr size)
+{
+	// In use is the range from the oldest frame in flight up to head, possibly wrapping around the end
+	if (fences.empty() && frameBegin == head)
+		return GL_TRUE;
+	GLsizeiptr tail = fences.empty() ? frameBegin : fences.front().Begin;
+	// Writes never catch up with tail completely, so head == tail only ever means empty
+	if (tail <= head)
+		return offset >= head || offset + size < tail;
+	return offset >= head && offset + size < tail;
+}
+
+void StreamBuffer::retireOldest()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	GLenum result;
+	do
+		result = glClientWaitSync(fences.front().Sync, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000);
+	while (result == GL_TIMEOUT_EXPIRED);
+	glDeleteSync(fences.front().Sync);
+	fences.pop_front();
+	Profiler::AddTime("stream buffer stall", std::chrono::duration<GLdouble, std::milli>(std::chrono::steady_clock::now() - start).count());
+}
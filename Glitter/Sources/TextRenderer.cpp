@@ -10,75 +10,69 @@
 #include <ResourceManager.hpp>
 
 #include "TextRenderer.hpp"
+#include "GLState.hpp"
+#include "ResourcePack.hpp"
 
 
-TextRenderer::TextRenderer(GLuint width, GLuint height)
+TextRenderer::TextRenderer(RenderBackend &backend)
+	: backend(backend), fontSize(0), pixelScale(1.0f)
 {
-	this->TextShader = ResourceManager::LoadShader("Resource/text.vert", "Resource/text.frag", nullptr, "text");
-	this->TextShader.SetMatrix4("projection",
-			glm::ortho(0.0f,
-					static_cast<GLfloat>(width),
-					static_cast<GLfloat>(height),
-					0.0f,
-					-1.0f, 1.0f),
-					GL_TRUE);
-	this->TextShader.SetInteger("text", 0);
-
-	glGenVertexArrays(1, &this->VAO);
-	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, nullptr, GL_DYNAMIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-
 }
 
 void TextRenderer::RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color)
 {
-	this->TextShader.Use();
-	this->TextShader.SetVector3f("textColor", color);
-	glActiveTexture(GL_TEXTURE0);
-	glBindVertexArray(VAO);
+	// Glyphs are rasterized pixelScale times larger than their size in game units
+	scale /= this->pixelScale;
 
+	// Lay out all glyph quads first, so the whole string is handed to the backend at once
+	auto normalY = this->Characters['H'].Bearing.y;
+	this->vertices.clear();
+	this->glyphs.clear();
 	for(auto iter = text.cbegin(); iter != text.cend(); ++iter)
 	{
-		Character ch = Characters[*iter];
+		const Character &ch = this->Characters[*iter];
 
-		auto normalY = this->Characters['H'].Bearing.y;
 		GLfloat xpos = x + ch.Bearing.x * scale;
 		GLfloat ypos = y + (normalY - ch.Bearing.y) * scale;
 
 		GLfloat w = ch.Size.x * scale;
 		GLfloat h = ch.Size.y * scale;
 
-		GLfloat vertices[6][4] = {
-				{xpos,  ypos + h, 0.0, 1.0},
-				{xpos + w, ypos,  1.0, 0.0},
-				{xpos,  ypos,     0.0, 0.0},
+		RenderBackend::Vertex quad[6] = {
+				{xpos,  ypos + h, 0.0, 1.0, color.x, color.y, color.z, 1.0f},
+				{xpos + w, ypos,  1.0, 0.0, color.x, color.y, color.z, 1.0f},
+				{xpos,  ypos,     0.0, 0.0, color.x, color.y, color.z, 1.0f},
 
-				{ xpos,     ypos + h,   0.0, 1.0 },
-				{ xpos + w, ypos + h,   1.0, 1.0 },
-				{ xpos + w, ypos,       1.0, 0.0 },
+				{ xpos,     ypos + h,   0.0, 1.0, color.x, color.y, color.z, 1.0f },
+				{ xpos + w, ypos + h,   1.0, 1.0, color.x, color.y, color.z, 1.0f },
+				{ xpos + w, ypos,       1.0, 0.0, color.x, color.y, color.z, 1.0f },
 		};
-
-		glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		this->vertices.insert(this->vertices.end(), quad, quad + 6);
+		this->glyphs.push_back(ch.Texture);
 
 		x+= (ch.Advance >> 6) * scale;
 	}
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	if (this->glyphs.empty())
+		return;
+	this->backend.DrawGlyphs(this->glyphs.data(), this->vertices.data(), static_cast<GLsizei>(this->glyphs.size()));
+}
+
+void TextRenderer::SetPixelScale(GLfloat pixelScale)
+{
+	if (pixelScale == this->pixelScale)
+		return;
+	this->pixelScale = pixelScale;
+	if (!this->font.empty())
+		this->Load(this->font, this->fontSize);
 }
 
 void TextRenderer::Load(std::string font, GLuint fontSize)
 {
+	this->font = font;
+	this->fontSize = fontSize;
+	if (!Texture2D::Headless)
+		for (auto &iter : this->Characters)
+			GLState::DeleteTexture(iter.second.Texture.ID);
 	this->Characters.clear();
 
 	FT_Library ft;
@@ -88,17 +82,21 @@ void TextRenderer::Load(std::string font, GLuint fontSize)
 	}
 
 	FT_Face face;
+	// FreeType reads the font straight from the pack; data has to outlive the face
+	ResourceData data;
 //	if(FT_New_Face(ft, "Resource/方正粗圆_GBK_0.ttf", 0, &face))
-	if(FT_New_Face(ft, font.c_str(), 0, &face))
+	if(!ResourcePack::Read(font, data) || FT_New_Memory_Face(ft, data.Data, static_cast<FT_Long>(data.Size), 0, &face))
 	{
 		std::cout << "ERROR::FREETYPE: Failed to load font" << std::endl;
 	}
-	FT_Set_Pixel_Sizes(face, 0, 48);
+	FT_Set_Pixel_Sizes(face, 0, static_cast<FT_UInt>(48 * this->pixelScale + 0.5f));
 	if(FT_Load_Char(face, 'X', FT_LOAD_RENDER))
 	{
 		std::cout << "ERROR:FREETYPE: Failed to load Glyph" << std::endl;
 	}
-	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	// Glyph bitmaps are tightly packed single bytes
+	if (!Texture2D::Headless)
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 	for(uint c = 0; c<128; ++c)
 	{
 		if(FT_Load_Char(face, c, FT_LOAD_RENDER))
@@ -107,23 +105,12 @@ void TextRenderer::Load(std::string font, GLuint fontSize)
 			continue;
 		}
 
-		GLuint texture;
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glTexImage2D(GL_TEXTURE_2D,
-				0,
-				GL_RED,
-				face->glyph->bitmap.width,
-				face->glyph->bitmap.rows,
-				0,
-				GL_RED,
-				GL_UNSIGNED_BYTE,
-				face->glyph->bitmap.buffer
-				);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		Texture2D texture;
+		texture.Internal_Format = GL_RED;
+		texture.Image_Format = GL_RED;
+		texture.Wrap_S = GL_CLAMP_TO_EDGE;
+		texture.Wrap_T = GL_CLAMP_TO_EDGE;
+		texture.Generate(face->glyph->bitmap.width, face->glyph->bitmap.rows, face->glyph->bitmap.buffer);
 
 		Character character = {
 				texture,
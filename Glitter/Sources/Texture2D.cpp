@@ -9,31 +9,114 @@
 #include <iostream>
 
 #include "Texture2D.hpp"
+#include "GLState.hpp"
+
+
+// Instantiate static variables
+GLboolean                     Texture2D::Headless = GL_FALSE;
+std::vector<Texture2D::Image> Texture2D::images;
 
 
 Texture2D::Texture2D()
-    : Width(0), Height(0), Internal_Format(GL_RGB), Image_Format(GL_RGB), Wrap_S(GL_REPEAT), Wrap_T(GL_REPEAT), Filter_Min(GL_LINEAR), Filter_Max(GL_LINEAR)
+    : Width(0), Height(0), Internal_Format(GL_RGB), Image_Format(GL_RGB), Wrap_S(GL_REPEAT), Wrap_T(GL_REPEAT), Filter_Min(GL_LINEAR), Filter_Max(GL_LINEAR), UV(0.0f, 0.0f, 1.0f, 1.0f)
 {
-    glGenTextures(1, &this->ID);
+    // Headless textures get their ID once they have an image
+    if (Headless)
+        this->ID = 0;
+    else
+        glGenTextures(1, &this->ID);
 }
 
 void Texture2D::Generate(GLuint width, GLuint height, unsigned char* data)
 {
     this->Width = width;
     this->Height = height;
+    if (Headless)
+    {
+        this->store(width, height, data, this->Image_Format == GL_RGBA ? 4 : (this->Image_Format == GL_RGB ? 3 : 1));
+        return;
+    }
     // Create Texture
-    glBindTexture(GL_TEXTURE_2D, this->ID);
+    GLState::BindTexture(GL_TEXTURE_2D, this->ID);
     glTexImage2D(GL_TEXTURE_2D, 0, this->Internal_Format, width, height, 0, this->Image_Format, GL_UNSIGNED_BYTE, data);
     // Set Texture wrap and filter modes
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, this->Wrap_S);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, this->Wrap_T);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, this->Filter_Min);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, this->Filter_Max);
-    // Unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Texture2D::Generate(const CookedTexture &cooked)
+{
+    this->Width = cooked.Width;
+    this->Height = cooked.Height;
+    this->Internal_Format = cooked.InternalFormat;
+    this->Image_Format = GL_RGBA;
+    if (Headless)
+    {
+        // Only the top level is sampled, and decoding blocks is left to GL
+        if (cooked.Compressed())
+            std::cout << "ERROR::TEXTURE: Compressed textures need a GL context" << std::endl;
+        this->store(cooked.Width, cooked.Height, cooked.Compressed() ? nullptr : cooked.Levels[0], 4);
+        return;
+    }
+    GLState::BindTexture(GL_TEXTURE_2D, this->ID);
+    GLuint width = cooked.Width, height = cooked.Height;
+    for (GLuint level = 0; level < cooked.Levels.size(); ++level)
+    {
+        if (cooked.Compressed())
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, cooked.InternalFormat, width, height, 0, cooked.LevelSizes[level], cooked.Levels[level]);
+        else
+            glTexImage2D(GL_TEXTURE_2D, level, cooked.InternalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, cooked.Levels[level]);
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    // Trilinear filtering once there are mip levels to filter between
+    if (cooked.Levels.size() > 1 && this->Filter_Min == GL_LINEAR)
+        this->Filter_Min = GL_LINEAR_MIPMAP_LINEAR;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(cooked.Levels.size()) - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, this->Wrap_S);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, this->Wrap_T);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, this->Filter_Min);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, this->Filter_Max);
 }
 
 void Texture2D::Bind() const
 {
-    glBindTexture(GL_TEXTURE_2D, this->ID);
+    GLState::BindTexture(GL_TEXTURE_2D, this->ID);
+}
+
+const Texture2D::Image *Texture2D::Memory() const
+{
+    return Headless && this->ID > 0 && this->ID <= images.size() ? &images[this->ID - 1] : nullptr;
+}
+
+Texture2D::Image *Texture2D::Memory()
+{
+    return Headless && this->ID > 0 && this->ID <= images.size() ? &images[this->ID - 1] : nullptr;
+}
+
+void Texture2D::store(GLuint width, GLuint height, const unsigned char *data, GLuint channels)
+{
+    if (this->ID == 0)
+    {
+        images.push_back(Image());
+        this->ID = static_cast<GLuint>(images.size());
+    }
+    Image &image = images[this->ID - 1];
+    image.Width = width;
+    image.Height = height;
+    image.Pixels.assign(width * height * 4, 0);
+    if (data == nullptr)
+        return;
+    // Missing channels read like they do from a GL texture: green and blue 0, alpha 1
+    for (GLuint texel = 0; texel < width * height; ++texel)
+    {
+        unsigned char *target = &image.Pixels[texel * 4];
+        const unsigned char *source = data + texel * channels;
+        target[0] = source[0];
+        target[1] = channels >= 3 ? source[1] : 0;
+        target[2] = channels >= 3 ? source[2] : 0;
+        target[3] = channels == 4 ? source[3] : 255;
+    }
 }
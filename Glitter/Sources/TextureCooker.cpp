@@ -0,0 +1,254 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "TextureCooker.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "ResourcePack.hpp"
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+namespace
+{
+	const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+	const GLuint KTX_ENDIANNESS = 0x04030201;
+
+	// The thirteen 32 bit fields following the identifier
+	struct KtxHeader
+	{
+		GLuint Endianness, Type, TypeSize, Format, InternalFormat, BaseInternalFormat;
+		GLuint Width, Height, Depth, ArrayElements, Faces, MipmapLevels, KeyValueBytes;
+	};
+
+	GLuint padding4(size_t size)
+	{
+		return static_cast<GLuint>((4 - size % 4) % 4);
+	}
+}
+
+GLboolean CookedTexture::Compressed() const
+{
+	return this->InternalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || this->InternalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+void TextureCooker::Cook(const unsigned char *rgba, GLuint width, GLuint height, GLboolean alpha, GLuint maxLevels, CookedTexture &texture)
+{
+	GLboolean compress = Supported(alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT);
+	texture.InternalFormat = compress ? (alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT) : GL_RGBA8;
+	texture.Width = width;
+	texture.Height = height;
+	texture.Storage.clear();
+	texture.Levels.clear();
+	texture.LevelSizes.clear();
+
+	std::vector<unsigned char> level(rgba, rgba + width * height * 4), next;
+	std::vector<size_t> offsets;
+	for (GLuint w = width, h = height; ; )
+	{
+		offsets.push_back(texture.Storage.size());
+		if (compress)
+			TextureCooker::compress(level, w, h, alpha, texture.Storage);
+		else
+			texture.Storage.insert(texture.Storage.end(), level.begin(), level.end());
+		texture.LevelSizes.push_back(static_cast<GLsizei>(texture.Storage.size() - offsets.back()));
+		if ((w == 1 && h == 1) || offsets.size() == maxLevels)
+			break;
+		downsample(level, w, h, next);
+		level.swap(next);
+		w = std::max(1u, w / 2);
+		h = std::max(1u, h / 2);
+	}
+	// Only take pointers once Storage stopped growing
+	for (size_t offset : offsets)
+		texture.Levels.push_back(texture.Storage.data() + offset);
+}
+
+void TextureCooker::downsample(const std::vector<unsigned char> &source, GLuint width, GLuint height, std::vector<unsigned char> &target)
+{
+	GLuint w = std::max(1u, width / 2), h = std::max(1u, height / 2);
+	target.resize(w * h * 4);
+	for (GLuint y = 0; y < h; ++y)
+	{
+		// Clamp to the source so odd and 1 pixel wide/high levels work too
+		GLuint y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+		for (GLuint x = 0; x < w; ++x)
+		{
+			GLuint x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			for (GLuint c = 0; c < 4; ++c)
+			{
+				GLuint sum = source[(y0 * width + x0) * 4 + c] + source[(y0 * width + x1) * 4 + c] +
+				             source[(y1 * width + x0) * 4 + c] + source[(y1 * width + x1) * 4 + c];
+				target[(y * w + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+void TextureCooker::compress(const std::vector<unsigned char> &rgba, GLuint width, GLuint height, GLboolean alpha, std::vector<unsigned char> &blocks)
+{
+	unsigned char block[16 * 4];
+	unsigned char compressed[16];
+	GLuint blockBytes = alpha ? 16 : 8;
+	for (GLuint by = 0; by < height; by += 4)
+	{
+		for (GLuint bx = 0; bx < width; bx += 4)
+		{
+			// Blocks hanging over the edge repeat the last row/column
+			for (GLuint y = 0; y < 4; ++y)
+				for (GLuint x = 0; x < 4; ++x)
+				{
+					GLuint sx = std::min(bx + x, width - 1), sy = std::min(by + y, height - 1);
+					std::memcpy(&block[(y * 4 + x) * 4], &rgba[(sy * width + sx) * 4], 4);
+				}
+			stb_compress_dxt_block(compressed, block, alpha ? 1 : 0, STB_DXT_HIGHQUAL);
+			blocks.insert(blocks.end(), compressed, compressed + blockBytes);
+		}
+	}
+}
+
+GLboolean TextureCooker::Load(const std::string &path, CookedTexture &texture)
+{
+	ResourceData data;
+	if (!ResourcePack::Read(path, data))
+		return GL_FALSE;
+	// Packed files are parsed in place, loose ones keep their contents in Storage
+	texture.Storage.swap(data.Storage);
+	return Parse(data.Data, data.Size, texture);
+}
+
+GLboolean TextureCooker::Parse(const unsigned char *data, size_t size, CookedTexture &texture)
+{
+	KtxHeader header;
+	if (size < sizeof(KTX_IDENTIFIER) + sizeof(header) || std::memcmp(data, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0)
+		return GL_FALSE;
+	std::memcpy(&header, data + sizeof(KTX_IDENTIFIER), sizeof(header));
+	// Files are only ever read back on the kind of machine that cooked them
+	if (header.Endianness != KTX_ENDIANNESS || header.Depth != 0 || header.ArrayElements != 0 || header.Faces != 1 || header.MipmapLevels == 0)
+		return GL_FALSE;
+	texture.InternalFormat = header.InternalFormat;
+	texture.Width = header.Width;
+	texture.Height = header.Height;
+	texture.Metadata.clear();
+	texture.Levels.clear();
+	texture.LevelSizes.clear();
+
+	size_t offset = sizeof(KTX_IDENTIFIER) + sizeof(header);
+	size_t keyValueEnd = offset + header.KeyValueBytes;
+	if (keyValueEnd > size)
+		return GL_FALSE;
+	while (offset + 4 <= keyValueEnd)
+	{
+		GLuint bytes;
+		std::memcpy(&bytes, data + offset, 4);
+		offset += 4;
+		if (offset + bytes > keyValueEnd)
+			return GL_FALSE;
+		// key\0value\0
+		const char *pair = reinterpret_cast<const char*>(data + offset);
+		const char *keyEnd = std::find(pair, pair + bytes, '\0');
+		if (keyEnd != pair + bytes)
+			texture.Metadata[std::string(pair, keyEnd)] = std::string(keyEnd + 1, std::find(keyEnd + 1, pair + bytes, '\0'));
+		offset += bytes + padding4(bytes);
+	}
+	offset = keyValueEnd;
+
+	for (GLuint level = 0; level < header.MipmapLevels; ++level)
+	{
+		GLuint bytes;
+		if (offset + 4 > size)
+			return GL_FALSE;
+		std::memcpy(&bytes, data + offset, 4);
+		offset += 4;
+		if (offset + bytes > size)
+			return GL_FALSE;
+		texture.Levels.push_back(data + offset);
+		texture.LevelSizes.push_back(static_cast<GLsizei>(bytes));
+		offset += bytes + padding4(bytes);
+	}
+	return GL_TRUE;
+}
+
+GLboolean TextureCooker::Save(const std::string &path, const CookedTexture &texture)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.good())
+	{
+		std::cout << "ERROR::TEXTURECOOKER: Failed to write " << path << std::endl;
+		return GL_FALSE;
+	}
+	const char zeros[4] = { 0, 0, 0, 0 };
+	std::string keyValues;
+	for (auto &iter : texture.Metadata)
+	{
+		std::string pair = iter.first + '\0' + iter.second + '\0';
+		GLuint bytes = static_cast<GLuint>(pair.size());
+		keyValues.append(reinterpret_cast<const char*>(&bytes), 4);
+		keyValues += pair;
+		keyValues.append(zeros, padding4(pair.size()));
+	}
+
+	GLboolean compressed = texture.Compressed();
+	KtxHeader header;
+	header.Endianness = KTX_ENDIANNESS;
+	header.Type = compressed ? 0 : GL_UNSIGNED_BYTE;
+	header.TypeSize = 1;
+	header.Format = compressed ? 0 : GL_RGBA;
+	header.InternalFormat = texture.InternalFormat;
+	header.BaseInternalFormat = texture.InternalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? GL_RGB : GL_RGBA;
+	header.Width = texture.Width;
+	header.Height = texture.Height;
+	header.Depth = header.ArrayElements = 0;
+	header.Faces = 1;
+	header.MipmapLevels = static_cast<GLuint>(texture.Levels.size());
+	header.KeyValueBytes = static_cast<GLuint>(keyValues.size());
+
+	file.write(reinterpret_cast<const char*>(KTX_IDENTIFIER), sizeof(KTX_IDENTIFIER));
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(keyValues.data(), keyValues.size());
+	for (GLuint level = 0; level < texture.Levels.size(); ++level)
+	{
+		GLuint bytes = static_cast<GLuint>(texture.LevelSizes[level]);
+		file.write(reinterpret_cast<const char*>(&bytes), 4);
+		file.write(reinterpret_cast<const char*>(texture.Levels[level]), bytes);
+		file.write(zeros, padding4(bytes));
+	}
+	return file.good() ? GL_TRUE : GL_FALSE;
+}
+
+GLboolean TextureCooker::Supported(GLuint internalFormat)
+{
+	if (internalFormat == GL_RGBA8)
+		return GL_TRUE;
+	// Ask the driver once which compressed formats it offers
+	static std::vector<GLint> formats;
+	static GLboolean queried = GL_FALSE;
+	if (!queried)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+		formats.resize(count);
+		if (count > 0)
+			glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+		queried = GL_TRUE;
+	}
+	return std::find(formats.begin(), formats.end(), static_cast<GLint>(internalFormat)) != formats.end() ? GL_TRUE : GL_FALSE;
+}
+
+size_t TextureCooker::MemorySize(const CookedTexture &texture)
+{
+	size_t bytes = 0;
+	for (GLsizei size : texture.LevelSizes)
+		bytes += size;
+	return bytes;
+}
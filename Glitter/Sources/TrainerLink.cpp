@@ -0,0 +1,205 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "TrainerLink.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "PowerUp.hpp"
+
+// Futex words have to be plain 32-bit integers
+static_assert(sizeof(std::atomic<GLuint>) == sizeof(GLuint) && ATOMIC_INT_LOCK_FREE == 2, "Counters have to be lock-free 32-bit words");
+
+// Timer of each power-up type, TIMED_EFFECTS for those that take effect once
+static const TimedEffect typeEffects[TrainerLink::POWER_UP_TYPES] = { TIMED_EFFECTS, EFFECT_STICKY, EFFECT_PASS_THROUGH, TIMED_EFFECTS, EFFECT_CONFUSE, EFFECT_CHAOS };
+
+TrainerLink::TrainerLink()
+	: fd(-1), memory(nullptr), size(0), header(nullptr), observations(nullptr), actions(nullptr), games(0), step(0)
+{
+}
+
+TrainerLink::~TrainerLink()
+{
+#ifdef __linux__
+	if (this->memory != nullptr)
+		munmap(this->memory, this->size);
+	if (this->fd >= 0)
+	{
+		close(this->fd);
+		shm_unlink(this->name.c_str());
+	}
+#endif
+}
+
+GLboolean TrainerLink::Open(const std::string &name, GLuint games, GLfloat tick)
+{
+#ifdef __linux__
+	this->name = name.empty() || name[0] != '/' ? "/" + name : name;
+	this->games = games;
+	// A segment left behind by a session that crashed is replaced
+	shm_unlink(this->name.c_str());
+	this->fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (this->fd < 0)
+	{
+		std::cout << "ERROR::TRAINER: Failed to create shared memory " << this->name << std::endl;
+		return GL_FALSE;
+	}
+	// Records are multiples of 64 bytes, so every part starts on a cache line
+	size_t observationsSize = sizeof(Observation) * SLOTS * games;
+	size_t actionsSize = (sizeof(Action) * SLOTS * games + 63) / 64 * 64;
+	this->size = sizeof(Header) + observationsSize + actionsSize;
+	if (ftruncate(this->fd, this->size) != 0)
+	{
+		std::cout << "ERROR::TRAINER: Failed to size shared memory " << this->name << std::endl;
+		return GL_FALSE;
+	}
+	this->memory = mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+	if (this->memory == MAP_FAILED)
+	{
+		this->memory = nullptr;
+		std::cout << "ERROR::TRAINER: Failed to map shared memory " << this->name << std::endl;
+		return GL_FALSE;
+	}
+	unsigned char *bytes = static_cast<unsigned char*>(this->memory);
+	// The segment starts out zeroed: no step published, no actions
+	this->header = new (bytes) Header();
+	this->observations = reinterpret_cast<Observation*>(bytes + sizeof(Header));
+	this->actions = reinterpret_cast<Action*>(bytes + sizeof(Header) + observationsSize);
+	this->header->Version = VERSION;
+	this->header->Games = games;
+	this->header->Slots = SLOTS;
+	this->header->MaxBalls = MAX_BALLS;
+	this->header->MaxBricks = MAX_BRICKS;
+	this->header->MaxPowerUps = MAX_POWER_UPS;
+	this->header->ObservationSize = sizeof(Observation);
+	this->header->ActionSize = sizeof(Action);
+	this->header->Tick = tick;
+	// Trainers check the magic number last, once everything else is in place
+	std::atomic_thread_fence(std::memory_order_release);
+	this->header->Magic = MAGIC;
+	this->step = 0;
+	return GL_TRUE;
+#else
+	std::cout << "ERROR::TRAINER: The trainer link needs POSIX shared memory and futexes (Linux)" << std::endl;
+	return GL_FALSE;
+#endif
+}
+
+void TrainerLink::Write(GLuint game, const Game &state)
+{
+	Observation &record = this->observations[(this->step % SLOTS) * this->games + game];
+	record.Step = this->step;
+	record.State = state.State;
+	record.Level = state.Level;
+	record.Lives = state.Lives;
+	record.Paddle[0] = ToFloat(state.Player.Position.x);
+	record.Paddle[1] = ToFloat(state.Player.Position.y);
+	record.Paddle[2] = ToFloat(state.Player.Size.x);
+	record.Paddle[3] = ToFloat(state.Player.Size.y);
+
+	const BallBatch &balls = state.Balls;
+	record.BallCount = std::min(balls.Count(), MAX_BALLS);
+	record.StuckBalls = 0;
+	record.BallRadius = ToFloat(balls.Radius);
+	for (GLuint i = 0; i < record.BallCount; ++i)
+	{
+		record.Balls[i][0] = ToFloat(balls.PosX[i]);
+		record.Balls[i][1] = ToFloat(balls.PosY[i]);
+		record.Balls[i][2] = ToFloat(balls.VelX[i]);
+		record.Balls[i][3] = ToFloat(balls.VelY[i]);
+		if (balls.Stuck[i])
+			record.StuckBalls |= 1u << i;
+	}
+
+	record.Effects = 0;
+	std::fill(record.EffectTime, record.EffectTime + POWER_UP_TYPES, 0.0f);
+	for (GLuint type = 0; type < POWER_UP_TYPES; ++type)
+	{
+		if (typeEffects[type] == TIMED_EFFECTS || !state.Timers.Active(typeEffects[type]))
+			continue;
+		record.Effects |= 1u << type;
+		record.EffectTime[type] = static_cast<GLfloat>(state.Timers.Remaining(typeEffects[type], state.Clock));
+	}
+	// PowerUps is ordered top to bottom
+	record.FallingCount = 0;
+	for (std::deque<PowerUp>::const_reverse_iterator powerUp = state.PowerUps.rbegin();
+	     powerUp != state.PowerUps.rend() && record.FallingCount < MAX_POWER_UPS; ++powerUp)
+	{
+		if (powerUp->Destroyed)
+			continue;
+		GLfloat *falling = record.Falling[record.FallingCount++];
+		falling[0] = ToFloat(powerUp->Position.x);
+		falling[1] = ToFloat(powerUp->Position.y);
+		falling[2] = static_cast<GLfloat>(powerUp->TypeIndex);
+	}
+
+	const std::vector<GameObject> &bricks = state.Levels[state.Level].Bricks;
+	record.BrickCount = std::min(static_cast<GLuint>(bricks.size()), MAX_BRICKS);
+	std::memset(record.Standing, 0, sizeof(record.Standing));
+	for (GLuint i = 0; i < record.BrickCount; ++i)
+		if (!bricks[i].Destroyed)
+			record.Standing[i / 64] |= static_cast<GLuint64>(1) << (i % 64);
+}
+
+void TrainerLink::Publish()
+{
+	signal(this->header->Published, this->step + 1);
+}
+
+GLboolean TrainerLink::WaitForActions()
+{
+	wait(this->header->Acted, this->step);
+	++this->step;
+	return this->header->Stop.load(std::memory_order_acquire) == 0;
+}
+
+const TrainerLink::Action &TrainerLink::Actions(GLuint game) const
+{
+	return this->actions[((this->step - 1) % SLOTS) * this->games + game];
+}
+
+void TrainerLink::wait(Counter &counter, GLuint value)
+{
+	// A trainer answering within microseconds never costs a system call
+	for (GLuint spin = 0; spin < 100000; ++spin)
+	{
+		if (counter.Value.load(std::memory_order_acquire) != value)
+			return;
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#endif
+	}
+#ifdef __linux__
+	// Sequentially consistent, so either the signalling side sees the sleeper or the sleeper sees the new value
+	counter.Sleepers.fetch_add(1, std::memory_order_seq_cst);
+	while (counter.Value.load(std::memory_order_seq_cst) == value)
+		syscall(SYS_futex, reinterpret_cast<GLuint*>(&counter.Value), FUTEX_WAIT, value, nullptr, nullptr, 0);
+	counter.Sleepers.fetch_sub(1, std::memory_order_seq_cst);
+#endif
+}
+
+void TrainerLink::signal(Counter &counter, GLuint value)
+{
+	counter.Value.store(value, std::memory_order_seq_cst);
+#ifdef __linux__
+	if (counter.Sleepers.load(std::memory_order_seq_cst) > 0)
+		syscall(SYS_futex, reinterpret_cast<GLuint*>(&counter.Value), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
@@ -0,0 +1,128 @@
+/*******************************************************************
+** This code is part of Breakout.
+**
+** Breakout is free software: you can redistribute it and/or modify
+** it under the terms of the CC BY 4.0 license as published by
+** Creative Commons, either version 4 of the License, or (at your
+** option) any later version.
+******************************************************************/
+#include "UdpTransport.hpp"
+
+#include <iostream>
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+
+UdpTransport::UdpTransport()
+	: Latency(0.0), Loss(0.0), Sent(0), Dropped(0), Received(0), socket(-1), port(0), peerPort(0)
+{
+}
+
+UdpTransport::~UdpTransport()
+{
+#ifdef __linux__
+	if (this->socket >= 0)
+		close(this->socket);
+#endif
+}
+
+GLboolean UdpTransport::Open(GLushort port, GLushort peerPort)
+{
+#ifdef __linux__
+	this->socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+	if (this->socket < 0)
+	{
+		std::cout << "ERROR::TRANSPORT: Failed to create a UDP socket" << std::endl;
+		return GL_FALSE;
+	}
+	fcntl(this->socket, F_SETFL, fcntl(this->socket, F_GETFL) | O_NONBLOCK);
+	sockaddr_in address = sockaddr_in();
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(port);
+	socklen_t length = sizeof(address);
+	if (bind(this->socket, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+	    getsockname(this->socket, reinterpret_cast<sockaddr*>(&address), &length) != 0)
+	{
+		std::cout << "ERROR::TRANSPORT: Failed to bind UDP port " << port << std::endl;
+		return GL_FALSE;
+	}
+	this->port = ntohs(address.sin_port);
+	this->peerPort = peerPort;
+	this->random.seed(this->port);
+	return GL_TRUE;
+#else
+	std::cout << "ERROR::TRANSPORT: The UDP transport needs BSD sockets (Linux)" << std::endl;
+	return GL_FALSE;
+#endif
+}
+
+void UdpTransport::SetPeer(GLushort peerPort)
+{
+	this->peerPort = peerPort;
+}
+
+void UdpTransport::Send(const void *data, GLuint size)
+{
+	++this->Sent;
+	if (this->Loss > 0.0 && std::uniform_real_distribution<GLdouble>(0.0, 1.0)(this->random) < this->Loss)
+		++this->Dropped;
+	else if (this->Latency <= 0.0)
+		this->transmit(data, size);
+	else
+	{
+		// All datagrams are delayed by the same time, so the queue stays ordered by Due
+		const unsigned char *bytes = static_cast<const unsigned char*>(data);
+		Delayed datagram;
+		datagram.Due = std::chrono::steady_clock::now() + std::chrono::microseconds(static_cast<long long>(this->Latency * 1000.0));
+		datagram.Data.assign(bytes, bytes + size);
+		this->delayed.push_back(datagram);
+	}
+	this->Flush();
+}
+
+GLuint UdpTransport::Receive(void *data, GLuint capacity)
+{
+	this->Flush();
+#ifdef __linux__
+	if (this->socket < 0)
+		return 0;
+	ssize_t size = recv(this->socket, data, capacity, 0);
+	if (size <= 0)
+		return 0;
+	++this->Received;
+	return static_cast<GLuint>(size);
+#else
+	return 0;
+#endif
+}
+
+void UdpTransport::Flush()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	while (!this->delayed.empty() && this->delayed.front().Due <= now)
+	{
+		this->transmit(this->delayed.front().Data.data(), static_cast<GLuint>(this->delayed.front().Data.size()));
+		this->delayed.pop_front();
+	}
+}
+
+void UdpTransport::transmit(const void *data, GLuint size)
+{
+#ifdef __linux__
+	if (this->socket < 0)
+		return;
+	sockaddr_in address = sockaddr_in();
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = htons(this->peerPort);
+	// A full socket buffer drops the datagram like the network would
+	sendto(this->socket, data, size, 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+#endif
+}
@@ -6,93 +6,886 @@
 #include <GLFW/glfw3.h>
 
 // Standard Headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <thread>
 
 #include "Game.hpp"
 #include "ResourceManager.hpp"
-#include "Game.hpp"
+#include "ResourcePack.hpp"
+#include "StreamBuffer.hpp"
+#include "FrameUniforms.hpp"
+#include "GLState.hpp"
+#include "HeadlessContext.hpp"
+#include "JobSystem.hpp"
+#include "Profiler.hpp"
+#include "TripleBuffer.hpp"
+#include "FrameCapture.hpp"
+#include "ObservationRenderer.hpp"
+#include "TrainerLink.hpp"
+#include "RollbackSession.hpp"
+#include "UdpTransport.hpp"
+#include "SoftwareBackend.hpp"
+#include "Texture2D.hpp"
+
+
+// A key event of a scripted session, applied at the start of the given frame
+struct ScriptEvent {
+    GLuint Frame;
+    GLint  Key, Action;
+};
 
+// How networked versus games treat the connection: simulated one-way latency in ms, share of packets lost (0 to 1)
+// and the most ticks a side may run ahead of its peer's inputs
+struct NetworkSettings {
+    GLdouble Latency, Loss;
+    GLuint   Rollback;
+};
 
 // GLFW function declerations
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
+void framebuffer_size_callback(GLFWwindow* window, int width, int height);
+// Game loops
+void runSingleThreaded(GLFWwindow* window);
+void runThreaded(GLFWwindow* window);
+// Plays a scripted session with a fixed time step into an offscreen framebuffer, see FrameCapture; false if the capture could not be written
+GLboolean runCapture(FrameCapture& capture, GLuint frames, const std::vector<ScriptEvent>& script);
+// Plays a scripted session with a fixed time step without rendering and writes every tick's StateHash to a state log
+GLboolean runStateLog(const char* file, GLuint frames, const std::vector<ScriptEvent>& script);
+// Reports the first tick at which two state logs differ and in which fields; true if they agree
+GLboolean compareStateLogs(const char* first, const char* second);
+// Steps many simulation-only games with random input for the given number of frames and renders their observations; false if they do not all fit into one render target
+GLboolean runObservations(GLuint games, GLuint frames);
+// Steps simulation-only games with random input for the given number of frames without rendering and prints the throughput
+void runSimulation(GLuint games, GLuint frames);
+// Steps simulation-only games with the actions of a trainer process connected through shared memory, see TrainerLink
+GLboolean runTrainer(const char* name, GLuint games);
+// Plays one side of a versus game against a peer on another local port in the window, see RollbackSession
+GLboolean runVersus(GLFWwindow* window, GLuint player, GLushort port, GLushort peerPort, const NetworkSettings& network);
+// Plays both sides of a versus game over localhost with random input until frames ticks are confirmed, then reports
+// the rollback statistics; false if the sides went out of sync or never confirmed that many ticks
+GLboolean runVersusTest(GLuint frames, const NetworkSettings& network);
+// Creates simulation-only games that share the resources Breakout loaded, already past the menu
+std::vector<std::unique_ptr<Game>> createGames(GLuint count);
+// Queues key events that hold key (and only key; 0 for none) down during the tick starting at time
+void holdKey(Game& game, GLint key, GLdouble time);
+// Reads a session script: one "<frame> press|release <key>" per line, keys named like SPACE, ENTER, LEFT or A
+GLboolean parseScript(std::istream& source, std::vector<ScriptEvent>& script);
+// Reports key press to present latency once a presented frame reflects a press
+void probeInputLatency(const FrameSnapshot& frame);
 
-// The Width of the screen
+// The Width of the screen (in game units, the initial window size in screen coordinates)
 const GLuint SCREEN_WIDTH = 800;
 // The height of the screen
 const GLuint SCREEN_HEIGHT = 600;
+// Fixed simulation step of the threaded mode
+const GLfloat SIM_TICK = 1.0f / 120.0f;
+// Fixed time step of captured sessions
+const GLfloat CAPTURE_TICK = 1.0f / 60.0f;
+// Size of one observation in pixels
+const GLuint OBSERVATION_SIZE = 84;
+// Session captured when no script is given: start, move, launch the ball and play for a while
+const char *DEFAULT_SCRIPT =
+    "30 press ENTER\n32 release ENTER\n"
+    "60 press D\n90 release D\n"
+    "100 press SPACE\n102 release SPACE\n"
+    "200 press A\n260 release A\n"
+    "400 press D\n430 release D\n";
 
 Game Breakout(SCREEN_WIDTH, SCREEN_HEIGHT);
 
 int main(int argc, char * argv[]) {
 
-    // Load GLFW and Create a Window
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-    auto mWindow = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "OpenGL", nullptr, nullptr);
-
-    // Check for Valid Context
-    if (mWindow == nullptr) {
-        fprintf(stderr, "Failed to Create OpenGL Context");
+    // Command line options
+    GLboolean threaded = GL_FALSE;
+    const char *pack = "Resource.pack";
+    GLuint captureFrames = 0;
+    GLuint observeGames = 0, observeFrames = 0;
+    const char *trainerName = nullptr;
+    GLuint trainerGames = 0;
+    GLuint simulateGames = 0, simulateFrames = 0;
+    GLuint stateFrames = 0;
+    GLint versusPlayer = -1;
+    GLushort versusPort = 0, versusPeerPort = 0;
+    GLuint versusTestFrames = 0;
+    NetworkSettings network = { 0.0, 0.0, 8 };
+    GLint jobThreads = -1;
+    const char *stateFile = nullptr;
+    const char *captureDirectory = nullptr, *golden = nullptr, *scriptFile = nullptr;
+    GLuint captureEvery = 60;
+    GLint tolerance = 2;
+    for (int i = 1; i < argc; ++i)
+    {
+        // Packs the files listed after the output path and exits
+        if (strcmp(argv[i], "--build-pack") == 0 && i + 1 < argc)
+            return ResourcePack::Build(argv[i + 1], std::vector<std::string>(argv + i + 2, argv + argc)) ? EXIT_SUCCESS : EXIT_FAILURE;
+        // Compares two state logs and exits
+        else if (strcmp(argv[i], "--desync") == 0 && i + 2 < argc)
+            return compareStateLogs(argv[i + 1], argv[i + 2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+        else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+            pack = argv[++i];
+        else if (strcmp(argv[i], "--profile") == 0)
+            Profiler::Enabled = GL_TRUE;
+        else if (strcmp(argv[i], "--threaded") == 0)
+            threaded = GL_TRUE;
+        else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc)
+            Breakout.BallCount = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc)
+            Breakout.ParticleCount = std::max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc)
+            jobThreads = std::max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--msaa") == 0 && i + 1 < argc)
+            Breakout.Samples = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--render-scale") == 0 && i + 1 < argc)
+            Breakout.RenderScale = static_cast<GLfloat>(atof(argv[++i]));
+        else if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc)
+            Breakout.TargetGpuTime = static_cast<GLfloat>(atof(argv[++i]));
+        else if (strcmp(argv[i], "--raw-textures") == 0)
+            ResourceManager::CookTextures = GL_FALSE;
+        else if (strcmp(argv[i], "--recook") == 0)
+            ResourceManager::Recook = GL_TRUE;
+        else if (strcmp(argv[i], "--watch") == 0)
+            Breakout.HotReload = GL_TRUE;
+        else if (strcmp(argv[i], "--capture") == 0 && i + 2 < argc)
+        {
+            captureFrames = std::max(1, atoi(argv[++i]));
+            captureDirectory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--capture-every") == 0 && i + 1 < argc)
+            captureEvery = std::max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            golden = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+            tolerance = std::max(0, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+            scriptFile = argv[++i];
+        else if (strcmp(argv[i], "--software") == 0)
+            Breakout.Software = GL_TRUE;
+        else if (strcmp(argv[i], "--observe") == 0 && i + 2 < argc)
+        {
+            observeGames = std::max(1, atoi(argv[++i]));
+            observeFrames = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--trainer") == 0 && i + 2 < argc)
+        {
+            trainerName = argv[++i];
+            trainerGames = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--state-log") == 0 && i + 2 < argc)
+        {
+            stateFrames = std::max(1, atoi(argv[++i]));
+            stateFile = argv[++i];
+        }
+        else if (strcmp(argv[i], "--simulate") == 0 && i + 2 < argc)
+        {
+            simulateGames = std::max(1, atoi(argv[++i]));
+            simulateFrames = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--versus") == 0 && i + 3 < argc)
+        {
+            versusPlayer = std::min(std::max(atoi(argv[++i]), 1), 2) - 1;
+            versusPort = static_cast<GLushort>(atoi(argv[++i]));
+            versusPeerPort = static_cast<GLushort>(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--versus-test") == 0 && i + 1 < argc)
+            versusTestFrames = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--latency") == 0 && i + 1 < argc)
+            network.Latency = std::max(0.0, atof(argv[++i]));
+        else if (strcmp(argv[i], "--loss") == 0 && i + 1 < argc)
+            network.Loss = std::min(std::max(atof(argv[++i]), 0.0), 100.0) / 100.0;
+        else if (strcmp(argv[i], "--rollback") == 0 && i + 1 < argc)
+            network.Rollback = std::min(std::max(atoi(argv[++i]), 1), static_cast<int>(RollbackSession::MAX_ROLLBACK));
+    }
+    // The software backend has no window to draw into, it only renders captures
+    if (Breakout.Software && captureFrames == 0)
+    {
+        fprintf(stderr, "--software needs --capture\n");
         return EXIT_FAILURE;
     }
+    // Captures and state logs play a scripted session
+    std::vector<ScriptEvent> script;
+    if (captureFrames > 0 || stateFrames > 0)
+    {
+        std::ifstream scriptSource;
+        std::istringstream defaultSource(DEFAULT_SCRIPT);
+        if (scriptFile != nullptr)
+            scriptSource.open(scriptFile);
+        if (!parseScript(scriptFile != nullptr ? static_cast<std::istream&>(scriptSource) : defaultSource, script))
+        {
+            fprintf(stderr, "Failed to read session script %s\n", scriptFile);
+            return EXIT_FAILURE;
+        }
+    }
+    // Trainers only get the games' state; simulation benchmarks, state logs and versus tests render nothing
+    if (trainerGames > 0 || simulateGames > 0 || stateFrames > 0 || versusTestFrames > 0)
+        Breakout.Software = GL_TRUE;
+    // Captured frames have to come out the same on every run
+    if (captureFrames > 0)
+    {
+        Breakout.TargetGpuTime = 0.0f;
+        Breakout.HotReload = GL_FALSE;
+    }
+
+    GLFWwindow *mWindow = nullptr;
+    // Captures and observations never show anything, so they render without a window or display server
+    HeadlessContext headless;
+    GLboolean windowless = !Breakout.Software && (captureFrames > 0 || observeGames > 0);
+    if (Breakout.Software)
+    {
+        // Textures stay in memory for the rasterizer; cooked textures are GPU formats
+        Texture2D::Headless = GL_TRUE;
+        ResourceManager::CookTextures = GL_FALSE;
+        Breakout.Resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+    }
+    else if (windowless)
+    {
+        if (!headless.Create())
+            return EXIT_FAILURE;
+        fprintf(stderr, "OpenGL %s (headless)\n", glGetString(GL_VERSION));
+        // Rendered at the game's own size, independent of any screen
+        Breakout.Resize(SCREEN_WIDTH, SCREEN_HEIGHT);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_BLEND);
+        GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    else
+    {
+        // Load GLFW and Create a Window
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
+        mWindow = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "OpenGL", nullptr, nullptr);
+
+        // Check for Valid Context
+        if (mWindow == nullptr) {
+            fprintf(stderr, "Failed to Create OpenGL Context");
+            return EXIT_FAILURE;
+        }
+
+        // Create Context and Load OpenGL Functions
+        glfwMakeContextCurrent(mWindow);
+        gladLoadGL();
+        fprintf(stderr, "OpenGL %s\n", glGetString(GL_VERSION));
+
 
-    // Create Context and Load OpenGL Functions
-    glfwMakeContextCurrent(mWindow);
-    gladLoadGL();
-    fprintf(stderr, "OpenGL %s\n", glGetString(GL_VERSION));
+        glfwSetKeyCallback(mWindow, key_callback);
+        glfwSetFramebufferSizeCallback(mWindow, framebuffer_size_callback);
 
+        // OpenGL configuration
+        // On high-DPI screens the framebuffer has more pixels than the window has screen coordinates
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(mWindow, &framebufferWidth, &framebufferHeight);
+        Breakout.Resize(framebufferWidth, framebufferHeight);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_BLEND);
+        GLState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
 
-    glfwSetKeyCallback(mWindow, key_callback);
+    // Serve resources from the pack if there is one, loose files otherwise; hot reloading edits the loose files
+    if (!Breakout.HotReload && ResourcePack::Open(pack))
+        fprintf(stderr, "Resources from %s\n", pack);
 
-    // OpenGL configuration
-    glViewport(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // Run the update stages on a work-stealing pool; it has to exist before Init hands it to the particles
+    std::unique_ptr<JobSystem> jobs;
+    if (jobThreads >= 0)
+    {
+        jobs.reset(new JobSystem(jobThreads));
+        Breakout.Jobs = jobs.get();
+        fprintf(stderr, "Update stages on %u threads\n", jobs->Threads());
+    }
 
     // Initialize game
     Breakout.Init();
-
-    // DeltaTime variables
-    GLfloat deltaTime = 0.0f;
-    GLfloat lastFrame = 0.0f;
+    if (Profiler::Enabled)
+        printf("PROFILER: textures loaded in %.1f ms, %.1f MiB of video memory\n",
+               ResourceManager::TextureLoadTime, ResourceManager::TextureMemory / (1024.0 * 1024.0));
 
     // Start Game within Menu State
     Breakout.State = GAME_MENU;
 
-    while (!glfwWindowShouldClose(mWindow))
+    int status = EXIT_SUCCESS;
+    if (captureFrames > 0)
+    {
+        FrameCapture capture(SCREEN_WIDTH, SCREEN_HEIGHT, Breakout.Rasterizer);
+        capture.Directory = captureDirectory;
+        capture.Golden = golden != nullptr ? golden : "";
+        capture.Every = captureEvery;
+        capture.Tolerance = tolerance;
+        if (runCapture(capture, captureFrames, script))
+        {
+            printf("CAPTURE: %u frames written to %s", captureFrames, captureDirectory);
+            if (golden != nullptr)
+                printf(", %u images differ from %s", capture.Failures, golden);
+            printf("\n");
+        }
+        if (capture.Failures > 0)
+            status = EXIT_FAILURE;
+    }
+    else if (stateFrames > 0)
+        status = runStateLog(stateFile, stateFrames, script) ? EXIT_SUCCESS : EXIT_FAILURE;
+    else if (simulateGames > 0)
+        runSimulation(simulateGames, simulateFrames);
+    else if (versusTestFrames > 0)
+        status = runVersusTest(versusTestFrames, network) ? EXIT_SUCCESS : EXIT_FAILURE;
+    else if (versusPlayer >= 0)
+        status = runVersus(mWindow, versusPlayer, versusPort, versusPeerPort, network) ? EXIT_SUCCESS : EXIT_FAILURE;
+    else if (trainerGames > 0)
+        status = runTrainer(trainerName, trainerGames) ? EXIT_SUCCESS : EXIT_FAILURE;
+    else if (observeGames > 0)
+        status = runObservations(observeGames, observeFrames) ? EXIT_SUCCESS : EXIT_FAILURE;
+    else if (threaded)
+        runThreaded(mWindow);
+    else
+        runSingleThreaded(mWindow);
+
+    // Delete all resources as loaded using the resource manager
+    ResourceManager::Clear();
+    if (!Breakout.Software)
+    {
+        StreamBuffer::Clear();
+        FrameUniforms::Clear();
+    }
+    ResourcePack::Close();
+
+    if (mWindow != nullptr)
+        glfwTerminate();
+    return status;
+}
+
+// Input, update and render in lockstep on the main thread, with a variable time step
+void runSingleThreaded(GLFWwindow* window)
+{
+    // DeltaTime variables
+    GLfloat deltaTime = 0.0f;
+    GLdouble lastFrame = 0.0;
+    FrameSnapshot frame;
+
+    while (!glfwWindowShouldClose(window))
     {
+        // Poll first, so the events stamped during polling fall into this frame's tick
+        glfwPollEvents();
+        Profiler::BeginFrame();
         // Calculate delta time
-        GLfloat currentFrame = glfwGetTime();
+        GLdouble currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
-        glfwPollEvents();
 
         //deltaTime = 0.001f;
         // Manage user input
-        Breakout.ProcessInput(deltaTime);
+        Breakout.ProcessInput(currentFrame, deltaTime);
 
         // Update Game state
         Breakout.Update(deltaTime);
+        Breakout.Snapshot(frame);
 
         // Render
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
-        Breakout.Render();
+        Breakout.Render(frame);
+        Profiler::EndFrame();
 
-        glfwSwapBuffers(mWindow);
+        glfwSwapBuffers(window);
+        probeInputLatency(frame);
     }
+}
 
-    // Delete all resources as loaded using the resource manager
-    ResourceManager::Clear();
+// The main thread only pumps window events, so key events get timestamped as soon as they arrive. The simulation runs on its own thread at a fixed
+// tick and publishes snapshots through a triple buffer; a render thread owning the GL context
+// draws whatever snapshot is newest, so a blocking glfwSwapBuffers never stalls the simulation.
+void runThreaded(GLFWwindow* window)
+{
+    typedef std::chrono::steady_clock Clock;
+    std::atomic<bool> running(true);
+    TripleBuffer<FrameSnapshot> frames;
+
+    // Make sure the renderer has a valid frame before the simulation produced its first one
+    Breakout.Snapshot(frames.Back());
+    frames.Publish();
 
-    glfwTerminate();
-    return 0;
+    // The render thread takes over the GL context
+    glfwMakeContextCurrent(nullptr);
+    std::thread renderer([&]() {
+        glfwMakeContextCurrent(window);
+        while (running)
+        {
+            frames.Consume();
+            Profiler::BeginFrame();
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            Breakout.Render(frames.Front());
+            Profiler::EndFrame();
+            glfwSwapBuffers(window);
+            probeInputLatency(frames.Front());
+        }
+        glfwMakeContextCurrent(nullptr);
+    });
+
+    std::thread simulation([&]() {
+        const Clock::duration tick = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(SIM_TICK));
+        Clock::time_point next = Clock::now();
+        while (running)
+        {
+            {
+                Profiler::Scope scope("simulation tick");
+                Breakout.ProcessInput(glfwGetTime(), SIM_TICK);
+                Breakout.Update(SIM_TICK);
+                Breakout.Snapshot(frames.Back());
+            }
+            frames.Publish();
+            next += tick;
+            // Don't try to catch up after a long stall (e.g. a breakpoint), just resume ticking from now
+            Clock::time_point now = Clock::now();
+            if (now - next > 10 * tick)
+                next = now;
+            std::this_thread::sleep_until(next);
+        }
+    });
+
+    while (!glfwWindowShouldClose(window))
+        glfwWaitEventsTimeout(0.1);
+
+    running = false;
+    simulation.join();
+    renderer.join();
+    glfwMakeContextCurrent(window);
+}
+
+GLboolean runCapture(FrameCapture& capture, GLuint frames, const std::vector<ScriptEvent>& script)
+{
+    typedef std::chrono::steady_clock Clock;
+    // Same random numbers (particles, power-ups) on every run
+    srand(1);
+    FrameSnapshot frame;
+    size_t next = 0;
+    for (GLuint i = 0; i < frames; ++i)
+    {
+        GLdouble now = (i + 1) * static_cast<GLdouble>(CAPTURE_TICK);
+        for (; next < script.size() && script[next].Frame <= i; ++next)
+        {
+            InputEvent event = { now - CAPTURE_TICK, script[next].Key, script[next].Action };
+            Breakout.Input.Push(event);
+        }
+        Clock::time_point start = Clock::now();
+        Profiler::BeginFrame();
+        if (!capture.Begin())
+            return GL_FALSE;
+        Breakout.ProcessInput(now, CAPTURE_TICK);
+        Breakout.Update(CAPTURE_TICK);
+        Breakout.Snapshot(frame);
+        Breakout.Render(frame);
+        Profiler::EndFrame();
+        capture.End(i, std::chrono::duration<GLdouble, std::milli>(Clock::now() - start).count());
+    }
+    return GL_TRUE;
+}
+
+GLboolean runStateLog(const char* file, GLuint frames, const std::vector<ScriptEvent>& script)
+{
+    std::ofstream log(file);
+    if (!log)
+    {
+        fprintf(stderr, "Failed to write state log %s\n", file);
+        return GL_FALSE;
+    }
+    log << "# Breakout state log (" << SIMULATION_MATH << " math): tick total";
+    for (GLuint field = 0; field < StateHash::FIELDS; ++field)
+        log << ' ' << StateHash::FieldNames[field];
+    log << '\n' << std::hex;
+    size_t next = 0;
+    StateHash hash;
+    for (GLuint i = 0; i < frames; ++i)
+    {
+        GLdouble now = (i + 1) * static_cast<GLdouble>(CAPTURE_TICK);
+        for (; next < script.size() && script[next].Frame <= i; ++next)
+        {
+            InputEvent event = { now - CAPTURE_TICK, script[next].Key, script[next].Action };
+            Breakout.Input.Push(event);
+        }
+        Breakout.ProcessInput(now, CAPTURE_TICK);
+        Breakout.Update(CAPTURE_TICK);
+        Breakout.Hash(hash);
+        log << std::dec << i << std::hex << ' ' << hash.Total();
+        for (GLuint field = 0; field < StateHash::FIELDS; ++field)
+            log << ' ' << hash.Fields[field];
+        log << '\n';
+    }
+    printf("STATE LOG: %u ticks written to %s\n", frames, file);
+    return log.good() ? GL_TRUE : GL_FALSE;
+}
+
+GLboolean compareStateLogs(const char* first, const char* second)
+{
+    std::ifstream logs[2] = { std::ifstream(first), std::ifstream(second) };
+    if (!logs[0] || !logs[1])
+    {
+        fprintf(stderr, "Failed to read state logs %s and %s\n", first, second);
+        return GL_FALSE;
+    }
+    // Fields of a line: tick, total, then one per StateHash field
+    const GLuint columns = 2 + StateHash::FIELDS;
+    std::string lines[2];
+    GLuint ticks = 0;
+    for (;;)
+    {
+        GLboolean read[2];
+        for (GLuint i = 0; i < 2; ++i)
+        {
+            do
+                read[i] = std::getline(logs[i], lines[i]) ? GL_TRUE : GL_FALSE;
+            while (read[i] && (lines[i].empty() || lines[i][0] == '#'));
+        }
+        if (!read[0] || !read[1])
+        {
+            printf("DESYNC: no divergence in %u ticks", ticks);
+            if (read[0] || read[1])
+                printf(", then %s ends", read[0] ? second : first);
+            printf("\n");
+            return GL_TRUE;
+        }
+        unsigned long long values[2][columns];
+        for (GLuint i = 0; i < 2; ++i)
+        {
+            std::istringstream line(lines[i]);
+            line >> std::dec >> values[i][0] >> std::hex;
+            for (GLuint column = 1; column < columns; ++column)
+                line >> values[i][column];
+            if (!line)
+            {
+                fprintf(stderr, "Invalid state log line: %s\n", lines[i].c_str());
+                return GL_FALSE;
+            }
+        }
+        if (values[0][1] != values[1][1])
+        {
+            printf("DESYNC: first divergence at tick %llu, after %u identical ticks:\n", values[0][0], ticks);
+            for (GLuint field = 0; field < StateHash::FIELDS; ++field)
+                if (values[0][2 + field] != values[1][2 + field])
+                    printf("  %-9s %016llx != %016llx\n", StateHash::FieldNames[field], values[0][2 + field], values[1][2 + field]);
+            return GL_FALSE;
+        }
+        ++ticks;
+    }
+}
+
+GLboolean runObservations(GLuint games, GLuint frames)
+{
+    typedef std::chrono::steady_clock Clock;
+    srand(1);
+    std::vector<std::unique_ptr<Game>> instances = createGames(games);
+    std::vector<FrameSnapshot> snapshots(games);
+    ObservationRenderer observer(ResourceManager::GetShader("sprite_observation"), OBSERVATION_SIZE, OBSERVATION_SIZE, games,
+                                 SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (observer.Count < games)
+        return GL_FALSE;
+    FrameUniforms::Upload();
+    const GLint actions[3] = { GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_SPACE };
+    GLdouble brightness = 0.0, simulation = 0.0;
+    GLuint observed = 0;
+    Clock::time_point start = Clock::now();
+    for (GLuint frame = 0; frame <= frames; ++frame)
+    {
+        if (frame < frames)
+        {
+            Clock::time_point tick = Clock::now();
+            GLdouble now = (frame + 1) * static_cast<GLdouble>(CAPTURE_TICK);
+            for (GLuint i = 0; i < games; ++i)
+            {
+                // Random agent: holds one of the actions for each tick
+                Game &game = *instances[i];
+                holdKey(game, actions[rand() % 3], now - CAPTURE_TICK);
+                game.ProcessInput(now, CAPTURE_TICK);
+                game.Update(CAPTURE_TICK);
+                game.Snapshot(snapshots[i]);
+            }
+            simulation += std::chrono::duration<GLdouble, std::milli>(Clock::now() - tick).count();
+            observer.Render(snapshots);
+        }
+        // The previous tick's images were read back while this one was simulated
+        if (frame == 0)
+            continue;
+        const unsigned char *images = observer.Observations();
+        if (images == nullptr)
+            continue;
+        for (size_t pixel = 0; pixel < static_cast<size_t>(observer.Observed()) * OBSERVATION_SIZE * OBSERVATION_SIZE; ++pixel)
+            brightness += images[pixel];
+        observed += observer.Observed();
+    }
+    GLdouble total = std::chrono::duration<GLdouble, std::milli>(Clock::now() - start).count();
+    printf("OBSERVE: %u games x %u frames in %.1f ms (%.1f ms simulating), %.0f observations per second, mean brightness %.1f\n",
+           games, frames, total, simulation, observed / (total / 1000.0), observed > 0 ? brightness / observed / (OBSERVATION_SIZE * OBSERVATION_SIZE) : 0.0);
+    return GL_TRUE;
+}
+
+void runSimulation(GLuint games, GLuint frames)
+{
+    typedef std::chrono::steady_clock Clock;
+    srand(1);
+    std::vector<std::unique_ptr<Game>> instances = createGames(games);
+    const GLint actions[3] = { GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_SPACE };
+    // The agent's choices are drawn up front, so only the simulation is timed
+    std::vector<GLint> keys(static_cast<size_t>(games) * frames);
+    for (GLint &key : keys)
+        key = actions[rand() % 3];
+    Clock::time_point start = Clock::now();
+    for (GLuint frame = 0; frame < frames; ++frame)
+    {
+        GLdouble now = (frame + 1) * static_cast<GLdouble>(CAPTURE_TICK);
+        for (GLuint i = 0; i < games; ++i)
+        {
+            Game &game = *instances[i];
+            holdKey(game, keys[static_cast<size_t>(frame) * games + i], now - CAPTURE_TICK);
+            game.ProcessInput(now, CAPTURE_TICK);
+            game.Update(CAPTURE_TICK);
+        }
+    }
+    GLdouble seconds = std::chrono::duration<GLdouble>(Clock::now() - start).count();
+    printf("SIMULATE: %u games x %u ticks with %s math in %.1f ms, %.0f game ticks/s\n", games, frames, SIMULATION_MATH,
+           seconds * 1000.0, games * static_cast<GLdouble>(frames) / seconds);
+}
+
+GLboolean runTrainer(const char* name, GLuint games)
+{
+    TrainerLink link;
+    if (!link.Open(name, games, CAPTURE_TICK))
+        return GL_FALSE;
+    printf("TRAINER: %u games on shared memory %s, waiting for actions\n", games, name);
+    fflush(stdout);
+    srand(1);
+    std::vector<std::unique_ptr<Game>> instances = createGames(games);
+    const GLint keys[4] = { 0, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_SPACE };
+    for (;;)
+    {
+        for (GLuint i = 0; i < games; ++i)
+            link.Write(i, *instances[i]);
+        link.Publish();
+        if (!link.WaitForActions())
+            break;
+        GLdouble now = link.Step() * static_cast<GLdouble>(CAPTURE_TICK);
+        for (GLuint i = 0; i < games; ++i)
+        {
+            Game &game = *instances[i];
+            const TrainerLink::Action &action = link.Actions(i);
+            if (action.Reset != 0)
+            {
+                game.ResetLevel();
+                game.ResetPlayer();
+                game.State = GAME_ACTIVE;
+            }
+            holdKey(game, action.Key >= 0 && action.Key < 4 ? keys[action.Key] : 0, now - CAPTURE_TICK);
+            game.ProcessInput(now, CAPTURE_TICK);
+            game.Update(CAPTURE_TICK);
+        }
+    }
+    printf("TRAINER: stopped after %u steps\n", link.Step());
+    return GL_TRUE;
+}
+
+GLboolean runVersus(GLFWwindow* window, GLuint player, GLushort port, GLushort peerPort, const NetworkSettings& network)
+{
+    UdpTransport transport;
+    transport.Latency = network.Latency;
+    transport.Loss = network.Loss;
+    if (!transport.Open(port, peerPort))
+        return GL_FALSE;
+    Breakout.StartVersus();
+    RollbackSession session(Breakout, transport, player, CAPTURE_TICK, network.Rollback);
+    printf("VERSUS: player %u on port %u, peer on port %u\n", player + 1, transport.Port(), peerPort);
+    FrameSnapshot frame;
+    GLdouble lastFrame = glfwGetTime(), pending = 0.0;
+    while (!glfwWindowShouldClose(window))
+    {
+        glfwPollEvents();
+        Profiler::BeginFrame();
+        GLdouble currentFrame = glfwGetTime();
+        pending += currentFrame - lastFrame;
+        lastFrame = currentFrame;
+        // Both players steer with A, D and SPACE on their own machine
+        GLubyte input = (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS ? INPUT_LEFT : 0) |
+                        (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS ? INPUT_RIGHT : 0) |
+                        (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS ? INPUT_LAUNCH : 0);
+        // Both sides have to simulate the same fixed ticks; time spent stalled on the peer is not caught up later
+        session.Poll();
+        while (pending >= CAPTURE_TICK && session.Advance(input))
+            pending -= CAPTURE_TICK;
+        pending = std::min(pending, static_cast<GLdouble>(CAPTURE_TICK));
+        Breakout.Snapshot(frame);
+        // The animated effects follow the wall clock, the simulation has no input timeline here
+        frame.Time = currentFrame;
+
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        Breakout.Render(frame);
+        Profiler::EndFrame();
+        glfwSwapBuffers(window);
+    }
+    printf("VERSUS: %u ticks, %u rollbacks replaying %u ticks (longest %.3f ms), %u stalls\n", session.Tick(), session.Rollbacks,
+           session.Replayed, session.MaxRollbackTime, session.Stalls);
+    return session.DesyncTick == RollbackSession::NONE;
+}
+
+GLboolean runVersusTest(GLuint frames, const NetworkSettings& network)
+{
+    typedef std::chrono::steady_clock Clock;
+    // Breakout plays player 1, a simulation-only instance player 2; each only knows its own input
+    std::vector<std::unique_ptr<Game>> instances = createGames(1);
+    Game *games[2] = { &Breakout, instances[0].get() };
+    UdpTransport transports[2];
+    std::unique_ptr<RollbackSession> sessions[2];
+    for (GLuint side = 0; side < 2; ++side)
+    {
+        transports[side].Latency = network.Latency;
+        transports[side].Loss = network.Loss;
+        if (!transports[side].Open(0, 0))
+            return GL_FALSE;
+    }
+    for (GLuint side = 0; side < 2; ++side)
+    {
+        transports[side].SetPeer(transports[1 - side].Port());
+        games[side]->Random = 1;
+        games[side]->StartVersus();
+        sessions[side].reset(new RollbackSession(*games[side], transports[side], side, CAPTURE_TICK, network.Rollback));
+    }
+    // Ticks run at the real rate, so the simulated latency costs as many ticks as it would in a game. Each side
+    // holds a random input for a while, like a player holding a key
+    srand(1);
+    GLubyte inputs[2] = { 0, 0 };
+    GLuint holdUntil[2] = { 0, 0 };
+    Clock::time_point start = Clock::now();
+    Clock::time_point deadline = start + std::chrono::milliseconds(static_cast<long long>(frames * CAPTURE_TICK * 1000.0f) + 10000);
+    for (GLuint tick = 0; sessions[0]->Confirmed() < frames || sessions[1]->Confirmed() < frames; ++tick)
+    {
+        if (Clock::now() > deadline)
+        {
+            printf("VERSUS: only %u and %u of %u ticks confirmed, giving up\n", sessions[0]->Confirmed(), sessions[1]->Confirmed(), frames);
+            return GL_FALSE;
+        }
+        std::this_thread::sleep_until(start + std::chrono::microseconds(static_cast<long long>(tick * CAPTURE_TICK * 1000000.0)));
+        for (GLuint side = 0; side < 2; ++side)
+        {
+            RollbackSession &session = *sessions[side];
+            session.Poll();
+            if (session.Tick() >= holdUntil[side])
+            {
+                inputs[side] = static_cast<GLubyte>(rand() % 8);
+                holdUntil[side] = session.Tick() + 5 + rand() % 30;
+            }
+            session.Advance(inputs[side]);
+        }
+    }
+    // The worst case a session allows: putting a state back and simulating Rollback ticks again within one frame
+    const GLuint repeats = 100;
+    const GLubyte idle[2] = { 0, 0 };
+    SimulationState saved;
+    Breakout.Save(saved);
+    Breakout.Replaying = GL_TRUE;
+    Clock::time_point replayStart = Clock::now();
+    for (GLuint repeat = 0; repeat < repeats; ++repeat)
+    {
+        Breakout.Restore(saved);
+        for (GLuint tick = 0; tick < network.Rollback; ++tick)
+            Breakout.Step(idle, CAPTURE_TICK);
+    }
+    GLdouble replay = std::chrono::duration<GLdouble, std::milli>(Clock::now() - replayStart).count() / repeats;
+    Breakout.Replaying = GL_FALSE;
+    Breakout.Restore(saved);
+
+    printf("VERSUS: %u ticks confirmed with %s math, %.0f ms latency, %.0f%% loss, rollback window %u ticks\n", frames, SIMULATION_MATH,
+           network.Latency, network.Loss * 100.0, network.Rollback);
+    GLboolean synced = GL_TRUE;
+    for (GLuint side = 0; side < 2; ++side)
+    {
+        const RollbackSession &session = *sessions[side];
+        printf("VERSUS: player %u: %u rollbacks replaying %u ticks (%.1f per rollback), %.3f ms per rollback, longest %.3f ms, "
+               "%u stalls, %u of %u packets lost, %s\n", side + 1, session.Rollbacks, session.Replayed,
+               session.Rollbacks > 0 ? static_cast<GLdouble>(session.Replayed) / session.Rollbacks : 0.0,
+               session.Rollbacks > 0 ? session.RollbackTime / session.Rollbacks : 0.0, session.MaxRollbackTime, session.Stalls,
+               transports[side].Dropped, transports[side].Sent, session.DesyncTick == RollbackSession::NONE ? "in sync" : "OUT OF SYNC");
+        if (session.DesyncTick != RollbackSession::NONE)
+            synced = GL_FALSE;
+    }
+    printf("VERSUS: restoring a state and simulating %u ticks again takes %.3f ms\n", network.Rollback, replay);
+    return synced;
+}
+
+std::vector<std::unique_ptr<Game>> createGames(GLuint count)
+{
+    std::vector<std::unique_ptr<Game>> games;
+    for (GLuint i = 0; i < count; ++i)
+    {
+        games.push_back(std::unique_ptr<Game>(new Game(SCREEN_WIDTH, SCREEN_HEIGHT)));
+        games.back()->BallCount = Breakout.BallCount;
+        games.back()->Random = i + 1;
+        games.back()->InitSimulation();
+        games.back()->State = GAME_ACTIVE;
+    }
+    return games;
+}
+
+void holdKey(Game& game, GLint key, GLdouble time)
+{
+    const GLint keys[3] = { GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_SPACE };
+    for (GLint other : keys)
+    {
+        InputEvent release = { time, other, GLFW_RELEASE };
+        game.Input.Push(release);
+    }
+    if (key == 0)
+        return;
+    InputEvent press = { time, key, GLFW_PRESS };
+    game.Input.Push(press);
+}
+
+GLboolean parseScript(std::istream& source, std::vector<ScriptEvent>& script)
+{
+    if (!source)
+        return GL_FALSE;
+    std::string line;
+    while (std::getline(source, line))
+    {
+        std::istringstream fields(line);
+        ScriptEvent event;
+        std::string action, key;
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (!(fields >> event.Frame >> action >> key) || (action != "press" && action != "release"))
+        {
+            fprintf(stderr, "Invalid script line: %s\n", line.c_str());
+            return GL_FALSE;
+        }
+        event.Action = action == "press" ? GLFW_PRESS : GLFW_RELEASE;
+        if (key.size() == 1 && key[0] >= 'A' && key[0] <= 'Z')
+            event.Key = GLFW_KEY_A + (key[0] - 'A');
+        else if (key == "SPACE")
+            event.Key = GLFW_KEY_SPACE;
+        else if (key == "ENTER")
+            event.Key = GLFW_KEY_ENTER;
+        else if (key == "LEFT")
+            event.Key = GLFW_KEY_LEFT;
+        else if (key == "RIGHT")
+            event.Key = GLFW_KEY_RIGHT;
+        else if (key == "UP")
+            event.Key = GLFW_KEY_UP;
+        else if (key == "DOWN")
+            event.Key = GLFW_KEY_DOWN;
+        else
+        {
+            fprintf(stderr, "Unknown key in script: %s\n", key.c_str());
+            return GL_FALSE;
+        }
+        script.push_back(event);
+    }
+    std::stable_sort(script.begin(), script.end(), [](const ScriptEvent& a, const ScriptEvent& b) { return a.Frame < b.Frame; });
+    return GL_TRUE;
 }
 
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
@@ -100,15 +893,30 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     // When a user presses the escape key, we set the WindowShouldClose property to true, closing the application
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GL_TRUE);
-    if (key >= 0 && key < 1024)
+    // Everything else is queued for the simulation, stamped with its arrival time; versus mode polls the keys instead,
+    // so nothing would ever take the events out of the queue
+    if (!Breakout.Versus && key >= 0 && key < 1024 && (action == GLFW_PRESS || action == GLFW_RELEASE))
     {
-        if (action == GLFW_PRESS)
-            Breakout.Keys[key] = GL_TRUE;
-        else if (action == GLFW_RELEASE)
-        {
-            Breakout.Keys[key] = GL_FALSE;
-            Breakout.KeysProcessed[key] = GL_FALSE;
-        }
+        InputEvent event = { glfwGetTime(), key, action };
+        if (!Breakout.Input.Push(event))
+            fprintf(stderr, "Input queue full, dropped key event\n");
+    }
+}
+
+void framebuffer_size_callback(GLFWwindow* window, int width, int height)
+{
+    // Picked up by the renderer at the start of its next frame
+    Breakout.Resize(width, height);
+}
+
+void probeInputLatency(const FrameSnapshot& frame)
+{
+    // A snapshot may be presented more than once when rendering outpaces the simulation; count it once
+    static GLdouble lastReported = 0.0;
+    if (frame.InputTime > 0.0 && frame.InputTime != lastReported)
+    {
+        lastReported = frame.InputTime;
+        Profiler::AddTime("input latency", (glfwGetTime() - frame.InputTime) * 1000.0);
     }
 }
 